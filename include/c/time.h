@@ -0,0 +1,12 @@
+/**
+ * Implement of time.h in ANSI C.
+ *
+ * @author Gary Guo <nbdd0121@hotmail.com>
+ */
+
+#ifndef C_TIME_H
+#define C_TIME_H
+
+#include <time.h>
+
+#endif
@@ -3,6 +3,8 @@
 
 #include "c/stdbool.h"
 
+#include "data-struct/region.h"
+
 typedef int (*comparator_t)(void *, void *);
 typedef int (*hash_t)(void *);
 typedef struct str_hashmap hashmap_t;
@@ -14,7 +16,11 @@ typedef struct {
 int string_hash(void *);
 int string_comparator(void *, void *);
 hashmap_t *hashmap_new_string(int size);
+int pointer_hash(void *);
+int pointer_comparator(void *, void *);
+hashmap_t *hashmap_new_pointer(int size);
 hashmap_t *hashmap_new(hash_t, comparator_t, int);
+hashmap_t *hashmap_new_region(hash_t, comparator_t, int, region_t *);
 bool hashmap_put(hashmap_t *, void *, void *);
 void *hashmap_get(hashmap_t *, void *);
 void *hashmap_remove(hashmap_t *, void *);
@@ -0,0 +1,18 @@
+#ifndef DATA_STRUCT_REGION_H
+#define DATA_STRUCT_REGION_H
+
+#include "c/stdbool.h"
+#include "c/stddef.h"
+
+/*
+ * Allocator which carves blocks out of large chunks by bumping a pointer.
+ * Blocks are never freed one by one; the region is released as a whole.
+ */
+typedef struct region region_t;
+
+region_t *region_new(void);
+void *region_alloc(region_t *region, size_t size);
+size_t region_size(region_t *region);
+void region_dispose(region_t *region);
+
+#endif
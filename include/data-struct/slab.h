@@ -0,0 +1,29 @@
+#ifndef DATA_STRUCT_SLAB_H
+#define DATA_STRUCT_SLAB_H
+
+#include "c/stddef.h"
+
+/*
+ * Allocator for small fixed-size blocks. Sizes are rounded up to a multiple
+ * of SLAB_GRANULE, each giving a size class whose blocks are carved out of
+ * pages of SLAB_PAGE_SIZE. Larger blocks are passed on to malloc.
+ */
+enum {
+    SLAB_GRANULE = 16,
+    SLAB_CLASSES = 16,
+    SLAB_MAX_SIZE = SLAB_GRANULE * SLAB_CLASSES,
+    SLAB_PAGE_SIZE = 64 * 1024,
+};
+
+typedef struct {
+    size_t size;
+    size_t allocations;
+    size_t frees;
+    size_t pages;
+} slab_stats_t;
+
+void *slab_alloc(size_t size);
+void slab_free(void *ptr, size_t size);
+void slab_stats(slab_stats_t stats[SLAB_CLASSES]);
+
+#endif
@@ -57,6 +57,12 @@ enum nodoka_bytecode {
      */
     NODOKA_BC_DUP,
 
+    /**
+     * [] DUP2
+     * duplicate the top 2 elements
+     */
+    NODOKA_BC_DUP2,
+
     /**
      * [] POP
      * pop the top element from the stack
@@ -71,9 +77,15 @@ enum nodoka_bytecode {
 
     NODOKA_BC_XCHG3,
 
+    /**
+     * [] XCHG4
+     * move the top element below the next 3 elements
+     */
+    NODOKA_BC_XCHG4,
+
     /**
      * [] RET
-     * return the top element
+     * return the top element, discarding the rest of the operand stack
      */
     NODOKA_BC_RET,
 
@@ -103,10 +115,41 @@ enum nodoka_bytecode {
      */
     NODOKA_BC_STR,
 
+    /**
+     * [] KEY
+     * convert the stack top to a property key: array indices which are int32
+     * are kept as numbers, anything else is converted to string
+     */
+    NODOKA_BC_KEY,
+
     NODOKA_BC_REF,
 
     NODOKA_BC_ID,
 
+    /**
+     * [imm16] GET_LOCAL
+     * push the value of the frame slot
+     */
+    NODOKA_BC_GET_LOCAL,
+
+    /**
+     * [imm16] SET_LOCAL
+     * pop the stack top into the frame slot
+     */
+    NODOKA_BC_SET_LOCAL,
+
+    /**
+     * [imm8 imm16] GET_UPVAL
+     * push the value of the slot of the environment record imm8 levels out
+     */
+    NODOKA_BC_GET_UPVAL,
+
+    /**
+     * [imm8 imm16] SET_UPVAL
+     * pop the stack top into the slot of the environment record imm8 levels out
+     */
+    NODOKA_BC_SET_UPVAL,
+
     /**
      * [] GET
      * convert the top reference (if it is) to its value
@@ -115,10 +158,49 @@ enum nodoka_bytecode {
 
     NODOKA_BC_PUT,
 
+    /**
+     * [] GET_PROP
+     * pop the key and replace the base with the value of its property
+     */
+    NODOKA_BC_GET_PROP,
+
+    /**
+     * [] PUT_PROP
+     * pop the value and the key, set the property of the base and
+     * replace the base with the value
+     */
+    NODOKA_BC_PUT_PROP,
+
+    /**
+     * [imm16] GET_NAME
+     * push the value of the identifier resolved through the environment
+     */
+    NODOKA_BC_GET_NAME,
+
+    /**
+     * [imm16] PUT_NAME
+     * set the identifier resolved through the environment to the stack top,
+     * which is kept
+     */
+    NODOKA_BC_PUT_NAME,
+
     NODOKA_BC_DEL,
 
     NODOKA_BC_CALL,
 
+    /**
+     * [imm8] CALL_PROP
+     * call the property of the base with the base as this, the base and the
+     * key being below the arguments
+     */
+    NODOKA_BC_CALL_PROP,
+
+    /**
+     * [imm16 imm8] CALL_NAME
+     * call the value of the identifier resolved through the environment
+     */
+    NODOKA_BC_CALL_NAME,
+
     NODOKA_BC_NEW,
 
     NODOKA_BC_TYPEOF,
@@ -149,9 +231,6 @@ enum nodoka_bytecode {
 
     NODOKA_BC_JMP,
     NODOKA_BC_JT,
-    NODOKA_BC_TRY,
-    NODOKA_BC_CATCH,
-    NODOKA_BC_NOCATCH,
 
     NODOKA_BC_THROW,
 
@@ -162,21 +241,100 @@ enum nodoka_bytecode {
 
 extern void *bytecode_protector[NODOKA_BC_PROTECTOR > 0xFF ? -1 : 1];
 
+enum {
+    NODOKA_IC_WAYS = 4,
+};
+
+/**
+ * Inline cache of a property access site. An entry for an own property
+ * remembers the shape of the receiver and the slot of the property, and so
+ * serves every object of that shape. Entries for inherited properties
+ * remember a single receiver, and the prototype and the slot the property
+ * was found in. Only properties kept in slots are cached. Entries are only
+ * valid for the nodoka_propertyEpoch they were filled in, as it changes
+ * whenever a property is removed, redefined, or added where it shadows an
+ * inherited one, and whenever an object moves its slots to a dictionary.
+ */
+typedef struct nodoka_ic {
+    size_t epoch;
+    size_t next;
+    struct {
+        /* The shape of the receivers, or the receiver itself */
+        void *receiver;
+        nodoka_string *name;
+        /* Object whose slots hold the property */
+        nodoka_object *holder;
+        uint32_t slot;
+    } entries[NODOKA_IC_WAYS];
+} nodoka_ic;
+
+/**
+ * Pre-decoded form of the bytecode, which is what the interpreter executes.
+ * Each instruction takes one word for the opcode, followed by one word for
+ * its operand if it has one. Property accesses take one more word pointing
+ * to the inline cache of the site.
+ */
+typedef union nodoka_word nodoka_word;
+union nodoka_word {
+    uintptr_t op;
+    size_t imm;
+    nodoka_value value;
+    nodoka_string *string;
+    nodoka_code *code;
+    nodoka_word *target;
+    nodoka_ic *ic;
+    struct {
+        uint16_t depth;
+        uint16_t index;
+    } upval;
+};
+
+/**
+ * Entry of the exception table of a code. When an exception is thrown from
+ * an instruction in [start, end), the operand stack is cut back to depth
+ * values, the exception is pushed and execution continues at handler.
+ * Entries of inner try statements come before those of outer ones.
+ */
+typedef struct nodoka_handler {
+    uint16_t start;
+    uint16_t end;
+    uint16_t handler;
+    uint16_t depth;
+} nodoka_handler;
+
 struct nodoka_code {
     nodoka_data base;
     nodoka_string **stringPool;
     nodoka_code **codePool;
     uint8_t *bytecode;
+    nodoka_word *wordcode;
     size_t strPoolLength;
     size_t codePoolLength;
     size_t bytecodeLength;
+    size_t wordcodeLength;
+    /* Offsets are in bytes, and in words for the decoded copy */
+    nodoka_handler *handlers;
+    nodoka_handler *wordHandlers;
+    size_t handlerLength;
+    /* Inline caches of the property access sites, created with the word code */
+    nodoka_ic *caches;
+    size_t cacheLength;
+    /* Maximum depth of the operand stack, computed by nodoka_verifyCode */
+    size_t stackSize;
     struct {
         size_t length;
         nodoka_string **array;
     } formalParameters;
     nodoka_string *name;
+    /* Number of frame slots and environment record slots, see nodoka_scope */
+    size_t localCount;
+    size_t slotCount;
+    bool dynamicScope;
 };
 
+typedef struct nodoka_scope nodoka_scope;
+typedef struct nodoka_finally nodoka_finally;
+
 struct nodoka_code_emitter {
     nodoka_string **stringPool;
     nodoka_code **codePool;
@@ -187,25 +345,61 @@ struct nodoka_code_emitter {
     size_t strPoolCapacity;
     size_t codePoolCapacity;
     size_t bytecodeCapacity;
+    nodoka_handler *handlers;
+    size_t handlerLength;
+    size_t handlerCapacity;
+    nodoka_scope *scope;
+    /* Operand stack depth of statements and the innermost enclosing finally */
+    size_t depth;
+    nodoka_finally *finally;
 };
 
 struct nodoka_envRec {
     nodoka_data base;
     struct nodoka_envRec *outer;
     nodoka_object *object;
-    nodoka_data *this;
+    nodoka_value *slots;
+    size_t slotCount;
+    nodoka_value this;
 };
 
+/**
+ * The VM stack shared by all activations of a global. Frames are pushed
+ * and popped in LIFO order. The stack grows by chaining segments, and a
+ * frame never straddles two of them.
+ */
+struct nodoka_stack {
+    struct nodoka_stack_segment *segment;
+    nodoka_value *top;
+    nodoka_value *limit;
+    /* Number of live contexts, and the innermost one */
+    size_t depth;
+    nodoka_context *context;
+};
+
+/**
+ * An activation. It lives in its own frame on the VM stack, between the
+ * frame slots and the operand stack.
+ */
 struct nodoka_context {
     nodoka_global *global;
     nodoka_envRec *env;
     nodoka_code *code;
-    nodoka_data **stack;
-    nodoka_data **stackTop;
-    nodoka_data **stackLimit;
+    /* Context to resume on return when called from the interpreter loop */
+    nodoka_context *caller;
+    /* Object under construction when invoked by new */
+    nodoka_object *constructed;
+    /* Context pushed before this one on the VM stack */
+    nodoka_context *prev;
+    nodoka_value *frame;
+    nodoka_value *stack;
+    nodoka_value *stackTop;
+    nodoka_value *stackLimit;
+    nodoka_value *locals;
     nodoka_object *this;
     size_t insPtr;
-    size_t catchPtr;
+    /* Region to allocate in when run by nodoka_exec, see nodoka_newRegionContext */
+    nodoka_region *region;
 };
 
 typedef uint16_t nodoka_relocatable;
@@ -215,20 +409,31 @@ nodoka_code_emitter *nodoka_newCodeEmitter(void);
 void nodoka_emitBytecode(nodoka_code_emitter *codeseg, uint8_t bc, ...);
 nodoka_label nodoka_putLabel(nodoka_code_emitter *emitter);
 void nodoka_relocate(nodoka_code_emitter *emitter, nodoka_relocatable rel, nodoka_label label);
+void nodoka_emitHandler(nodoka_code_emitter *emitter, nodoka_label start, nodoka_label end, nodoka_label handler, size_t depth);
 void nodoka_xchgEmitter(nodoka_code_emitter *, nodoka_code_emitter *);
 void nodoka_freeEmitter(nodoka_code_emitter *emitter);
 nodoka_code *nodoka_packCode(nodoka_code_emitter *emitter);
 nodoka_code_emitter *nodoka_unpackCode(nodoka_code *code);
 void nodoka_disposeCode(nodoka_code *code);
+void nodoka_decodeCode(nodoka_code *code);
+size_t nodoka_operandLength(uint8_t bc);
+bool nodoka_verifyCode(nodoka_code *code);
+
+nodoka_stack *nodoka_newStack(void);
+nodoka_value *nodoka_pushFrame(nodoka_stack *stack, size_t size, int argc, nodoka_value *argv);
+void nodoka_popFrame(nodoka_stack *stack, nodoka_value *frame);
 
 nodoka_context *nodoka_newContext(nodoka_global *global, nodoka_envRec *env, nodoka_code *code, nodoka_object *this);
+nodoka_context *nodoka_pushContext(nodoka_global *global, nodoka_envRec *env, nodoka_code *code, nodoka_object *this, int argc, nodoka_value *argv);
 void nodoka_disposeContext(nodoka_context *ctx);
+nodoka_context *nodoka_newRegionContext(nodoka_region *region, nodoka_global *global, nodoka_envRec *env, nodoka_code *code);
 
 nodoka_envRec *nodoka_newDeclEnvRecord(nodoka_envRec *outer);
+nodoka_envRec *nodoka_newSlotEnvRecord(nodoka_envRec *outer, size_t count);
 nodoka_envRec *nodoka_newObjEnvRecord(nodoka_object *obj, nodoka_envRec *outer);
 bool nodoka_hasBinding(nodoka_envRec *env, nodoka_string *name);
-nodoka_data *nodoka_getBindingValue(nodoka_envRec *env, nodoka_string *name);
-void nodoka_setMutableBinding(nodoka_envRec *env, nodoka_string *name, nodoka_data *val);
+nodoka_value nodoka_getBindingValue(nodoka_envRec *env, nodoka_string *name);
+bool nodoka_setMutableBinding(nodoka_envRec *env, nodoka_string *name, nodoka_value val);
 
 nodoka_object *nodoka_newObject(nodoka_global *global);
 
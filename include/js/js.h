@@ -6,6 +6,8 @@
 #include "c/assert.h"
 
 #include "unicode/convert.h"
+#include "data-struct/region.h"
+#include "util/double.h"
 
 enum nodoka_data_type {
     NODOKA_NULL = 0x1,
@@ -20,27 +22,203 @@ enum nodoka_data_type {
     NODOKA_PROPERTY = 0x80,
     NODOKA_CODE = 0x100,
 
-    NODOKA_ENV = 0x200
+    NODOKA_ENV = 0x200,
+
+    NODOKA_SHAPE = 0x400
 };
 
-typedef struct {
+/* Header of everything allocated on the heap, which the collector links together */
+typedef struct nodoka_data {
     enum nodoka_data_type type;
+    bool marked;
+    /* Allocated in a region, see nodoka_newRegion */
+    bool inRegion;
+    struct nodoka_data *next;
 } nodoka_data;
 
-typedef struct {
-    nodoka_data base;
-    double value;
-} nodoka_number;
+/**
+ * A JavaScript value packed in 64 bits. Numbers, booleans, null and undefined
+ * are immediates; strings, objects and the internal types are pointers to a
+ * nodoka_data, whose header tells the type.
+ *
+ *   Pointer   0000:PPPP:PPPP:PPPP   (0 is the empty value)
+ *   Special   0000:0000:0000:000X   null 0x2, false 0x6, true 0x7, undefined 0xA
+ *   Double    0002:0000:0000:0000 - FFFC:FFFF:FFFF:FFFF   (IEEE bits + 2^49)
+ *   Int32     FFFE:0000:IIII:IIII
+ */
+typedef uint64_t nodoka_value;
+
+#define NODOKA_NUMBER_TAG 0xFFFE000000000000ULL
+#define NODOKA_OTHER_TAG 0x2ULL
+#define NODOKA_DOUBLE_OFFSET (1ULL << 49)
+
+#define nodoka_empty ((nodoka_value)0)
+#define nodoka_null ((nodoka_value)0x2)
+#define nodoka_false ((nodoka_value)0x6)
+#define nodoka_true ((nodoka_value)0x7)
+#define nodoka_undefined ((nodoka_value)0xA)
+#define nodoka_zero (NODOKA_NUMBER_TAG | 0)
+#define nodoka_one (NODOKA_NUMBER_TAG | 1)
+#define nodoka_nan (0x7FF8000000000000ULL + NODOKA_DOUBLE_OFFSET)
+
+static inline bool nodoka_isNumber(nodoka_value value) {
+    return (value & NODOKA_NUMBER_TAG) != 0;
+}
+
+static inline bool nodoka_isInt32(nodoka_value value) {
+    return (value & NODOKA_NUMBER_TAG) == NODOKA_NUMBER_TAG;
+}
+
+static inline bool nodoka_isDouble(nodoka_value value) {
+    return nodoka_isNumber(value) && !nodoka_isInt32(value);
+}
+
+static inline bool nodoka_isBoolean(nodoka_value value) {
+    return (value & ~1ULL) == nodoka_false;
+}
+
+/* Pointers are at least 8-byte aligned, so they never have NODOKA_OTHER_TAG set */
+static inline bool nodoka_isPointer(nodoka_value value) {
+    return value && !(value & (NODOKA_NUMBER_TAG | NODOKA_OTHER_TAG));
+}
+
+static inline nodoka_value nodoka_fromInt32(int32_t value) {
+    return NODOKA_NUMBER_TAG | (uint32_t)value;
+}
+
+static inline int32_t nodoka_getInt32(nodoka_value value) {
+    return (int32_t)(uint32_t)value;
+}
+
+static inline nodoka_value nodoka_fromDouble(double value) {
+    /* All NaNs are folded into one so they cannot be mistaken for an int32 */
+    if (value != value) {
+        return nodoka_nan;
+    }
+    return double2int(value) + NODOKA_DOUBLE_OFFSET;
+}
+
+static inline double nodoka_getDouble(nodoka_value value) {
+    return int2double(value - NODOKA_DOUBLE_OFFSET);
+}
+
+/* Make an int32 value if the number is one (but not -0), a double otherwise */
+static inline nodoka_value nodoka_fromNumber(double value) {
+    if (value >= INT32_MIN && value <= INT32_MAX) {
+        int32_t intValue = (int32_t)value;
+        if (intValue == value && (intValue || double2int(value) == 0)) {
+            return nodoka_fromInt32(intValue);
+        }
+    }
+    return nodoka_fromDouble(value);
+}
+
+static inline double nodoka_getNumber(nodoka_value value) {
+    if (nodoka_isInt32(value)) {
+        return nodoka_getInt32(value);
+    }
+    return nodoka_getDouble(value);
+}
+
+static inline nodoka_value nodoka_fromBool(bool value) {
+    return value ? nodoka_true : nodoka_false;
+}
+
+static inline nodoka_value nodoka_box(void *data) {
+    return (nodoka_value)(uintptr_t)data;
+}
+
+static inline void *nodoka_unbox(nodoka_value value) {
+    assert(!value || nodoka_isPointer(value));
+    return (void *)(uintptr_t)value;
+}
+
+static inline enum nodoka_data_type nodoka_typeOf(nodoka_value value) {
+    if (nodoka_isNumber(value)) {
+        return NODOKA_NUMBER;
+    } else if (nodoka_isPointer(value)) {
+        return ((nodoka_data *)nodoka_unbox(value))->type;
+    } else if (value == nodoka_undefined) {
+        return NODOKA_UNDEF;
+    } else if (value == nodoka_null) {
+        return NODOKA_NULL;
+    } else {
+        assert(nodoka_isBoolean(value));
+        return NODOKA_BOOL;
+    }
+}
+
+static inline bool nodoka_isString(nodoka_value value) {
+    return nodoka_isPointer(value) && ((nodoka_data *)nodoka_unbox(value))->type == NODOKA_STRING;
+}
+
+static inline bool nodoka_isObject(nodoka_value value) {
+    return nodoka_isPointer(value) && ((nodoka_data *)nodoka_unbox(value))->type == NODOKA_OBJECT;
+}
+
+enum {
+    /* Concatenations shorter than this are copied right away rather than made ropes */
+    NODOKA_MIN_ROPE_LENGTH = 16,
+    /* Substrings shorter than this are copied rather than share the contents of their string */
+    NODOKA_MIN_SUBSTRING_LENGTH = 16,
+};
 
-typedef struct {
+/**
+ * A string value. Atoms are interned, so that equal atoms are the same
+ * nodoka_string; names and property keys are atoms. Other strings are
+ * plain, made at run time without being hashed, and are compared by their
+ * contents. Ropes are plain strings made by concatenation, whose contents
+ * are only made when nodoka_flatten is called; until then a rope has both
+ * halves and only the length of value is set. Once flattened, it refers to
+ * the flat string in left alone. Substrings made by nodoka_newSubstring are
+ * flat, but point into the contents of the string in parent, which they
+ * keep alive, instead of having their own.
+ *
+ * Strings whose code units are all below 0x100 are one-byte strings, which
+ * keep them in latin1 rather than value; value.len is the length of either.
+ * Any other string has a unit above 0xFF, so that strings with the same
+ * contents are also kept the same way.
+ */
+typedef struct nodoka_string {
     nodoka_data base;
-    utf16_string_t value;
-    nodoka_number *numberCache;
+    union {
+        utf16_string_t value;
+        latin1_string_t latin1;
+    };
+    bool oneByte;
+    bool atom;
+    /* Hash of the contents, computed once for atoms when they are interned */
+    uint32_t hash;
+    nodoka_value numberCache;
+    struct nodoka_string *left;
+    union {
+        struct nodoka_string *right;
+        struct nodoka_string *parent;
+    };
 } nodoka_string;
 
+nodoka_string *nodoka_flattenRope(nodoka_string *rope);
+nodoka_string *nodoka_intern(nodoka_string *str);
+
+/* String with the contents of str, for anything which reads them */
+static inline nodoka_string *nodoka_flatten(nodoka_string *str) {
+    return str->left ? nodoka_flattenRope(str) : str;
+}
+
+/* Code unit at index of a flat string */
+static inline uint16_t nodoka_charAt(nodoka_string *str, size_t index) {
+    return str->oneByte ? str->latin1.str[index] : str->value.str[index];
+}
+
+/* Atom with the contents of str, which is what property keys have to be */
+static inline nodoka_string *nodoka_toAtom(nodoka_string *str) {
+    return str->atom ? str : nodoka_intern(str);
+}
+
+/* A base of undefined indicates an unresolvable reference */
 typedef struct {
     nodoka_data class_base;
-    nodoka_data *base;
+    nodoka_value base;
     nodoka_string *name;
 } nodoka_reference;
 
@@ -50,6 +228,8 @@ typedef struct nodoka_code nodoka_code;
 typedef struct nodoka_code_emitter nodoka_code_emitter;
 typedef struct nodoka_context nodoka_context;
 typedef struct nodoka_envRec nodoka_envRec;
+typedef struct nodoka_stack nodoka_stack;
+typedef struct nodoka_region nodoka_region;
 
 enum nodoka_completion {
     NODOKA_COMPLETION_NORMAL,
@@ -73,31 +253,121 @@ typedef struct nodoka_global {
     nodoka_object *ReferenceError_prototype;
     nodoka_object *TypeError;
     nodoka_object *TypeError_prototype;
+    nodoka_object *RangeError;
+    nodoka_object *RangeError_prototype;
+    nodoka_stack *stack;
 } nodoka_global;
 
 struct nodoka_config {
     bool peehole;
     bool conv;
     bool fold;
+    /* Maximum number of nested activations before throwing RangeError */
+    size_t stackDepth;
 };
 
-enum nodoka_completion nodoka_exec(nodoka_context *context, nodoka_data **ret);
+enum nodoka_completion nodoka_exec(nodoka_context *context, nodoka_value *ret);
 
 
-int8_t nodoka_absRelComp(nodoka_data *sp1, nodoka_data *sp0);
-bool nodoka_sameValue(nodoka_data *x, nodoka_data *y);
-bool nodoka_strictEqComp(nodoka_data *x, nodoka_data *y);
-bool nodoka_absEqComp(nodoka_data *x, nodoka_data *y);
+int8_t nodoka_absRelComp(nodoka_value sp1, nodoka_value sp0);
+bool nodoka_sameValue(nodoka_value x, nodoka_value y);
+bool nodoka_strictEqComp(nodoka_value x, nodoka_value y);
+bool nodoka_absEqComp(nodoka_value x, nodoka_value y);
 
 void nodoka_printBytecode(nodoka_code *, int indent);
 
 void nodoka_initConstant(void);
 void nodoka_initStringPool(void);
 
-nodoka_data *nodoka_new_data(enum nodoka_data_type type);
 nodoka_string *nodoka_new_string(utf16_string_t str);
-nodoka_number *nodoka_newNumber(double val);
-nodoka_reference *nodoka_newReference(nodoka_data *base, nodoka_string *name);
+nodoka_string *nodoka_newLatin1String(latin1_string_t str);
+nodoka_string *nodoka_newAtom(utf16_string_t str);
+nodoka_reference *nodoka_newReference(nodoka_value base, nodoka_string *name);
+
+enum {
+    NODOKA_GC_PAUSE_BUCKETS = 24,
+};
+
+typedef struct nodoka_gc_stats {
+    size_t minorCollections;
+    /* Completed major collections, and the old space they left live, in bytes */
+    size_t cycles;
+    size_t liveSize;
+    /* Pauses of the collector, in microseconds */
+    size_t pauses;
+    double totalPause;
+    double maxPause;
+    /* Bucket i counts the pauses shorter than 2^i microseconds which are not in bucket i - 1 */
+    size_t pauseHistogram[NODOKA_GC_PAUSE_BUCKETS];
+} nodoka_gc_stats;
+
+/* vm/gc.c */
+nodoka_data *nodoka_new_data(enum nodoka_data_type type);
+nodoka_data *nodoka_newYoungDataSlow(enum nodoka_data_type type);
+nodoka_data *nodoka_tenure(nodoka_data *data);
+void nodoka_shade(void *data);
+nodoka_string *nodoka_resurrect(nodoka_string *str);
+void nodoka_collectGarbage(nodoka_global *global);
+void nodoka_addRoot(nodoka_value *root);
+void nodoka_removeRoot(nodoka_value *root);
+void nodoka_getGCStats(nodoka_gc_stats *stats);
+nodoka_region *nodoka_newRegion(void);
+void nodoka_disposeRegion(nodoka_region *region);
+bool nodoka_inRegion(nodoka_region *region, nodoka_object *obj);
+region_t *nodoka_regionMemory(void);
+
+/* vm/region.c */
+bool nodoka_copyFromRegion(nodoka_region *region, nodoka_value value, nodoka_value *ret);
+
+/* Bytes allocated in the old space since the last major collection */
+extern size_t nodoka_gcAllocated;
+/* Set when a collection is due at the next safe point */
+extern bool nodoka_gcPending;
+/* Set while a major collection is marking */
+extern bool nodoka_gcMarking;
+/* Region new data is allocated in, while a context backed by one runs */
+extern nodoka_region *nodoka_currentRegion;
+/* Bump allocation area of the nursery */
+extern uint8_t *nodoka_nurseryTop;
+extern uint8_t *nodoka_nurseryLimit;
+
+/**
+ * Allocate a short-lived value in the nursery. Values in the nursery must
+ * only be referred to from the VM stack: storing one anywhere in the heap
+ * has to go through nodoka_tenure first.
+ */
+static inline nodoka_data *nodoka_newYoungData(enum nodoka_data_type type, size_t size) {
+    uint8_t *top = nodoka_nurseryTop;
+    if ((size_t)(nodoka_nurseryLimit - top) < size) {
+        return nodoka_newYoungDataSlow(type);
+    }
+    nodoka_nurseryTop = top + size;
+    nodoka_data *data = (nodoka_data *)top;
+    data->type = type;
+    data->marked = false;
+    data->inRegion = false;
+    return data;
+}
+
+/**
+ * Write barrier, to be called with the value a store into the heap is about
+ * to overwrite. Stores to the VM stack need none.
+ */
+static inline void nodoka_writeBarrier(nodoka_value old) {
+    if (nodoka_gcMarking && nodoka_isPointer(old)) {
+        nodoka_shade(nodoka_unbox(old));
+    }
+}
+
+/**
+ * Whether storing value into holder would make data outside of the current
+ * region refer to data in it, which would dangle once the region is gone.
+ * Such stores are to be rejected rather than done.
+ */
+static inline bool nodoka_escapesRegion(void *holder, nodoka_value value) {
+    return nodoka_currentRegion && nodoka_isPointer(value) &&
+           ((nodoka_data *)nodoka_unbox(value))->inRegion && !((nodoka_data *)holder)->inRegion;
+}
 
 
 /* string.c */
@@ -106,36 +376,40 @@ nodoka_string *nodoka_newStringFromUtf8(char *str);
 /* conversion.c */
 nodoka_string *nodoka_newStringFromDouble(double value);
 
-nodoka_data *nodoka_toPrimitive(nodoka_data *value);
-nodoka_data *nodoka_toBoolean(nodoka_data *value);
-nodoka_number *nodoka_toNumber(nodoka_data *value);
-int32_t nodoka_toInt32(nodoka_number *value);
-uint32_t nodoka_toUint32(nodoka_number *value);
-uint16_t nodoka_toUint16(nodoka_number *value);
-nodoka_string *nodoka_toString(nodoka_context *C, nodoka_data *value);
-nodoka_object *nodoka_toObject(nodoka_context *C, nodoka_data *value);
+nodoka_value nodoka_toPrimitive(nodoka_value value);
+bool nodoka_toBoolean(nodoka_value value);
+double nodoka_toNumber(nodoka_value value);
+int32_t nodoka_toInt32(double value);
+uint32_t nodoka_toUint32(double value);
+uint16_t nodoka_toUint16(double value);
+nodoka_string *nodoka_toString(nodoka_context *C, nodoka_value value);
+nodoka_object *nodoka_toObject(nodoka_context *C, nodoka_value value);
 
-nodoka_number *nodoka_str2num(nodoka_string *str);
+nodoka_value nodoka_str2num(nodoka_string *str);
 nodoka_string *nodoka_num2str(double val);
 
 /* vm/string.c */
 nodoka_string *nodoka_concatString(size_t i, ...);
+nodoka_string *nodoka_newRope(nodoka_string *left, nodoka_string *right);
+nodoka_string *nodoka_newSubstring(nodoka_string *str, size_t start, size_t len);
+nodoka_string *nodoka_newCharString(uint16_t unit);
+bool nodoka_equalString(nodoka_string *x, nodoka_string *y);
 nodoka_string *nodoka_newStringDup(utf16_string_t str);
+int nodoka_compareContents(nodoka_string *x, nodoka_string *y);
+utf16_string_t nodoka_toUtf16(nodoka_string *str);
+void nodoka_fputString(FILE *file, nodoka_string *str);
+void nodoka_sweepAtoms(void);
+void nodoka_freeString(nodoka_string *str);
+void nodoka_flushNumberStrings(void);
 
 /* bcloader.c */
 char *nodoka_readFile(char *path, size_t *sizePtr);
 nodoka_code *nodoka_loadBytecode(char *path);
+void nodoka_storeBytecode(char *path, nodoka_code *code);
 
 int nodoka_compareString(void *a, void *b);
 int nodoka_hashString(void *a);
 
-extern nodoka_data *nodoka_null;
-extern nodoka_data *nodoka_undefined;
-extern nodoka_data *nodoka_true;
-extern nodoka_data *nodoka_false;
-extern nodoka_number *nodoka_nan;
-extern nodoka_number *nodoka_zero;
-extern nodoka_number *nodoka_one;
 extern nodoka_string *nodoka_nullStr;
 extern nodoka_string *nodoka_undefStr;
 extern nodoka_string *nodoka_trueStr;
@@ -144,8 +418,10 @@ extern nodoka_string *nodoka_nanStr;
 extern nodoka_string *nodoka_infStr;
 extern nodoka_string *nodoka_negInfStr;
 extern nodoka_string *nodoka_zeroStr;
+extern nodoka_string *nodoka_lengthStr;
+extern nodoka_string *nodoka_charStrings[256];
 
-#define NODOKA_TYPE(data) (((nodoka_data*)(data))->type)
+#define NODOKA_TYPE(value) nodoka_typeOf(value)
 #define assertType(data, type) do{enum nodoka_data_type __type=NODOKA_TYPE(data);assert((__type&(type))==__type);}while(0)
 #define assertPrimitive(data) assertType(data, NODOKA_UNDEF|NODOKA_NULL|NODOKA_BOOL|NODOKA_NUMBER|NODOKA_STRING)
 #define assertNumber(data) assertType(data, NODOKA_NUMBER)
@@ -303,6 +303,41 @@ struct struct_lex {
 
 typedef struct struct_grammar nodoka_grammar;
 
+typedef struct nodoka_variable {
+    utf16_string_t name;
+    /* Referenced from a nested function, thus needs to outlive the frame */
+    bool captured;
+    /* Parameters and the function name have fixed frame slots */
+    bool param;
+    uint16_t local;
+    uint16_t slot;
+} nodoka_variable;
+
+struct nodoka_scope {
+    struct nodoka_scope *outer;
+    nodoka_variable *vars;
+    size_t length;
+    size_t capacity;
+    bool hasSelf;
+    nodoka_variable self;
+    size_t localCount;
+    size_t slotCount;
+    /* Names are resolved at runtime through environment records */
+    bool dynamic;
+};
+
+enum nodoka_binding_type {
+    NODOKA_BINDING_DYNAMIC,
+    NODOKA_BINDING_LOCAL,
+    NODOKA_BINDING_UPVAL,
+};
+
+typedef struct nodoka_binding {
+    enum nodoka_binding_type type;
+    uint16_t depth;
+    uint16_t index;
+} nodoka_binding;
+
 nodoka_lex *lex_new(utf16_string_t utf16);
 void lex_dispose(nodoka_lex *lex);
 nodoka_token *lex_next(nodoka_lex *lex);
@@ -312,6 +347,9 @@ void grammar_dispose(nodoka_grammar *gmr);
 void nodoka_codegen(nodoka_code_emitter *emitter, nodoka_lex_class *node);
 void nodoka_declgen(nodoka_code_emitter *emitter, nodoka_lex_class *node);
 void nodoka_disposeLexNode(nodoka_lex_class *node);
+nodoka_scope *nodoka_newScope(nodoka_scope *outer, nodoka_node_list *func);
+void nodoka_disposeScope(nodoka_scope *scope);
+nodoka_binding nodoka_resolveBinding(nodoka_scope *scope, utf16_string_t name);
 nodoka_lex_class *grammar_program(nodoka_grammar *gmr);
 
 #endif
@@ -7,27 +7,126 @@
 
 struct nodoka_prop_desc {
     nodoka_data base;
-    nodoka_data *value;
-    nodoka_data *get;
-    nodoka_data *set;
-    nodoka_data *writable;
-    nodoka_data *enumerable;
-    nodoka_data *configurable;
+    nodoka_value value;
+    nodoka_value get;
+    nodoka_value set;
+    nodoka_value writable;
+    nodoka_value enumerable;
+    nodoka_value configurable;
 };
 
-typedef nodoka_prop_desc *(*nodoka_getOwnProperty_func)(nodoka_object *O, nodoka_string *P);
-typedef enum nodoka_completion(*nodoka_construct_func)(nodoka_context *C, nodoka_object *O, nodoka_data **ret, int argc, nodoka_data **argv);
-typedef enum nodoka_completion(*nodoka_call_func)(nodoka_context *C, nodoka_object *O, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv);
+enum {
+    /* Slots held in the object itself, before an array is allocated */
+    NODOKA_INLINE_SLOTS = 4,
+    /* Objects with more properties are switched to dictionary mode */
+    NODOKA_MAX_SHAPE_PROPERTIES = 64,
+    /* Arrays growing by more than this past twice their storage get dictionary elements */
+    NODOKA_MAX_ELEMENTS_GAP = 1024,
+};
+
+enum {
+    NODOKA_WRITABLE = 1,
+    NODOKA_ENUMERABLE = 2,
+    NODOKA_CONFIGURABLE = 4,
+    /* The value is a nodoka_prop_desc holding the getter and the setter */
+    NODOKA_ACCESSOR = 8,
+    /* Attributes of properties created by assignment */
+    NODOKA_DEFAULT_ATTRIBUTES = NODOKA_WRITABLE | NODOKA_ENUMERABLE | NODOKA_CONFIGURABLE,
+};
+
+/**
+ * A property as an object keeps it, with its attributes packed next to its
+ * value. Descriptors are only made from it for the APIs which take or
+ * return one.
+ */
+typedef struct nodoka_property {
+    nodoka_value value;
+    uint32_t attributes;
+} nodoka_property;
+
+/**
+ * How the elements of an array are kept. Packed and holey elements are
+ * kept in an array indexed directly, holey ones having holes for the
+ * missing ones. Dictionary elements are ordinary properties, for arrays
+ * too sparse to be kept densely or with elements which are not plain
+ * writable, enumerable and configurable data. Objects which are not arrays
+ * have no elements, and array index names are ordinary properties for them.
+ */
+enum nodoka_elements_kind {
+    NODOKA_ELEMENTS_NONE,
+    NODOKA_ELEMENTS_PACKED,
+    NODOKA_ELEMENTS_HOLEY,
+    NODOKA_ELEMENTS_DICTIONARY,
+};
+
+/**
+ * Representation of packed and holey elements. Arrays holding only int32 or
+ * only numbers keep them unboxed, and move to a more general representation
+ * when another value is stored, never back. Int32 elements have no hole to
+ * mark missing ones with, so holey arrays hold doubles at least, whose holes
+ * are NODOKA_HOLE_BITS. The holes of values are nodoka_empty.
+ */
+enum nodoka_elements_type {
+    NODOKA_ELEMENTS_INT32,
+    NODOKA_ELEMENTS_DOUBLE,
+    NODOKA_ELEMENTS_VALUE,
+};
+
+/* A NaN that is never stored, as all NaNs are folded into nodoka_nan */
+#define NODOKA_HOLE_BITS 0x7FF4000000000000ULL
+
+/**
+ * Layout of the properties of an object. Objects which had the same
+ * properties added in the same order share a shape, which maps each name to
+ * the slot holding the property. Shapes form a tree rooted at
+ * nodoka_emptyShape, each one adding a property to its parent.
+ */
+typedef struct nodoka_shape nodoka_shape;
+struct nodoka_shape {
+    nodoka_data base;
+    nodoka_shape *parent;
+    /* Property added to the parent, which is in slot count - 1 */
+    nodoka_string *name;
+    uint32_t count;
+    /* Children by the name they add. They are held weakly */
+    hashmap_t *transitions;
+    /* Slots by name, built on demand for shapes too large to be walked */
+    hashmap_t *table;
+};
+
+/* Copies the own property P of O to prop, returns false if there is none */
+typedef bool (*nodoka_getOwnProperty_func)(nodoka_object *O, nodoka_string *P, nodoka_property *prop);
+typedef enum nodoka_completion(*nodoka_construct_func)(nodoka_context *C, nodoka_object *O, nodoka_value *ret, int argc, nodoka_value *argv);
+typedef enum nodoka_completion(*nodoka_call_func)(nodoka_context *C, nodoka_object *O, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv);
 
 
 struct nodoka_object {
     nodoka_data base;
+    /* Layout of the slots, or NULL in dictionary mode where prop maps names to properties */
+    nodoka_shape *shape;
+    nodoka_property *slots;
+    uint32_t capacity;
     hashmap_t *prop;
+    /* Region the object is allocated in, if any */
+    region_t *region;
+    /*
+     * Elements of arrays, and the array length. Storage past the length is
+     * always holes, and there is none unless the elements are dense
+     */
+    enum nodoka_elements_kind elementsKind;
+    enum nodoka_elements_type elementsType;
+    uint32_t length;
+    uint32_t elementsCapacity;
+    union {
+        int32_t *int32s;
+        double *doubles;
+        nodoka_value *values;
+    } elements;
     nodoka_object *prototype;
     nodoka_string *_class;
     nodoka_getOwnProperty_func getOwnProperty;
 
-    nodoka_data *primitiveValue;
+    nodoka_value primitiveValue;
     nodoka_construct_func construct;
     nodoka_call_func call;
     // bool HasInstance(any)
@@ -39,29 +138,81 @@ struct nodoka_object {
     } formalParameters;
     nodoka_code *code;
     nodoka_object *targetFunction;
-    nodoka_data *boundThis;
+    nodoka_value boundThis;
     struct {
         size_t length;
-        nodoka_data **array;
+        nodoka_value *array;
     } boundArguments;
 
     nodoka_string *codeString;
     bool extensible;
+    nodoka_property inlineSlots[NODOKA_INLINE_SLOTS];
 };
 
 nodoka_prop_desc *nodoka_getOwnProperty(nodoka_object *O, nodoka_string *P);
+nodoka_property *nodoka_findOwnProperty(nodoka_object *O, nodoka_string *P);
 nodoka_prop_desc *nodoka_getProperty(nodoka_object *O, nodoka_string *P);
-nodoka_data *nodoka_get(nodoka_object *O, nodoka_string *P);
+nodoka_property *nodoka_getCacheableProperty(nodoka_object *O, nodoka_string *P, nodoka_object **holder);
+nodoka_value nodoka_get(nodoka_object *O, nodoka_string *P);
 bool nodoka_canPut(nodoka_object *O, nodoka_string *P);
-void nodoka_put(nodoka_object *O, nodoka_string *P, nodoka_data *V, bool throw);
+bool nodoka_put(nodoka_object *O, nodoka_string *P, nodoka_value V, bool throw);
 bool nodoka_hasProperty(nodoka_object *O, nodoka_string *P);
 bool nodoka_delete(nodoka_object *O, nodoka_string *P, bool throw);
-nodoka_data *nodoka_defaultValue(nodoka_context *C, nodoka_object *O, enum nodoka_data_type hint);
+nodoka_value nodoka_defaultValue(nodoka_context *C, nodoka_object *O, enum nodoka_data_type hint);
 bool nodoka_defineOwnProperty(nodoka_object *O, nodoka_string *P, nodoka_prop_desc *desc, bool throw);
+bool nodoka_isArrayIndex(nodoka_string *P, uint32_t *index);
+bool nodoka_putElement(nodoka_object *O, uint32_t index, nodoka_value V);
+bool nodoka_setArrayLength(nodoka_object *O, uint32_t length);
 
-enum nodoka_completion nodoka_call(nodoka_context *global, nodoka_object *O, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv);
-enum nodoka_completion nodoka_construct(nodoka_context *global, nodoka_object *O, nodoka_data **ret, int argc, nodoka_data **argv);
+/* Element kept densely, or nodoka_empty if it has to be looked up as a property */
+static inline nodoka_value nodoka_getElement(nodoka_object *O, uint32_t index) {
+    if (O->elementsType == NODOKA_ELEMENTS_INT32) {
+        /* Int32 elements are packed */
+        return index < O->length ? nodoka_fromInt32(O->elements.int32s[index]) : nodoka_empty;
+    }
+    if (index >= O->elementsCapacity) {
+        return nodoka_empty;
+    }
+    if (O->elementsType == NODOKA_ELEMENTS_VALUE) {
+        return O->elements.values[index];
+    }
+    double value = O->elements.doubles[index];
+    return double2int(value) == NODOKA_HOLE_BITS ? nodoka_empty : nodoka_fromNumber(value);
+}
 
+/* Replace an element kept densely, returns false if there is none or V does not fit */
+static inline bool nodoka_replaceElement(nodoka_object *O, uint32_t index, nodoka_value V) {
+    switch (O->elementsType) {
+        case NODOKA_ELEMENTS_INT32:
+            if (index >= O->length || !nodoka_isInt32(V)) {
+                return false;
+            }
+            O->elements.int32s[index] = nodoka_getInt32(V);
+            return true;
+        case NODOKA_ELEMENTS_DOUBLE:
+            if (index >= O->elementsCapacity || double2int(O->elements.doubles[index]) == NODOKA_HOLE_BITS
+                    || !nodoka_isNumber(V)) {
+                return false;
+            }
+            O->elements.doubles[index] = nodoka_getNumber(V);
+            return true;
+        default:
+            if (index >= O->elementsCapacity || !O->elements.values[index]) {
+                return false;
+            }
+            nodoka_writeBarrier(O->elements.values[index]);
+            O->elements.values[index] = V;
+            return true;
+    }
+}
+
+enum nodoka_completion nodoka_call(nodoka_context *global, nodoka_object *O, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv);
+enum nodoka_completion nodoka_construct(nodoka_context *global, nodoka_object *O, nodoka_value *ret, int argc, nodoka_value *argv);
+nodoka_context *nodoka_newFunctionContext(nodoka_context *C, nodoka_object *O, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv);
+nodoka_context *nodoka_newConstructContext(nodoka_context *C, nodoka_object *O, nodoka_value *ret, int argc, nodoka_value *argv);
+
+
+extern size_t nodoka_propertyEpoch;
 
 /* prop.c */
 bool nodoka_isDataDescriptor(nodoka_prop_desc *desc);
@@ -69,7 +220,15 @@ bool nodoka_isAccessorDescriptor(nodoka_prop_desc *desc);
 bool nodoka_isGenericDescriptor(nodoka_prop_desc *desc);
 
 nodoka_prop_desc *nodoka_newPropertyDesc(void);
+nodoka_prop_desc *nodoka_newDescFromProperty(nodoka_property *prop);
 
 nodoka_object *nodoka_newNativeObject(void);
 
+/* shape.c */
+extern nodoka_shape *nodoka_emptyShape;
+void nodoka_initShapes(void);
+nodoka_shape *nodoka_addToShape(nodoka_shape *shape, nodoka_string *name);
+int32_t nodoka_lookupShape(nodoka_shape *shape, nodoka_string *name);
+void nodoka_sweepTransitions(void);
+
 #endif
\ No newline at end of file
@@ -21,15 +21,23 @@ typedef struct {
     size_t len;
 } utf16_string_t;
 
+/* UTF-16 code units which are all below 0x100, one byte each */
+typedef struct {
+    uint8_t *str;
+    size_t len;
+} latin1_string_t;
+
 #define UTF8_STRING(str_lit) ((utf8_string_t){.str=(uint8_t*)(str_lit), .len=strlen(str_lit)})
 
 size_t unicode_countAsUtf16(utf8_string_t utf8);
 size_t unicode_countAsUtf8(utf16_string_t utf16);
 utf16_string_t unicode_toUtf16(utf8_string_t utf8);
 utf8_string_t unicode_toUtf8(utf16_string_t utf16);
+utf8_string_t unicode_latin1ToUtf8(latin1_string_t latin1);
 void unicode_putUtf8(utf8_string_t utf8);
 void unicode_putUtf16(utf16_string_t utf16);
 void unicode_fputUtf8(FILE *file, utf8_string_t utf8);
 void unicode_fputUtf16(FILE *file, utf16_string_t utf16);
+void unicode_fputLatin1(FILE *file, latin1_string_t latin1);
 
 #endif
@@ -3,4 +3,5 @@
 
 int unicode_utf16Cmp(void *s1, void *s2);
 int unicode_utf16Hash(void *key);
+int unicode_latin1Hash(void *key);
 hashmap_t *hashmap_new_utf16(int size);
\ No newline at end of file
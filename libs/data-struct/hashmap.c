@@ -3,27 +3,39 @@
 #include "c/stdint.h"
 
 #include "data-struct/hashmap.h"
+#include "data-struct/slab.h"
+#include "data-struct/region.h"
 
-typedef struct str_node {
+/*
+ * Entries are kept in an array in insertion order, which is what iteration
+ * walks, and are found through an open-addressed index holding their
+ * positions. Removed entries stay in place with no key, until the array
+ * fills up and is rebuilt without them, so that neither iteration nor
+ * removal allocates or moves anything.
+ */
+typedef struct {
+    pair_t kp;
     int hash;
-    void *key;
-    void *data;
-    struct str_node *next;
-} node_t;
+} entry_t;
 
 struct str_hashmap {
     comparator_t compare;
     hash_t hash;
-    int size;
-    node_t *node[0];
+    /* Where the arrays come from, if not from the slab allocator */
+    region_t *region;
+    /* Preceded by an entry iteration starts from, and followed by one with endMarker as key */
+    entry_t *entries;
+    uint32_t capacity;
+    /* Entries taken, including removed ones */
+    uint32_t used;
+    uint32_t count;
+    /* The index has twice as many slots as there are entries, -1 when empty */
+    uint32_t shift;
+    int32_t *index;
 };
 
-typedef struct {
-    pair_t kp;
-    hashmap_t *hm;
-    int index;
-    node_t *next;
-} iterator_t;
+/* Key of the entry past the last one */
+static char endMarker;
 
 int string_comparator(void *a, void *b) {
     return strcmp(a, b);
@@ -42,111 +54,164 @@ hashmap_t *hashmap_new_string(int size) {
     return hashmap_new(string_hash, string_comparator, size);
 }
 
+int pointer_comparator(void *a, void *b) {
+    return a != b;
+}
+
+int pointer_hash(void *key) {
+    uintptr_t h = (uintptr_t)key;
+    return (int)(h >> 4 ^ h >> 20);
+}
+
+/* Hashmap keyed by identity */
+hashmap_t *hashmap_new_pointer(int size) {
+    return hashmap_new(pointer_hash, pointer_comparator, size);
+}
+
 hashmap_t *hashmap_new(hash_t h, comparator_t c, int size) {
-    hashmap_t *hm = malloc(sizeof(hashmap_t) + sizeof(node_t *)*size);
+    return hashmap_new_region(h, c, size, NULL);
+}
+
+static void *allocate(hashmap_t *hm, size_t size) {
+    return hm->region ? region_alloc(hm->region, size) : slab_alloc(size);
+}
+
+static void release(hashmap_t *hm, void *ptr, size_t size) {
+    if (!hm->region) {
+        slab_free(ptr, size);
+    }
+}
+
+static size_t arraysSize(uint32_t capacity) {
+    return (capacity + 2) * sizeof(entry_t) + capacity * 2 * sizeof(int32_t);
+}
+
+static uint32_t slotOf(hashmap_t *hm, int hash) {
+    return (uint32_t)hash * 0x9E3779B1u >> hm->shift;
+}
+
+/* Slot of the index for the entry of key, which is empty if there is none */
+static int32_t *lookup(hashmap_t *hm, void *key, int hash) {
+    uint32_t mask = hm->capacity * 2 - 1;
+    for (uint32_t i = slotOf(hm, hash);; i = (i + 1) & mask) {
+        int32_t *slot = &hm->index[i];
+        if (*slot < 0) {
+            return slot;
+        }
+        entry_t *entry = &hm->entries[*slot];
+        /* Keys which are the same are equal, whatever they are */
+        if (entry->hash == hash && entry->kp.first
+                && (entry->kp.first == key || hm->compare(entry->kp.first, key) == 0)) {
+            return slot;
+        }
+    }
+}
+
+/* Move the entries which are not removed to new arrays, for capacity entries */
+static void resize(hashmap_t *hm, uint32_t capacity) {
+    entry_t *old = hm->entries;
+    uint32_t oldCapacity = hm->capacity;
+    uint32_t oldUsed = hm->used;
+    entry_t *block = allocate(hm, arraysSize(capacity));
+    block[0].kp.first = NULL;
+    hm->entries = block + 1;
+    hm->index = (int32_t *)(hm->entries + capacity + 1);
+    memset(hm->index, 0xFF, capacity * 2 * sizeof(int32_t));
+    hm->capacity = capacity;
+    hm->shift = 32;
+    for (uint32_t i = capacity * 2; i > 1; i >>= 1) {
+        hm->shift--;
+    }
+    hm->used = 0;
+    for (uint32_t i = 0; i < oldUsed; i++) {
+        if (old[i].kp.first) {
+            *lookup(hm, old[i].kp.first, old[i].hash) = hm->used;
+            hm->entries[hm->used++] = old[i];
+        }
+    }
+    hm->entries[hm->used].kp.first = &endMarker;
+    if (old) {
+        release(hm, old - 1, arraysSize(oldCapacity));
+    }
+}
+
+/*
+ * Hashmap allocated in the region, which is disposed of along with it. The
+ * size is the number of entries it is expected to hold, it grows past it.
+ */
+hashmap_t *hashmap_new_region(hash_t h, comparator_t c, int size, region_t *region) {
+    hashmap_t *hm = region ? region_alloc(region, sizeof(hashmap_t)) : slab_alloc(sizeof(hashmap_t));
+    hm->region = region;
     hm->compare = c;
     hm->hash = h;
-    hm->size = size;
-    int i;
-    for (i = 0; i < size; i++) {
-        hm->node[i] = NULL;
+    hm->entries = NULL;
+    hm->capacity = 0;
+    hm->used = 0;
+    hm->count = 0;
+    uint32_t capacity = 4;
+    while (capacity < (uint32_t)size) {
+        capacity *= 2;
     }
+    resize(hm, capacity);
     return hm;
 }
 
 bool hashmap_put(hashmap_t *hm, void *key, void *data) {
     int hash = hm->hash(key);
-    int bucket = (unsigned int)hash % hm->size;
-    node_t **n = &hm->node[bucket];
-    while (*n != NULL) {
-        node_t *c = *n;
-        if (c->hash == hash && hm->compare(c->key, key) == 0) {
-            c->data = data;
-            return false;
-        }
-        n = &c->next;
+    int32_t *slot = lookup(hm, key, hash);
+    if (*slot >= 0) {
+        hm->entries[*slot].kp.second = data;
+        return false;
     }
-    *n = malloc(sizeof(node_t));
-    node_t *mn = *n;
-    mn->hash = hash;
-    mn->key = key;
-    mn->data = data;
-    mn->next = NULL;
+    if (hm->used == hm->capacity) {
+        /* Grow unless dropping the removed entries leaves enough room */
+        resize(hm, hm->count >= hm->capacity / 2 ? hm->capacity * 2 : hm->capacity);
+        slot = lookup(hm, key, hash);
+    }
+    *slot = hm->used;
+    entry_t *entry = &hm->entries[hm->used++];
+    entry->kp.first = key;
+    entry->kp.second = data;
+    entry->hash = hash;
+    hm->entries[hm->used].kp.first = &endMarker;
+    hm->count++;
     return true;
 }
 
 void *hashmap_get(hashmap_t *hm, void *key) {
-    int hash = hm->hash(key);
-    int bucket = (unsigned int)hash % hm->size;
-    node_t **n = &hm->node[bucket];
-    while (*n != NULL) {
-        node_t *c = *n;
-        if (c->hash == hash && hm->compare(c->key, key) == 0) {
-            return c->data;
-        }
-        n = &c->next;
-    }
-    return NULL;
+    int32_t slot = *lookup(hm, key, hm->hash(key));
+    return slot < 0 ? NULL : hm->entries[slot].kp.second;
 }
 
+/* The slot is left pointing to the removed entry, for lookups to probe past it */
 void *hashmap_remove(hashmap_t *hm, void *key) {
-    int hash = hm->hash(key);
-    int bucket = (unsigned int)hash % hm->size;
-    node_t **n = &hm->node[bucket];
-    while (*n != NULL) {
-        node_t *c = *n;
-        if (c->hash == hash && hm->compare(c->key, key) == 0) {
-            *n = c->next;
-            void *data = c->data;
-            free(c);
-            return data;
-        }
-        n = &c->next;
+    int32_t slot = *lookup(hm, key, hm->hash(key));
+    if (slot < 0) {
+        return NULL;
     }
-    return NULL;
+    entry_t *entry = &hm->entries[slot];
+    entry->kp.first = NULL;
+    hm->count--;
+    return entry->kp.second;
 }
 
 void hashmap_dispose(hashmap_t *hm) {
-    int i;
-    for (i = 0; i < hm->size; i++) {
-        node_t *mn = hm->node[i];
-        while (mn != NULL) {
-            node_t *m = mn;
-            mn = m->next;
-            free(m);
-        }
+    if (hm->region) {
+        return;
     }
-    free(hm);
+    release(hm, hm->entries - 1, arraysSize(hm->capacity));
+    slab_free(hm, sizeof(hashmap_t));
 }
 
+/* Entries are iterated in insertion order, and may be removed meanwhile but not added */
 pair_t *hashmap_iterator(hashmap_t *hm) {
-    iterator_t *i = malloc(sizeof(iterator_t));
-    i->kp.first = NULL;
-    i->kp.second = NULL;
-    i->hm = hm;
-    i->index = -1;
-    i->next = NULL;
-    return &i->kp;
+    return &hm->entries[-1].kp;
 }
 
 pair_t *hashmap_next(pair_t *it) {
-    iterator_t *i = (iterator_t *)it;
-    if (i->next) {
-        i->kp.first = i->next->key;
-        i->kp.second = i->next->data;
-        i->next = i->next->next;
-        return &i->kp;
-    } else {
-        for (i->index++; i->index < i->hm->size; i->index++) {
-            node_t *mn = i->hm->node[i->index];
-            if (mn != NULL) {
-                i->kp.first = mn->key;
-                i->kp.second = mn->data;
-                i->next = mn->next;
-                return &i->kp;
-            }
-        }
-        free(i);
-        return NULL;
-    }
+    entry_t *entry = (entry_t *)it;
+    do {
+        entry++;
+    } while (!entry->kp.first);
+    return entry->kp.first == &endMarker ? NULL : &entry->kp;
 }
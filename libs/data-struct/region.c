@@ -0,0 +1,88 @@
+#include "c/stdint.h"
+#include "c/stdlib.h"
+
+#include "data-struct/region.h"
+
+enum {
+    CHUNK_SIZE = 64 * 1024,
+    ALIGNMENT = 16,
+};
+
+typedef struct chunk {
+    struct chunk *next;
+    char *end;
+    char data[];
+} chunk_t;
+
+struct region {
+    chunk_t *chunks;
+    char *top;
+    char *limit;
+    size_t size;
+};
+
+region_t *region_new(void) {
+    region_t *region = malloc(sizeof(region_t));
+    region->chunks = NULL;
+    region->top = NULL;
+    region->limit = NULL;
+    region->size = 0;
+    return region;
+}
+
+static chunk_t *newChunk(region_t *region, size_t size) {
+    chunk_t *chunk = malloc(sizeof(chunk_t) + size);
+    if (!chunk) {
+        return NULL;
+    }
+    chunk->end = chunk->data + size;
+    region->size += size;
+    return chunk;
+}
+
+void *region_alloc(region_t *region, size_t size) {
+    size = (size + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+    if (size > (size_t)(region->limit - region->top)) {
+        /* Large blocks get a chunk of their own, and bumping goes on in the current one */
+        if (size > CHUNK_SIZE / 4) {
+            chunk_t *chunk = newChunk(region, size);
+            if (!chunk) {
+                return NULL;
+            }
+            if (region->chunks) {
+                chunk->next = region->chunks->next;
+                region->chunks->next = chunk;
+            } else {
+                chunk->next = NULL;
+                region->chunks = chunk;
+            }
+            return chunk->data;
+        }
+        chunk_t *chunk = newChunk(region, CHUNK_SIZE);
+        if (!chunk) {
+            return NULL;
+        }
+        chunk->next = region->chunks;
+        region->chunks = chunk;
+        region->top = chunk->data;
+        region->limit = chunk->end;
+    }
+    void *block = region->top;
+    region->top += size;
+    return block;
+}
+
+/* Number of bytes taken from the system */
+size_t region_size(region_t *region) {
+    return region->size;
+}
+
+void region_dispose(region_t *region) {
+    chunk_t *chunk = region->chunks;
+    while (chunk) {
+        chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(region);
+}
@@ -0,0 +1,137 @@
+#include "c/assert.h"
+#include "c/stdbool.h"
+#include "c/stdint.h"
+#include "c/stdlib.h"
+
+#include "data-struct/slab.h"
+
+/*
+ * A page holds blocks of a single size class. Blocks are handed out from the
+ * free list of the page first, then by bumping through the part of the page
+ * never used yet. Pages with a free block are linked in the list of their
+ * class, and a page whose blocks are all freed is given back.
+ */
+typedef struct slab_page page_t;
+struct slab_page {
+    page_t *prev;
+    page_t *next;
+    void *free;
+    char *bump;
+    size_t used;
+    size_t sizeClass;
+    bool partial;
+};
+
+typedef struct {
+    page_t *partial;
+    slab_stats_t stats;
+} class_t;
+
+enum {
+    HEADER_SIZE = (sizeof(page_t) + SLAB_GRANULE - 1) / SLAB_GRANULE * SLAB_GRANULE,
+};
+
+static class_t classes[SLAB_CLASSES];
+
+static void linkPage(class_t *cls, page_t *page) {
+    page->prev = NULL;
+    page->next = cls->partial;
+    if (cls->partial) {
+        cls->partial->prev = page;
+    }
+    cls->partial = page;
+    page->partial = true;
+}
+
+static void unlinkPage(class_t *cls, page_t *page) {
+    if (page->prev) {
+        page->prev->next = page->next;
+    } else {
+        cls->partial = page->next;
+    }
+    if (page->next) {
+        page->next->prev = page->prev;
+    }
+    page->partial = false;
+}
+
+static page_t *newPage(size_t sizeClass) {
+    void *mem;
+    if (posix_memalign(&mem, SLAB_PAGE_SIZE, SLAB_PAGE_SIZE)) {
+        return NULL;
+    }
+    page_t *page = mem;
+    page->free = NULL;
+    page->bump = (char *)page + HEADER_SIZE;
+    page->used = 0;
+    page->sizeClass = sizeClass;
+    linkPage(&classes[sizeClass], page);
+    classes[sizeClass].stats.pages++;
+    return page;
+}
+
+static bool isFull(page_t *page, size_t size) {
+    return !page->free && page->bump + size > (char *)page + SLAB_PAGE_SIZE;
+}
+
+void *slab_alloc(size_t size) {
+    if (size > SLAB_MAX_SIZE) {
+        return malloc(size);
+    }
+    size_t sizeClass = size ? (size - 1) / SLAB_GRANULE : 0;
+    size = (sizeClass + 1) * SLAB_GRANULE;
+    class_t *cls = &classes[sizeClass];
+    page_t *page = cls->partial;
+    if (!page) {
+        page = newPage(sizeClass);
+        if (!page) {
+            return NULL;
+        }
+    }
+    void *block;
+    if (page->free) {
+        block = page->free;
+        page->free = *(void **)block;
+    } else {
+        block = page->bump;
+        page->bump += size;
+    }
+    page->used++;
+    if (isFull(page, size)) {
+        unlinkPage(cls, page);
+    }
+    cls->stats.allocations++;
+    return block;
+}
+
+void slab_free(void *ptr, size_t size) {
+    if (size > SLAB_MAX_SIZE) {
+        free(ptr);
+        return;
+    }
+    if (!ptr) {
+        return;
+    }
+    page_t *page = (page_t *)((uintptr_t)ptr & ~(uintptr_t)(SLAB_PAGE_SIZE - 1));
+    class_t *cls = &classes[page->sizeClass];
+    assert(page->sizeClass == (size ? (size - 1) / SLAB_GRANULE : 0));
+    *(void **)ptr = page->free;
+    page->free = ptr;
+    page->used--;
+    cls->stats.frees++;
+    if (!page->partial) {
+        linkPage(cls, page);
+    } else if (!page->used && (page->prev || page->next)) {
+        /* The last page with room is kept, not to thrash on a single block */
+        unlinkPage(cls, page);
+        cls->stats.pages--;
+        free(page);
+    }
+}
+
+void slab_stats(slab_stats_t stats[SLAB_CLASSES]) {
+    for (size_t i = 0; i < SLAB_CLASSES; i++) {
+        stats[i] = classes[i].stats;
+        stats[i].size = (i + 1) * SLAB_GRANULE;
+    }
+}
@@ -6,9 +6,22 @@
 #include "c/stdlib.h"
 #include "c/stdio.h"
 
-static uint16_t read16(char *buffer, size_t *ptr) {
-    uint16_t val = (buffer[*ptr] << 8) | buffer[*ptr + 1];
-    *ptr += 2;
+/* Position in a bytecode file being loaded, which may be truncated or malformed */
+struct reader {
+    uint8_t *buffer;
+    size_t size;
+    size_t ptr;
+    bool error;
+};
+
+static uint16_t read16(struct reader *r) {
+    if (r->size - r->ptr < 2) {
+        r->error = true;
+        r->ptr = r->size;
+        return 0;
+    }
+    uint16_t val = (r->buffer[r->ptr] << 8) | r->buffer[r->ptr + 1];
+    r->ptr += 2;
     return val;
 }
 
@@ -44,13 +57,17 @@ void nodoka_writeFile(char *path, char *buffer, size_t size) {
     assert(numwrite == size);
 }
 
-static nodoka_string *readConstString(char *buffer, size_t *ptr) {
-    size_t length = read16(buffer, ptr);
+static nodoka_string *readConstString(struct reader *r) {
+    size_t length = read16(r);
+    if (r->size - r->ptr < length * 2) {
+        r->error = true;
+        return NULL;
+    }
     uint16_t *str = malloc(length * sizeof(uint16_t));
     for (int i = 0; i < length; i++) {
-        str[i] = read16(buffer, ptr);
+        str[i] = read16(r);
     }
-    return nodoka_new_string((utf16_string_t) {
+    return nodoka_newAtom((utf16_string_t) {
         .len = length,
          .str = str
     });
@@ -70,31 +87,70 @@ static void writeConstString(char *buffer, size_t *ptr, nodoka_string *string) {
     }
     write16(buffer, ptr, string->value.len);
     for (int i = 0; i < string->value.len; i++) {
-        write16(buffer, ptr, string->value.str[i]);
+        write16(buffer, ptr, nodoka_charAt(string, i));
     }
 }
 
-static nodoka_code *readConstCodeSegment(char *buffer, size_t *ptr) {
+/*
+ * Read a code and the codes it contains, which are verified before they are
+ * decoded. Codes left over by a malformed file are reclaimed by the collector.
+ */
+static nodoka_code *readConstCodeSegment(struct reader *r) {
     nodoka_code *code = (nodoka_code *)nodoka_new_data(NODOKA_CODE);
-    code->strPoolLength = read16(buffer, ptr);
-    code->codePoolLength = read16(buffer, ptr);
-    code->bytecodeLength = read16(buffer, ptr);
+    code->strPoolLength = read16(r);
+    code->codePoolLength = read16(r);
+    code->bytecodeLength = read16(r);
     code->stringPool = malloc(code->strPoolLength * sizeof(nodoka_string *));
     code->codePool = malloc(code->codePoolLength * sizeof(nodoka_code *));
     code->bytecode = malloc(code->bytecodeLength);
+    code->wordcode = NULL;
+    code->handlers = NULL;
+    code->wordHandlers = NULL;
+    code->caches = NULL;
+    code->handlerLength = 0;
+    code->formalParameters.length = 0;
+    code->formalParameters.array = NULL;
+    code->name = NULL;
     for (int i = 0; i < code->strPoolLength; i++) {
-        code->stringPool[i] = readConstString(buffer, ptr);
+        code->stringPool[i] = readConstString(r);
     }
     for (int i = 0; i < code->codePoolLength; i++) {
-        code->codePool[i] = readConstCodeSegment(buffer, ptr);
+        code->codePool[i] = r->error ? NULL : readConstCodeSegment(r);
+        if (!code->codePool[i]) {
+            code->codePoolLength = i;
+            r->error = true;
+            break;
+        }
     }
-    memcpy(code->bytecode, &buffer[*ptr], code->bytecodeLength);
-    *ptr += code->bytecodeLength;
-    code->formalParameters.length = read16(buffer, ptr);
-    for (int i = 0; i < code->formalParameters.length; i++) {
-        code->formalParameters.array[i] = readConstString(buffer, ptr);
+    if (r->error || r->size - r->ptr < code->bytecodeLength) {
+        r->error = true;
+        return NULL;
+    }
+    memcpy(code->bytecode, &r->buffer[r->ptr], code->bytecodeLength);
+    r->ptr += code->bytecodeLength;
+    code->handlerLength = read16(r);
+    code->handlers = malloc(code->handlerLength * sizeof(nodoka_handler));
+    for (int i = 0; i < code->handlerLength; i++) {
+        code->handlers[i].start = read16(r);
+        code->handlers[i].end = read16(r);
+        code->handlers[i].handler = read16(r);
+        code->handlers[i].depth = read16(r);
+    }
+    size_t paramLength = read16(r);
+    code->formalParameters.array = malloc(paramLength * sizeof(nodoka_string *));
+    for (int i = 0; i < paramLength && !r->error; i++) {
+        code->formalParameters.array[i] = readConstString(r);
+        code->formalParameters.length = i + 1;
+    }
+    code->name = readConstString(r);
+    code->localCount = read16(r);
+    code->slotCount = read16(r);
+    code->dynamicScope = read16(r);
+    if (r->error || !nodoka_verifyCode(code)) {
+        r->error = true;
+        return NULL;
     }
-    code->name = readConstString(buffer, ptr);
+    nodoka_decodeCode(code);
     return code;
 }
 
@@ -110,11 +166,21 @@ static void writeConstCode(char *buffer, size_t *ptr, nodoka_code *code) {
     }
     memcpy(&buffer[*ptr], code->bytecode, code->bytecodeLength);
     *ptr += code->bytecodeLength;
+    write16(buffer, ptr, code->handlerLength);
+    for (int i = 0; i < code->handlerLength; i++) {
+        write16(buffer, ptr, code->handlers[i].start);
+        write16(buffer, ptr, code->handlers[i].end);
+        write16(buffer, ptr, code->handlers[i].handler);
+        write16(buffer, ptr, code->handlers[i].depth);
+    }
     write16(buffer, ptr, code->formalParameters.length);
     for (int i = 0; i < code->formalParameters.length; i++) {
         writeConstString(buffer, ptr, code->formalParameters.array[i]);
     }
     writeConstString(buffer, ptr, code->name);
+    write16(buffer, ptr, code->localCount);
+    write16(buffer, ptr, code->slotCount);
+    write16(buffer, ptr, code->dynamicScope);
 }
 
 static size_t countCode(nodoka_code *code) {
@@ -127,6 +193,7 @@ static size_t countCode(nodoka_code *code) {
     }
 
     size += code->bytecodeLength;
+    size += 2 + code->handlerLength * 8;
 
     {
         size += 2;
@@ -136,33 +203,41 @@ static size_t countCode(nodoka_code *code) {
     }
 
     size += countString(code->name);
+    size += 6;
     return size;
 }
 
+static const char magic[8] = {0, 'n', 'o', 'd', 'o', 'k', 'a', 0};
+
+/* Load a bytecode file, or return NULL if it cannot be read or is malformed */
 nodoka_code *nodoka_loadBytecode(char *path) {
     size_t size;
     char *buffer = nodoka_readFile(path, &size);
     if (!buffer) {
         return NULL;
     }
-    size_t ptr = 8;
-    nodoka_code *code = readConstCodeSegment(buffer, &ptr);
+    if (size < 8 || memcmp(buffer, magic, 8) != 0) {
+        free(buffer);
+        return NULL;
+    }
+    struct reader r = {
+        .buffer = (uint8_t *)buffer,
+         .size = size,
+          .ptr = 8,
+           .error = false
+    };
+    nodoka_code *code = readConstCodeSegment(&r);
     free(buffer);
-    assert(ptr == size);
+    if (r.ptr != size) {
+        return NULL;
+    }
     return code;
 }
 
 void nodoka_storeBytecode(char *path, nodoka_code *code) {
     size_t size = countCode(code) + 8;
     char *buffer = malloc(size);
-    buffer[0] = 0;
-    buffer[1] = 'n';
-    buffer[2] = 'o';
-    buffer[3] = 'd';
-    buffer[4] = 'o';
-    buffer[5] = 'k';
-    buffer[6] = 'a';
-    buffer[7] = 0;
+    memcpy(buffer, magic, 8);
     size_t ptr = 8;
     writeConstCode(buffer, &ptr, code);
     assert(ptr == size);
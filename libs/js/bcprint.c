@@ -36,7 +36,7 @@ void nodoka_printBytecode(nodoka_code *codeseg, int indent) {
 #define DECL_OP(op) case NODOKA_BC_##op: printf(#op); break
     if (codeseg->name && codeseg->name->value.len) {
         printf("%*sName: ", indent, "");
-        unicode_putUtf16(codeseg->name->value);
+        nodoka_fputString(stdout, codeseg->name);
         printf("\n");
     }
     if (codeseg->formalParameters.length) {
@@ -45,15 +45,18 @@ void nodoka_printBytecode(nodoka_code *codeseg, int indent) {
             if (i != 0) {
                 printf(", ");
             }
-            unicode_putUtf16(codeseg->formalParameters.array[i]->value);
+            nodoka_fputString(stdout, codeseg->formalParameters.array[i]);
         }
         printf("]\n");
     }
+    if (!codeseg->dynamicScope) {
+        printf("%*sLocals: %d, Slots: %d\n", indent, "", (int)codeseg->localCount, (int)codeseg->slotCount);
+    }
     if (codeseg->strPoolLength) {
         printf("%*sString Pool:\n", indent, "");
         for (int i = 0; i < codeseg->strPoolLength; i++) {
             printf("%*s[%d] = \"", indent + 2, "", i);
-            unicode_putUtf16(codeseg->stringPool[i]->value);
+            nodoka_fputString(stdout, codeseg->stringPool[i]);
             printf("\"\n");
         }
     }
@@ -72,7 +75,7 @@ void nodoka_printBytecode(nodoka_code *codeseg, int indent) {
             case NODOKA_BC_LOAD_STR: {
                 uint16_t index = fetch16(codeseg, &i);
                 printf("LOAD_STR #%d (\"", index);
-                unicode_putUtf16(codeseg->stringPool[index]->value);
+                nodoka_fputString(stdout, codeseg->stringPool[index]);
                 printf("\")");
                 break;
             }
@@ -85,11 +88,6 @@ void nodoka_printBytecode(nodoka_code *codeseg, int indent) {
                 printf("FUNC #%d", index);
                 break;
             }
-            case NODOKA_BC_TRY: {
-                uint16_t index = fetch16(codeseg, &i);
-                printf("TRY #%d", index);
-                break;
-            }
             case NODOKA_BC_CALL: {
                 printf("CALL %d", fetchByte(codeseg, &i));
                 break;
@@ -98,6 +96,31 @@ void nodoka_printBytecode(nodoka_code *codeseg, int indent) {
                 printf("NEW %d", fetchByte(codeseg, &i));
                 break;
             }
+            case NODOKA_BC_CALL_PROP: {
+                printf("CALL_PROP %d", fetchByte(codeseg, &i));
+                break;
+            }
+            case NODOKA_BC_CALL_NAME: {
+                uint16_t index = fetch16(codeseg, &i);
+                printf("CALL_NAME #%d (\"", index);
+                nodoka_fputString(stdout, codeseg->stringPool[index]);
+                printf("\") %d", fetchByte(codeseg, &i));
+                break;
+            }
+            case NODOKA_BC_GET_NAME: {
+                uint16_t index = fetch16(codeseg, &i);
+                printf("GET_NAME #%d (\"", index);
+                nodoka_fputString(stdout, codeseg->stringPool[index]);
+                printf("\")");
+                break;
+            }
+            case NODOKA_BC_PUT_NAME: {
+                uint16_t index = fetch16(codeseg, &i);
+                printf("PUT_NAME #%d (\"", index);
+                nodoka_fputString(stdout, codeseg->stringPool[index]);
+                printf("\")");
+                break;
+            }
             case NODOKA_BC_JT: {
                 printf("JT %d", fetch16(codeseg, &i));
                 break;
@@ -106,15 +129,28 @@ void nodoka_printBytecode(nodoka_code *codeseg, int indent) {
                 printf("JMP %d", fetch16(codeseg, &i));
                 break;
             }
-            case NODOKA_BC_CATCH: {
-                uint16_t index = fetch16(codeseg, &i);
-                printf("CATCH %d", index);
+            case NODOKA_BC_GET_LOCAL: {
+                printf("GET_LOCAL %d", fetch16(codeseg, &i));
+                break;
+            }
+            case NODOKA_BC_SET_LOCAL: {
+                printf("SET_LOCAL %d", fetch16(codeseg, &i));
+                break;
+            }
+            case NODOKA_BC_GET_UPVAL: {
+                uint8_t depth = fetchByte(codeseg, &i);
+                printf("GET_UPVAL %d %d", depth, fetch16(codeseg, &i));
+                break;
+            }
+            case NODOKA_BC_SET_UPVAL: {
+                uint8_t depth = fetchByte(codeseg, &i);
+                printf("SET_UPVAL %d %d", depth, fetch16(codeseg, &i));
                 break;
             }
             case NODOKA_BC_DECL: {
                 uint16_t index = fetch16(codeseg, &i);
                 printf("DECL #%d (\"", index);
-                unicode_putUtf16(codeseg->stringPool[index]->value);
+                nodoka_fputString(stdout, codeseg->stringPool[index]);
                 printf("\")");
                 break;
             }
@@ -126,6 +162,7 @@ void nodoka_printBytecode(nodoka_code *codeseg, int indent) {
             DECL_OP(LOAD_ARR);
             DECL_OP(NOP);
             DECL_OP(DUP);
+            DECL_OP(DUP2);
             DECL_OP(POP);
             DECL_OP(XCHG);
             DECL_OP(RET);
@@ -133,10 +170,13 @@ void nodoka_printBytecode(nodoka_code *codeseg, int indent) {
             DECL_OP(PRIM);
             DECL_OP(NUM);
             DECL_OP(STR);
+            DECL_OP(KEY);
             DECL_OP(REF);
             DECL_OP(ID);
             DECL_OP(GET);
             DECL_OP(PUT);
+            DECL_OP(GET_PROP);
+            DECL_OP(PUT_PROP);
             DECL_OP(DEL);
             DECL_OP(TYPEOF);
             DECL_OP(NEG);
@@ -161,15 +201,22 @@ void nodoka_printBytecode(nodoka_code *codeseg, int indent) {
             DECL_OP(THIS);
 
             DECL_OP(XCHG3);
+            DECL_OP(XCHG4);
 
             DECL_OP(THROW);
-            DECL_OP(NOCATCH);
 
 
             default: assert(0);
         }
         printf("\n");
     }
+    if (codeseg->handlerLength) {
+        printf("%*sHandlers:\n", indent, "");
+        for (size_t i = 0; i < codeseg->handlerLength; i++) {
+            nodoka_handler *h = &codeseg->handlers[i];
+            printf("%*s[%d, %d) -> %d, depth %d\n", indent + 2, "", h->start, h->end, h->handler, h->depth);
+        }
+    }
 
 #undef DECL_OP
 }
@@ -5,25 +5,25 @@
 #include "js/builtin.h"
 #include "js/object.h"
 
-static enum nodoka_completion print_native(nodoka_context *C, nodoka_object *func, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv) {
+static enum nodoka_completion print_native(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
     for (int i = 0; i < argc; i++) {
         nodoka_string *str = nodoka_toString(C, argv[i]);
-        unicode_putUtf16(str->value);
+        nodoka_fputString(stdout, str);
     }
     *ret = nodoka_undefined;
     return NODOKA_COMPLETION_RETURN;
 }
 
-enum nodoka_completion nodoka_colorDir(nodoka_context *C, nodoka_object *func, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv) {
+enum nodoka_completion nodoka_colorDir(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
     for (int i = 0; i < argc; i++) {
-        nodoka_data *data = argv[i];
-        switch (data->type) {
+        nodoka_value data = argv[i];
+        switch (nodoka_typeOf(data)) {
             case NODOKA_UNDEF: printf("\033[2;37mundefined"); break;
             case NODOKA_NULL: printf("\033[1;39mnull"); break;
             case NODOKA_NUMBER:
-            case NODOKA_BOOL: printf("\033[0;33m"); unicode_putUtf16(nodoka_toString(C, data)->value); break;
-            case NODOKA_STRING: printf("\033[0;32m'"); unicode_putUtf16(((nodoka_string *)data)->value); printf("'"); break;
-            case NODOKA_OBJECT: unicode_putUtf16(nodoka_toString(C, data)->value); break;
+            case NODOKA_BOOL: printf("\033[0;33m"); nodoka_fputString(stdout, nodoka_toString(C, data)); break;
+            case NODOKA_STRING: printf("\033[0;32m'"); nodoka_fputString(stdout, nodoka_unbox(data)); printf("'"); break;
+            case NODOKA_OBJECT: nodoka_fputString(stdout, nodoka_toString(C, data)); break;
             default: assert(0);
         }
         printf("\033[0m ");
@@ -48,60 +48,61 @@ static uint32_t get6Bits(uint16_t cha) {
     }
 }
 
-static enum nodoka_completion base64_decodeNative(nodoka_context *C, nodoka_object *func, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv) {
-    if (argc != 1 || argv[0]->type != NODOKA_STRING) {
-        *ret = (nodoka_data *)nodoka_newStringFromUtf8("TypeError: Illegal Signature");
+static enum nodoka_completion base64_decodeNative(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
+    if (argc != 1 || !nodoka_isString(argv[0])) {
+        *ret = nodoka_box(nodoka_newStringFromUtf8("TypeError: Illegal Signature"));
         return NODOKA_COMPLETION_THROW;
     }
-    nodoka_string *str = (nodoka_string *)argv[0];
+    nodoka_string *str = nodoka_flatten(nodoka_unbox(argv[0]));
     if (str->value.len % 4 != 0) {
-        *ret = (nodoka_data *)nodoka_newStringFromUtf8("Error: Invalid Base64 String");
+        *ret = nodoka_box(nodoka_newStringFromUtf8("Error: Invalid Base64 String"));
         return NODOKA_COMPLETION_THROW;
     }
 
     size_t triples = str->value.len / 4;
     size_t decodedLen = triples * 3;
-    if (str->value.str[str->value.len - 1] == '=') {
+    if (nodoka_charAt(str, str->value.len - 1) == '=') {
         decodedLen--;
-        if (str->value.str[str->value.len - 2] == '=') {
+        if (nodoka_charAt(str, str->value.len - 2) == '=') {
             decodedLen--;
         }
     }
     char *decodedStr = malloc(decodedLen + 1);
     for (int i = 0; i < triples - 1; i++) {
-        uint32_t buffer = (get6Bits(str->value.str[4 * i]) << 18) |
-                          (get6Bits(str->value.str[4 * i + 1]) << 12) |
-                          (get6Bits(str->value.str[4 * i + 2]) << 6) |
-                          get6Bits(str->value.str[4 * i + 3]);
+        uint32_t buffer = (get6Bits(nodoka_charAt(str, 4 * i)) << 18) |
+                          (get6Bits(nodoka_charAt(str, 4 * i + 1)) << 12) |
+                          (get6Bits(nodoka_charAt(str, 4 * i + 2)) << 6) |
+                          get6Bits(nodoka_charAt(str, 4 * i + 3));
         decodedStr[3 * i] = (buffer >> 16) & 0xFF;
         decodedStr[3 * i + 1] = (buffer >> 8) & 0xFF;
         decodedStr[3 * i + 2] = buffer & 0xFF;
     }
-    if (str->value.str[str->value.len - 1] == '=') {
-        if (str->value.str[str->value.len - 2] == '=') {
-            uint32_t buffer = (get6Bits(str->value.str[str->value.len - 4]) << 2) |
-                              (get6Bits(str->value.str[str->value.len - 3]) >> 4);
+    if (nodoka_charAt(str, str->value.len - 1) == '=') {
+        if (nodoka_charAt(str, str->value.len - 2) == '=') {
+            uint32_t buffer = (get6Bits(nodoka_charAt(str, str->value.len - 4)) << 2) |
+                              (get6Bits(nodoka_charAt(str, str->value.len - 3)) >> 4);
             decodedStr[decodedLen - 1] = buffer & 0xFF;
         } else {
-            uint32_t buffer = (get6Bits(str->value.str[str->value.len - 4]) << 10) |
-                              (get6Bits(str->value.str[str->value.len - 3]) << 4) |
-                              (get6Bits(str->value.str[str->value.len - 2]) >> 2);
+            uint32_t buffer = (get6Bits(nodoka_charAt(str, str->value.len - 4)) << 10) |
+                              (get6Bits(nodoka_charAt(str, str->value.len - 3)) << 4) |
+                              (get6Bits(nodoka_charAt(str, str->value.len - 2)) >> 2);
             decodedStr[decodedLen - 1] = (buffer >> 8) & 0xFF;
             decodedStr[decodedLen - 2] = buffer & 0xFF;
         }
     }
     decodedStr[decodedLen] = 0;
 
-    *ret = (nodoka_data *)nodoka_newStringFromUtf8(decodedStr);
+    *ret = nodoka_box(nodoka_newStringFromUtf8(decodedStr));
     return NODOKA_COMPLETION_RETURN;
 }
 
-enum nodoka_completion memoryAddress(nodoka_context *C, nodoka_object *func, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv) {
+enum nodoka_completion memoryAddress(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
     if (argc == 0) {
-        *ret = (nodoka_data *)nodoka_newStringFromUtf8("TypeError: Expected argument for __nodoka__.memoryAddress");
+        *ret = nodoka_box(nodoka_newStringFromUtf8("TypeError: Expected argument for __nodoka__.memoryAddress"));
         return NODOKA_COMPLETION_THROW;
     }
-    *ret = (nodoka_data *)nodoka_newNumber((size_t)argv[0]);
+    /* Immediate values do not live in memory */
+    *ret = nodoka_fromNumber(nodoka_isPointer(argv[0]) ? (size_t)nodoka_unbox(argv[0]) : 0);
     return NODOKA_COMPLETION_RETURN;
 }
 
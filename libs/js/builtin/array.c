@@ -7,34 +7,33 @@ nodoka_object *nodoka_newArray(nodoka_global *global, uint32_t length) {
     nodoka_object *obj = nodoka_newNativeObject();
     obj->_class = nodoka_newStringFromUtf8("Array");
     obj->prototype = global->Array_prototype;
-
-    nodoka_global_defineValue(obj, "length", (nodoka_data *)nodoka_newNumber(length), true, false, false);
+    /* Int32 elements cannot have holes */
+    obj->elementsKind = length ? NODOKA_ELEMENTS_HOLEY : NODOKA_ELEMENTS_PACKED;
+    obj->elementsType = length ? NODOKA_ELEMENTS_DOUBLE : NODOKA_ELEMENTS_INT32;
+    obj->length = length;
     return obj;
 }
 
-static enum nodoka_completion Array_construct(nodoka_context *C, nodoka_object *func, nodoka_data **ret, int argc, nodoka_data **argv) {
-    if (argc == 1 && argv[0]->type == NODOKA_NUMBER) {
-        nodoka_number *num = (nodoka_number *)argv[0];
+static enum nodoka_completion Array_construct(nodoka_context *C, nodoka_object *func, nodoka_value *ret, int argc, nodoka_value *argv) {
+    if (argc == 1 && nodoka_isNumber(argv[0])) {
+        double num = nodoka_getNumber(argv[0]);
         uint32_t len = nodoka_toUint32(num);
-        if (len != num->value) {
-            *ret = (nodoka_data *)nodoka_newStringFromUtf8("RangeError: Invalid array length");
+        if (len != num) {
+            *ret = nodoka_box(nodoka_newStringFromUtf8("RangeError: Invalid array length"));
             return NODOKA_COMPLETION_THROW;
         }
-        *ret = (nodoka_data *)nodoka_newArray(C->global, len);
+        *ret = nodoka_box(nodoka_newArray(C->global, len));
         return NODOKA_COMPLETION_RETURN;
     }
-    nodoka_object *array = nodoka_newArray(C->global, argc);
+    nodoka_object *array = nodoka_newArray(C->global, 0);
     for (int i = 0; i < argc; i++) {
-        nodoka_defineOwnProperty(array,
-                                 nodoka_newStringFromDouble(i),
-                                 nodoka_createDataDesc(argv[i], true, true, true),
-                                 true);
+        nodoka_putElement(array, i, argv[i]);
     }
-    *ret = (nodoka_data *)array;
+    *ret = nodoka_box(array);
     return NODOKA_COMPLETION_RETURN;
 }
 
-static enum nodoka_completion Array_native(nodoka_context *C, nodoka_object *func, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv) {
+static enum nodoka_completion Array_native(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
     return Array_construct(C, func, ret, argc, argv);
 }
 
@@ -47,5 +46,5 @@ void nodoka_newGlobal_Array(nodoka_global *global) {
     Array->construct = Array_construct;
     global->Array = Array;
 
-    nodoka_global_defineValue(Array, "prototype", (nodoka_data *)prototype, false, false, false);
+    nodoka_global_defineValue(Array, "prototype", nodoka_box(prototype), false, false, false);
 }
\ No newline at end of file
@@ -3,12 +3,12 @@
 #include "js/builtin.h"
 #include "js/object.h"
 
-static enum nodoka_completion newFunction_native(nodoka_context *C, nodoka_object *O, nodoka_data **ret, int argc, nodoka_data **argv) {
-    *ret = (nodoka_data *)nodoka_newStringFromUtf8("UnsupportedError: Cannot create new function");
+static enum nodoka_completion newFunction_native(nodoka_context *C, nodoka_object *O, nodoka_value *ret, int argc, nodoka_value *argv) {
+    *ret = nodoka_box(nodoka_newStringFromUtf8("UnsupportedError: Cannot create new function"));
     return NODOKA_COMPLETION_THROW;
 }
 
-static enum nodoka_completion function_native(nodoka_context *C, nodoka_object *func, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv) {
+static enum nodoka_completion function_native(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
     return newFunction_native(C, func, ret, argc, argv);
 }
 
@@ -19,32 +19,32 @@ nodoka_object *nodoka_newNativeFunction(nodoka_global *global, nodoka_call_func
     //TODO function->get
     function->call = func;
 
-    nodoka_global_defineValue(function, "length", (nodoka_data *)nodoka_newNumber(argc), false, false, false);
+    nodoka_global_defineValue(function, "length", nodoka_fromNumber(argc), false, false, false);
     return function;
 }
 
-static enum nodoka_completion prototype_native(nodoka_context *C, nodoka_object *func, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv) {
+static enum nodoka_completion prototype_native(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
     *ret = nodoka_undefined;
     return NODOKA_COMPLETION_RETURN;
 }
 
-static enum nodoka_completion prototype_toString(nodoka_context *C, nodoka_object *func, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv) {
-    if (this->type == NODOKA_OBJECT) {
-        nodoka_object *obj = (nodoka_object *)this;
+static enum nodoka_completion prototype_toString(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
+    if (nodoka_isObject(this)) {
+        nodoka_object *obj = nodoka_unbox(this);
         if (obj->call) {
             if (obj->codeString) {
-                *ret = (nodoka_data *)obj->codeString;
+                *ret = nodoka_box(obj->codeString);
             } else {
                 if (obj->code) {
-                    *ret = (nodoka_data *)nodoka_newStringFromUtf8("function () { [bytecode] }");
+                    *ret = nodoka_box(nodoka_newStringFromUtf8("function () { [bytecode] }"));
                 } else {
-                    *ret = (nodoka_data *)nodoka_newStringFromUtf8("function () { [native code] }");
+                    *ret = nodoka_box(nodoka_newStringFromUtf8("function () { [native code] }"));
                 }
             }
             return NODOKA_COMPLETION_RETURN;
         }
     }
-    *ret = (nodoka_data *)nodoka_newStringFromUtf8("TypeError: Function.prototype.toString is not generic");
+    *ret = nodoka_box(nodoka_newStringFromUtf8("TypeError: Function.prototype.toString is not generic"));
     return NODOKA_COMPLETION_THROW;
 }
 
@@ -58,8 +58,8 @@ void nodoka_newGlobal_Function(nodoka_global *global) {
     function->construct = newFunction_native;
     global->function = function;
 
-    nodoka_global_defineValue(function, "prototype", (nodoka_data *)prototype, false, false, false);
+    nodoka_global_defineValue(function, "prototype", nodoka_box(prototype), false, false, false);
 
-    nodoka_global_defineValue(prototype, "constructor", (nodoka_data *)function, true, false, true);
+    nodoka_global_defineValue(prototype, "constructor", nodoka_box(function), true, false, true);
     nodoka_global_defineFunc(global, prototype, "toString", prototype_toString, 0, true, false, true);
 }
\ No newline at end of file
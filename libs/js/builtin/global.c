@@ -1,11 +1,12 @@
 #include "c/math.h"
 #include "c/stdlib.h"
+#include "c/string.h"
 
 #include "js/builtin.h"
 #include "js/object.h"
 #include "js/pass.h"
 
-nodoka_prop_desc *nodoka_createDataDesc(nodoka_data *val, bool writable, bool enumerable, bool configurable) {
+nodoka_prop_desc *nodoka_createDataDesc(nodoka_value val, bool writable, bool enumerable, bool configurable) {
     nodoka_prop_desc *desc = nodoka_newPropertyDesc();
     desc->value = val;
     desc->writable = writable ? nodoka_true : nodoka_false;
@@ -14,7 +15,7 @@ nodoka_prop_desc *nodoka_createDataDesc(nodoka_data *val, bool writable, bool en
     return desc;
 }
 
-void nodoka_global_defineValue(nodoka_object *object, char *name, nodoka_data *data, bool w, bool e, bool c) {
+void nodoka_global_defineValue(nodoka_object *object, char *name, nodoka_value data, bool w, bool e, bool c) {
     nodoka_defineOwnProperty(object,
                              nodoka_newStringFromUtf8(name),
                              nodoka_createDataDesc(data, w, e, c),
@@ -22,51 +23,59 @@ void nodoka_global_defineValue(nodoka_object *object, char *name, nodoka_data *d
 }
 
 void nodoka_global_defineFunc(nodoka_global *G, nodoka_object *object, char *name, nodoka_call_func func, uint32_t argc, bool w, bool e, bool c) {
-    nodoka_global_defineValue(object, name, (nodoka_data *)nodoka_newNativeFunction(G, func, argc), w, e, c);
+    nodoka_global_defineValue(object, name, nodoka_box(nodoka_newNativeFunction(G, func, argc)), w, e, c);
 }
 
-static enum nodoka_completion isNaN_native(nodoka_context *C, nodoka_object *func, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv) {
+static enum nodoka_completion isNaN_native(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
     if (argc == 0) {
         *ret = nodoka_true;
     } else {
-        *ret = isnan(nodoka_toNumber(argv[0])->value) ? nodoka_true : nodoka_false;
+        *ret = isnan(nodoka_toNumber(argv[0])) ? nodoka_true : nodoka_false;
     }
     return NODOKA_COMPLETION_RETURN;
 }
 
-static enum nodoka_completion isFinite_native(nodoka_context *C, nodoka_object *func, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv) {
+static enum nodoka_completion isFinite_native(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
     if (argc == 0) {
         *ret = nodoka_false;
     } else {
-        double val = nodoka_toNumber(argv[0])->value;
+        double val = nodoka_toNumber(argv[0]);
         *ret = isfinite(val) ? nodoka_true : nodoka_false;
     }
     return NODOKA_COMPLETION_RETURN;
 }
 
-static enum nodoka_completion eval(nodoka_context *C, nodoka_object *func, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv) {
+static enum nodoka_completion eval(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
     if (argc == 0) {
         *ret = nodoka_undefined;
         return NODOKA_COMPLETION_RETURN;
-    } else if (argv[0]->type != NODOKA_STRING) {
+    } else if (!nodoka_isString(argv[0])) {
         *ret = argv[0];
         return NODOKA_COMPLETION_RETURN;
     }
-    nodoka_string *evalBody = (nodoka_string *)argv[0];
-    nodoka_code *code = nodoka_compile(evalBody->value);
+    utf16_string_t evalBody = nodoka_toUtf16(nodoka_unbox(argv[0]));
+    nodoka_code *code = nodoka_compile(evalBody);
+    free(evalBody.str);
 
     if (false) {
         assert(!"Direct Call");
     } else {
-        nodoka_context *context = nodoka_newContext(C->global, C->env, code, C->this);
+        /* Slot records cannot take new bindings, so use the nearest one backed by an object */
+        nodoka_envRec *env = C->env;
+        while (!env->object) {
+            env = env->outer;
+        }
+        nodoka_context *context = nodoka_newContext(C->global, env, code, C->this);
         enum nodoka_completion comp = nodoka_exec(context, ret);
         nodoka_disposeContext(context);
-        nodoka_disposeCode(code);
         return comp;
     }
 }
 
 void nodoka_newGlobal(nodoka_global *scope) {
+    /* Builtins are looked up through the prototypes set so far while being created */
+    memset(scope, 0, sizeof(nodoka_global));
+    scope->stack = nodoka_newStack();
 
     nodoka_newGlobal_Function(scope);
     nodoka_newGlobal_Object(scope);
@@ -76,22 +85,25 @@ void nodoka_newGlobal(nodoka_global *scope) {
     nodoka_newGlobal_String(scope);
     nodoka_newGlobal_Error(scope);
     nodoka_newGlobal_ReferenceError(scope);
+    nodoka_newGlobal_TypeError(scope);
+    nodoka_newGlobal_RangeError(scope);
 
     nodoka_object *global = nodoka_newObject(scope);
     scope->global = global;
 
-    nodoka_global_defineValue(global, "Function", (nodoka_data *)scope->function, true, false, true);
-    nodoka_global_defineValue(global, "Object", (nodoka_data *)scope->object, true, false, true);
-    nodoka_global_defineValue(global, "Array", (nodoka_data *)scope->Array, true, false, true);
-    nodoka_global_defineValue(global, "String", (nodoka_data *)scope->String, true, false, true);
-    nodoka_global_defineValue(global, "Error", (nodoka_data *)scope->Error, true, false, true);
-    nodoka_global_defineValue(global, "ReferenceError", (nodoka_data *)scope->ReferenceError, true, false, true);
-    nodoka_global_defineValue(global, "TypeError", (nodoka_data *)scope->TypeError, true, false, true);
-    nodoka_global_defineValue(global, "NaN", (nodoka_data *)nodoka_nan, false, false, false);
-    nodoka_global_defineValue(global, "Infinity", (nodoka_data *)nodoka_newNumber(1.0 / 0.0), false, false, false);
+    nodoka_global_defineValue(global, "Function", nodoka_box(scope->function), true, false, true);
+    nodoka_global_defineValue(global, "Object", nodoka_box(scope->object), true, false, true);
+    nodoka_global_defineValue(global, "Array", nodoka_box(scope->Array), true, false, true);
+    nodoka_global_defineValue(global, "String", nodoka_box(scope->String), true, false, true);
+    nodoka_global_defineValue(global, "Error", nodoka_box(scope->Error), true, false, true);
+    nodoka_global_defineValue(global, "ReferenceError", nodoka_box(scope->ReferenceError), true, false, true);
+    nodoka_global_defineValue(global, "TypeError", nodoka_box(scope->TypeError), true, false, true);
+    nodoka_global_defineValue(global, "RangeError", nodoka_box(scope->RangeError), true, false, true);
+    nodoka_global_defineValue(global, "NaN", nodoka_nan, false, false, false);
+    nodoka_global_defineValue(global, "Infinity", nodoka_fromNumber(1.0 / 0.0), false, false, false);
     nodoka_global_defineValue(global, "undefined", nodoka_undefined, false, false, false);
     nodoka_global_defineFunc(scope, global, "eval", eval, 1, true, false, true);
     nodoka_global_defineFunc(scope, global, "isNaN", isNaN_native, 1, true, false, true);
     nodoka_global_defineFunc(scope, global, "isFinite", isFinite_native, 1, true, false, true);
-    nodoka_global_defineValue(global, "__nodoka__", (nodoka_data *)nodoka_newGlobal_nodoka(scope), false, false, false);
+    nodoka_global_defineValue(global, "__nodoka__", nodoka_box(nodoka_newGlobal_nodoka(scope)), false, false, false);
 }
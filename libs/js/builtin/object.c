@@ -10,14 +10,14 @@ nodoka_object *nodoka_newObject(nodoka_global *global) {
     return obj;
 }
 
-static enum nodoka_completion newObject_native(nodoka_context *C, nodoka_object *O, nodoka_data **ret, int argc, nodoka_data **argv) {
-    nodoka_data *value;
+static enum nodoka_completion newObject_native(nodoka_context *C, nodoka_object *O, nodoka_value *ret, int argc, nodoka_value *argv) {
+    nodoka_value value;
     if (argc != 0) {
         value = argv[0];
     } else {
         value = nodoka_undefined;
     }
-    switch (value->type) {
+    switch (nodoka_typeOf(value)) {
         case NODOKA_OBJECT: {
             *ret = value;
             return NODOKA_COMPLETION_RETURN;
@@ -25,81 +25,81 @@ static enum nodoka_completion newObject_native(nodoka_context *C, nodoka_object
         case NODOKA_STRING:
         case NODOKA_BOOL:
         case NODOKA_NUMBER:
-            *ret = (nodoka_data *)nodoka_toObject(C, value);
+            *ret = nodoka_box(nodoka_toObject(C, value));
             return NODOKA_COMPLETION_RETURN;
         default: break;
     }
     assertType(value, NODOKA_NULL | NODOKA_UNDEF);
     nodoka_object *obj = nodoka_newObject(C->global);
     // Internal Methods should be done in nodoka_newObject
-    *ret = (nodoka_data *)obj;
+    *ret = nodoka_box(obj);
     return NODOKA_COMPLETION_RETURN;
 }
 
-static enum nodoka_completion Object_native(nodoka_context *C, nodoka_object *func, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv) {
-    nodoka_data *value = nodoka_undefined;
+static enum nodoka_completion Object_native(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
+    nodoka_value value = nodoka_undefined;
     if (argc != 0) {
         value = argv[0];
     }
     if (value == nodoka_undefined || value == nodoka_null) {
         return newObject_native(C, func, ret, argc, argv);
     } else {
-        *ret = (nodoka_data *)nodoka_toObject(C, value);
+        *ret = nodoka_box(nodoka_toObject(C, value));
         return NODOKA_COMPLETION_RETURN;
     }
 }
 
-static enum nodoka_completion getPrototypeOf_native(nodoka_context *C, nodoka_object *func, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv) {
-    if (argc == 0 || argv[0]->type != NODOKA_OBJECT) {
-        *ret = (nodoka_data *)nodoka_newStringFromUtf8("TypeError: Object.getPrototypeOf called on non-object");
+static enum nodoka_completion getPrototypeOf_native(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
+    if (argc == 0 || !nodoka_isObject(argv[0])) {
+        *ret = nodoka_box(nodoka_newStringFromUtf8("TypeError: Object.getPrototypeOf called on non-object"));
         return NODOKA_COMPLETION_THROW;
     }
-    nodoka_object *obj = (nodoka_object *)argv[0];
+    nodoka_object *obj = nodoka_unbox(argv[0]);
     if (obj->prototype) {
-        *ret = (nodoka_data *)obj->prototype;
+        *ret = nodoka_box(obj->prototype);
     } else {
         *ret = nodoka_null;
     }
     return NODOKA_COMPLETION_RETURN;
 }
 
-static enum nodoka_completion preventExtensions_native(nodoka_context *C, nodoka_object *func, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv) {
-    if (argc == 0 || argv[0]->type != NODOKA_OBJECT) {
-        *ret = (nodoka_data *)nodoka_newStringFromUtf8("TypeError: Object.preventExtensions called on non-object");
+static enum nodoka_completion preventExtensions_native(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
+    if (argc == 0 || !nodoka_isObject(argv[0])) {
+        *ret = nodoka_box(nodoka_newStringFromUtf8("TypeError: Object.preventExtensions called on non-object"));
         return NODOKA_COMPLETION_THROW;
     }
-    nodoka_object *obj = (nodoka_object *)argv[0];
+    nodoka_object *obj = nodoka_unbox(argv[0]);
     obj->extensible = false;
-    *ret = (nodoka_data *)obj;
+    *ret = nodoka_box(obj);
     return NODOKA_COMPLETION_RETURN;
 }
 
-static enum nodoka_completion isExtensible_native(nodoka_context *C, nodoka_object *func, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv) {
-    if (argc == 0 || argv[0]->type != NODOKA_OBJECT) {
-        *ret = (nodoka_data *)nodoka_newStringFromUtf8("TypeError: Object.isExtensible called on non-object");
+static enum nodoka_completion isExtensible_native(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
+    if (argc == 0 || !nodoka_isObject(argv[0])) {
+        *ret = nodoka_box(nodoka_newStringFromUtf8("TypeError: Object.isExtensible called on non-object"));
         return NODOKA_COMPLETION_THROW;
     }
-    nodoka_object *obj = (nodoka_object *)argv[0];
+    nodoka_object *obj = nodoka_unbox(argv[0]);
     *ret = obj->extensible ? nodoka_true : nodoka_false;
     return NODOKA_COMPLETION_RETURN;
 }
 
-static enum nodoka_completion prototype_toString(nodoka_context *C, nodoka_object *func, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv) {
-    if (this->type == NODOKA_UNDEF) {
-        *ret = (nodoka_data *)nodoka_newStringFromUtf8("[object Undefined]");
-    } else if (this->type == NODOKA_NULL) {
-        *ret = (nodoka_data *)nodoka_newStringFromUtf8("[object Null]");
+static enum nodoka_completion prototype_toString(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
+    if (this == nodoka_undefined) {
+        *ret = nodoka_box(nodoka_newStringFromUtf8("[object Undefined]"));
+    } else if (this == nodoka_null) {
+        *ret = nodoka_box(nodoka_newStringFromUtf8("[object Null]"));
     } else {
         nodoka_object *obj = nodoka_toObject(C, this);
         nodoka_string *str = nodoka_newStringFromUtf8("[object ");
         str = nodoka_concatString(3, nodoka_newStringFromUtf8("[object "), obj->_class, nodoka_newStringFromUtf8("]"));
-        *ret = (nodoka_data *)str;
+        *ret = nodoka_box(str);
     }
     return NODOKA_COMPLETION_RETURN;
 }
 
-static enum nodoka_completion prototype_valueOf(nodoka_context *C, nodoka_object *func, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv) {
-    *ret = (nodoka_data *)nodoka_toObject(C, this);
+static enum nodoka_completion prototype_valueOf(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
+    *ret = nodoka_box(nodoka_toObject(C, this));
     return NODOKA_COMPLETION_RETURN;
 }
 
@@ -112,13 +112,13 @@ void nodoka_newGlobal_Object(nodoka_global *global) {
     global->Object_prototype = prototype;
     object->construct = newObject_native;
 
-    nodoka_global_defineValue(object, "prototype", (nodoka_data *)global->Object_prototype, true, false, true);
+    nodoka_global_defineValue(object, "prototype", nodoka_box(global->Object_prototype), true, false, true);
 
     nodoka_global_defineFunc(global, object, "getPrototypeOf", getPrototypeOf_native, 1, true, false, true);
     nodoka_global_defineFunc(global, object, "preventExtensions", preventExtensions_native, 1, true, false, true);
     nodoka_global_defineFunc(global, object, "isExtensible", isExtensible_native, 1, true, false, true);
 
-    nodoka_global_defineValue(prototype, "constructor", (nodoka_data *)object, true, false, true);
+    nodoka_global_defineValue(prototype, "constructor", nodoka_box(object), true, false, true);
     nodoka_global_defineFunc(global, prototype, "toString", prototype_toString, 0, true, false, true);
     nodoka_global_defineFunc(global, prototype, "valueOf", prototype_valueOf, 0, true, false, true);
 }
\ No newline at end of file
@@ -4,25 +4,20 @@
 #include "js/builtin.h"
 #include "js/object.h"
 
-static nodoka_prop_desc *String_getOwnProperty(nodoka_object *O, nodoka_string *P) {
-    nodoka_prop_desc *desc = hashmap_get(O->prop, P);
-    if (desc) {
-        return desc;
+static bool String_getOwnProperty(nodoka_object *O, nodoka_string *P, nodoka_property *prop) {
+    nodoka_property *own = nodoka_findOwnProperty(O, P);
+    if (own) {
+        *prop = *own;
+        return true;
     }
-    int32_t index = nodoka_toInt32(nodoka_toNumber((nodoka_data *)P));
-    if (nodoka_toString(NULL, (nodoka_data *)nodoka_newNumber(fabs(index))) != P) {
-        return NULL;
+    uint32_t index;
+    nodoka_string *str = nodoka_unbox(O->primitiveValue);
+    if (!nodoka_isArrayIndex(P, &index) || str->value.len <= index) {
+        return false;
     }
-    nodoka_string *str = (nodoka_string *)O->primitiveValue;
-    if (str->value.len <= index) {
-        return NULL;
-    }
-    utf16_string_t resultStr = {
-        .len = 1,
-        .str = malloc(sizeof(uint16_t))
-    };
-    resultStr.str[0] = str->value.str[index];
-    return nodoka_createDataDesc((nodoka_data *)nodoka_new_string(resultStr), true, false, false);
+    prop->value = nodoka_box(nodoka_newCharString(nodoka_charAt(nodoka_flatten(str), index)));
+    prop->attributes = NODOKA_ENUMERABLE;
+    return true;
 }
 
 nodoka_object *nodoka_newStringObject(nodoka_global *global, nodoka_string *str) {
@@ -30,31 +25,35 @@ nodoka_object *nodoka_newStringObject(nodoka_global *global, nodoka_string *str)
     obj->getOwnProperty = String_getOwnProperty;
     obj->_class = nodoka_newStringFromUtf8("String");
     obj->prototype = global->String_prototype;
-    obj->primitiveValue = str ? (nodoka_data *)str : (nodoka_data *)nodoka_newStringFromUtf8("");
+    obj->primitiveValue = str ? nodoka_box(str) : nodoka_box(nodoka_newStringFromUtf8(""));
 
-    nodoka_global_defineValue(obj, "length", (nodoka_data *)nodoka_newNumber(str ? str->value.len : 0), false, false, false);
+    nodoka_global_defineValue(obj, "length", nodoka_fromNumber(str ? str->value.len : 0), false, false, false);
     return obj;
 }
 
-static enum nodoka_completion String_construct(nodoka_context *C, nodoka_object *func, nodoka_data **ret, int argc, nodoka_data **argv) {
+static enum nodoka_completion String_construct(nodoka_context *C, nodoka_object *func, nodoka_value *ret, int argc, nodoka_value *argv) {
     if (argc == 0) {
-        *ret = (nodoka_data *)nodoka_newStringObject(C->global, NULL);
+        *ret = nodoka_box(nodoka_newStringObject(C->global, NULL));
     } else {
-        *ret = (nodoka_data *)nodoka_newStringObject(C->global, nodoka_toString(C, argv[0]));
+        *ret = nodoka_box(nodoka_newStringObject(C->global, nodoka_toString(C, argv[0])));
     }
     return NODOKA_COMPLETION_RETURN;
 }
 
-static enum nodoka_completion String_native(nodoka_context *C, nodoka_object *func, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv) {
+static enum nodoka_completion String_native(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
     if (argc == 0) {
-        *ret = (nodoka_data *)nodoka_newStringFromUtf8("");
+        *ret = nodoka_box(nodoka_newStringFromUtf8(""));
     } else {
-        *ret = (nodoka_data *)nodoka_toString(C, argv[0]);
+        *ret = nodoka_box(nodoka_toString(C, argv[0]));
     }
     return NODOKA_COMPLETION_RETURN;
 }
 
-static enum nodoka_completion String_fromCharCode(nodoka_context *C, nodoka_object *func, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv) {
+static enum nodoka_completion String_fromCharCode(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
+    if (argc == 1) {
+        *ret = nodoka_box(nodoka_newCharString(nodoka_toUint16(nodoka_toNumber(argv[0]))));
+        return NODOKA_COMPLETION_RETURN;
+    }
     utf16_string_t str = {
         .len = argc,
         .str = malloc(sizeof(uint16_t) * argc)
@@ -62,7 +61,67 @@ static enum nodoka_completion String_fromCharCode(nodoka_context *C, nodoka_obje
     for (int i = 0; i < argc; i++) {
         str.str[i] = nodoka_toUint16(nodoka_toNumber(argv[i]));
     }
-    *ret = (nodoka_data *)nodoka_new_string(str);
+    *ret = nodoka_box(nodoka_new_string(str));
+    return NODOKA_COMPLETION_RETURN;
+}
+
+/* String value of this, for methods of String.prototype (ES5 15.5.4) */
+static nodoka_string *thisString(nodoka_context *C, nodoka_value this) {
+    if (this == nodoka_undefined || this == nodoka_null) {
+        assert(!"TypeError");
+    }
+    return nodoka_flatten(nodoka_toString(C, this));
+}
+
+/* ES5 9.4 */
+static double toInteger(nodoka_value value) {
+    double num = nodoka_toNumber(value);
+    return isnan(num) ? 0 : trunc(num);
+}
+
+/* Position clamped to [0, len] */
+static size_t toIndex(nodoka_value value, size_t len) {
+    double num = toInteger(value);
+    if (num <= 0) {
+        return 0;
+    }
+    return num >= len ? len : (size_t)num;
+}
+
+static enum nodoka_completion prototype_charAt(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
+    nodoka_string *str = thisString(C, this);
+    double pos = argc ? toInteger(argv[0]) : 0;
+    if (pos < 0 || pos >= str->value.len) {
+        *ret = nodoka_box(nodoka_newStringFromUtf8(""));
+    } else {
+        *ret = nodoka_box(nodoka_newCharString(nodoka_charAt(str, pos)));
+    }
+    return NODOKA_COMPLETION_RETURN;
+}
+
+static enum nodoka_completion prototype_charCodeAt(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
+    nodoka_string *str = thisString(C, this);
+    double pos = argc ? toInteger(argv[0]) : 0;
+    if (pos < 0 || pos >= str->value.len) {
+        *ret = nodoka_fromNumber(NAN);
+    } else {
+        *ret = nodoka_fromNumber(nodoka_charAt(str, pos));
+    }
+    return NODOKA_COMPLETION_RETURN;
+}
+
+/* ES5 15.5.4.15, which shares the contents of the string rather than copying them */
+static enum nodoka_completion prototype_substring(nodoka_context *C, nodoka_object *func, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
+    nodoka_string *str = thisString(C, this);
+    size_t len = str->value.len;
+    size_t start = argc > 0 ? toIndex(argv[0], len) : 0;
+    size_t end = argc > 1 && argv[1] != nodoka_undefined ? toIndex(argv[1], len) : len;
+    if (start > end) {
+        size_t temp = start;
+        start = end;
+        end = temp;
+    }
+    *ret = nodoka_box(nodoka_newSubstring(str, start, end - start));
     return NODOKA_COMPLETION_RETURN;
 }
 
@@ -76,6 +135,10 @@ void nodoka_newGlobal_String(nodoka_global *global) {
     String->construct = String_construct;
     global->String = String;
 
-    nodoka_global_defineValue(String, "prototype", (nodoka_data *)prototype, false, false, false);
+    nodoka_global_defineValue(String, "prototype", nodoka_box(prototype), false, false, false);
     nodoka_global_defineFunc(global, String, "fromCharCode", String_fromCharCode, 1, false, false, false);
+
+    nodoka_global_defineFunc(global, prototype, "charAt", prototype_charAt, 1, true, false, true);
+    nodoka_global_defineFunc(global, prototype, "charCodeAt", prototype_charCodeAt, 1, true, false, true);
+    nodoka_global_defineFunc(global, prototype, "substring", prototype_substring, 2, true, false, true);
 }
\ No newline at end of file
@@ -1,3 +1,5 @@
+#include "c/assert.h"
+
 #include "unicode/convert.h"
 
 #include "js/js.h"
@@ -22,5 +24,8 @@ nodoka_code *nodoka_compile(utf16_string_t str) {
 
     nodoka_optimizer(emitter);
     nodoka_code *code = nodoka_packCode(emitter);
+    if (!nodoka_verifyCode(code)) {
+        assert(0);
+    }
     return code;
 }
\ No newline at end of file
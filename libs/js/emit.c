@@ -2,6 +2,7 @@
 #include "c/stdarg.h"
 
 #include "util/double.h"
+#include "data-struct/slab.h"
 
 #include "js/js.h"
 #include "js/bytecode.h"
@@ -10,13 +11,15 @@ enum {
     DEF_BC_CAPACITY = 256,
     DEF_STR_POOL_CAPACITY = 16,
     DEF_CODE_POOL_CAPACITY = 8,
+    DEF_HANDLER_CAPACITY = 4,
     BC_CAPACITY_INC_STEP = 128,
     STR_POOL_CAPACITY_INC_STEP = 16,
     CODE_POOL_CAPACITY_INC_STEP = 2,
+    HANDLER_CAPACITY_INC_STEP = 4,
 };
 
 nodoka_code_emitter *nodoka_newCodeEmitter(void) {
-    nodoka_code_emitter *seg = malloc(sizeof(nodoka_code_emitter));
+    nodoka_code_emitter *seg = slab_alloc(sizeof(nodoka_code_emitter));
     seg->stringPool = malloc(DEF_STR_POOL_CAPACITY * sizeof(nodoka_string *));
     seg->codePool = malloc(DEF_CODE_POOL_CAPACITY * sizeof(nodoka_code *));
     seg->bytecode = malloc(DEF_BC_CAPACITY);
@@ -26,6 +29,12 @@ nodoka_code_emitter *nodoka_newCodeEmitter(void) {
     seg->strPoolCapacity = DEF_STR_POOL_CAPACITY;
     seg->codePoolCapacity = DEF_CODE_POOL_CAPACITY;
     seg->bytecodeCapacity = DEF_BC_CAPACITY;
+    seg->handlers = malloc(DEF_HANDLER_CAPACITY * sizeof(nodoka_handler));
+    seg->handlerLength = 0;
+    seg->handlerCapacity = DEF_HANDLER_CAPACITY;
+    seg->scope = NULL;
+    seg->depth = 1;
+    seg->finally = NULL;
     return seg;
 }
 
@@ -90,7 +99,9 @@ void nodoka_emitBytecode(nodoka_code_emitter *emitter, uint8_t bc, ...) {
     va_start(ap, bc);
     switch (bc) {
         case NODOKA_BC_LOAD_STR:
-        case NODOKA_BC_DECL: {
+        case NODOKA_BC_DECL:
+        case NODOKA_BC_GET_NAME:
+        case NODOKA_BC_PUT_NAME: {
             nodoka_string *str = va_arg(ap, nodoka_string *);
             uint16_t imm16 = nodoka_emitString(emitter, str);
             nodoka_emit16(emitter, imm16);
@@ -102,22 +113,42 @@ void nodoka_emitBytecode(nodoka_code_emitter *emitter, uint8_t bc, ...) {
             nodoka_emit64(emitter, imm64);
             break;
         }
-        case NODOKA_BC_FUNC:
-        case NODOKA_BC_TRY: {
+        case NODOKA_BC_FUNC: {
             nodoka_code *str = va_arg(ap, nodoka_code *);
             uint16_t imm16 = nodoka_emitCode(emitter, str);
             nodoka_emit16(emitter, imm16);
             break;
         }
         case NODOKA_BC_CALL:
+        case NODOKA_BC_CALL_PROP:
         case NODOKA_BC_NEW: {
             size_t count = va_arg(ap, size_t);
             nodoka_emit8(emitter, count);
             break;
         }
+        case NODOKA_BC_CALL_NAME: {
+            nodoka_string *str = va_arg(ap, nodoka_string *);
+            size_t count = va_arg(ap, size_t);
+            nodoka_emit16(emitter, nodoka_emitString(emitter, str));
+            nodoka_emit8(emitter, count);
+            break;
+        }
+        case NODOKA_BC_GET_LOCAL:
+        case NODOKA_BC_SET_LOCAL: {
+            uint16_t index = va_arg(ap, int);
+            nodoka_emit16(emitter, index);
+            break;
+        }
+        case NODOKA_BC_GET_UPVAL:
+        case NODOKA_BC_SET_UPVAL: {
+            uint8_t depth = va_arg(ap, int);
+            uint16_t index = va_arg(ap, int);
+            nodoka_emit8(emitter, depth);
+            nodoka_emit16(emitter, index);
+            break;
+        }
         case NODOKA_BC_JMP:
-        case NODOKA_BC_JT:
-        case NODOKA_BC_CATCH: {
+        case NODOKA_BC_JT: {
             nodoka_relocatable *rel = va_arg(ap, nodoka_relocatable *);
             if (rel)
                 *rel = emitter->bytecodeLength;
@@ -137,26 +168,44 @@ void nodoka_relocate(nodoka_code_emitter *emitter, nodoka_relocatable rel, nodok
     emitter->bytecode[rel + 1] = label & 0xFF;
 }
 
+/* Protect [start, end) with the handler, see nodoka_handler */
+void nodoka_emitHandler(nodoka_code_emitter *emitter, nodoka_label start, nodoka_label end, nodoka_label handler, size_t depth) {
+    if (emitter->handlerLength == emitter->handlerCapacity) {
+        emitter->handlerCapacity += HANDLER_CAPACITY_INC_STEP;
+        emitter->handlers = realloc(emitter->handlers, emitter->handlerCapacity * sizeof(nodoka_handler));
+    }
+    emitter->handlers[emitter->handlerLength++] = (nodoka_handler) {
+        .start = start,
+         .end = end,
+          .handler = handler,
+           .depth = depth
+    };
+}
+
 void nodoka_stripEmitter(nodoka_code_emitter *emitter) {
     emitter->stringPool = realloc(emitter->stringPool, emitter->strPoolLength * sizeof(nodoka_string *));
     emitter->codePool = realloc(emitter->codePool, emitter->codePoolLength * sizeof(nodoka_code *));
     emitter->bytecode = realloc(emitter->bytecode, emitter->bytecodeLength);
+    emitter->handlers = realloc(emitter->handlers, emitter->handlerLength * sizeof(nodoka_handler));
     emitter->strPoolCapacity = emitter->strPoolLength;
     emitter->codePoolCapacity = emitter->codePoolLength;
     emitter->bytecodeCapacity = emitter->bytecodeLength;
+    emitter->handlerCapacity = emitter->handlerLength;
 }
 
 void nodoka_freeEmitter(nodoka_code_emitter *emitter) {
     free(emitter->stringPool);
     free(emitter->codePool);
     free(emitter->bytecode);
-    free(emitter);
+    free(emitter->handlers);
+    slab_free(emitter, sizeof(nodoka_code_emitter));
 }
 
 void nodoka_rewindEmitter(nodoka_code_emitter *emitter) {
     emitter->strPoolLength = 0;
     emitter->codePoolLength = 0;
     emitter->bytecodeLength = 0;
+    emitter->handlerLength = 0;
 }
 
 void nodoka_xchgEmitter(nodoka_code_emitter *e1, nodoka_code_emitter *e2) {
@@ -175,23 +224,31 @@ nodoka_code *nodoka_packCode(nodoka_code_emitter *emitter) {
     code->strPoolLength = emitter->strPoolLength;
     code->codePoolLength = emitter->codePoolLength;
     code->bytecodeLength = emitter->bytecodeLength;
+    code->handlers = emitter->handlers;
+    code->handlerLength = emitter->handlerLength;
     code->formalParameters.length = 0;
     code->formalParameters.array = NULL;
     code->name = NULL;
-    free(emitter);
+    code->localCount = 0;
+    code->slotCount = 0;
+    code->dynamicScope = true;
+    slab_free(emitter, sizeof(nodoka_code_emitter));
+    nodoka_decodeCode(code);
     return code;
 }
 
+/* Release a code which the collector found unreachable. Nested codes are separate heap objects */
 void nodoka_disposeCode(nodoka_code *code) {
-    for (int i = 0; i < code->codePoolLength; i++) {
-        nodoka_disposeCode(code->codePool[i]);
-    }
     free(code->stringPool);
     free(code->codePool);
     free(code->bytecode);
+    free(code->wordcode);
+    free(code->handlers);
+    free(code->wordHandlers);
+    free(code->caches);
     if (code->formalParameters.array)
         free(code->formalParameters.array);
-    free(code);
+    slab_free(code, sizeof(nodoka_code));
 }
 
 
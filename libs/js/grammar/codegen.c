@@ -11,11 +11,157 @@ static void commonCodegen(nodoka_code_emitter *emitter, nodoka_node_list *node)
     }
 }
 
+/*
+ * Resolve node if it is an identifier bound to a frame or environment slot.
+ * Other identifiers go through runtime lookup and references.
+ */
+static bool resolveSlot(nodoka_code_emitter *emitter, nodoka_lex_class *node, nodoka_binding *binding) {
+    if (node->clazz != NODOKA_LEX_TOKEN || ((nodoka_token *)node)->type != NODOKA_TOKEN_ID) {
+        return false;
+    }
+    *binding = nodoka_resolveBinding(emitter->scope, ((nodoka_token *)node)->stringValue);
+    return binding->type != NODOKA_BINDING_DYNAMIC;
+}
+
+static void emitLoad(nodoka_code_emitter *emitter, nodoka_binding binding) {
+    if (binding.type == NODOKA_BINDING_LOCAL) {
+        nodoka_emitBytecode(emitter, NODOKA_BC_GET_LOCAL, binding.index);
+    } else {
+        nodoka_emitBytecode(emitter, NODOKA_BC_GET_UPVAL, binding.depth, binding.index);
+    }
+}
+
+static void emitStore(nodoka_code_emitter *emitter, nodoka_binding binding) {
+    if (binding.type == NODOKA_BINDING_LOCAL) {
+        nodoka_emitBytecode(emitter, NODOKA_BC_SET_LOCAL, binding.index);
+    } else {
+        nodoka_emitBytecode(emitter, NODOKA_BC_SET_UPVAL, binding.depth, binding.index);
+    }
+}
+
+static bool isMember(nodoka_lex_class *node) {
+    return node->clazz == NODOKA_LEX_BINARY_NODE && ((nodoka_binary_node *)node)->type == NODOKA_MEMBER_NODE;
+}
+
+static void commonBinary(nodoka_code_emitter *emitter, nodoka_binary_node *node) {
+    nodoka_codegen(emitter, node->_1);
+    nodoka_emitBytecode(emitter, NODOKA_BC_GET);
+    nodoka_codegen(emitter, node->_2);
+    nodoka_emitBytecode(emitter, NODOKA_BC_GET);
+}
+
+/* Emit a reference for delete and typeof, which need to know about unresolvable names */
+static void codegenReference(nodoka_code_emitter *emitter, nodoka_lex_class *node) {
+    if (node->clazz == NODOKA_LEX_TOKEN && ((nodoka_token *)node)->type == NODOKA_TOKEN_ID) {
+        nodoka_emitBytecode(emitter, NODOKA_BC_LOAD_STR, nodoka_newStringDup(((nodoka_token *)node)->stringValue));
+        nodoka_emitBytecode(emitter, NODOKA_BC_ID);
+    } else if (isMember(node)) {
+        commonBinary(emitter, (nodoka_binary_node *)node);
+        nodoka_emitBytecode(emitter, NODOKA_BC_STR);
+        nodoka_emitBytecode(emitter, NODOKA_BC_REF);
+    } else {
+        nodoka_codegen(emitter, node);
+    }
+}
+
+/*
+ * Left-hand side of assignments. Slots and names take no operand on the
+ * stack, properties take the base and the key, and anything else is left as
+ * it is evaluated so that PUT can reject it at runtime.
+ */
+struct target {
+    enum {
+        TARGET_SLOT,
+        TARGET_NAME,
+        TARGET_PROP,
+        TARGET_OTHER
+    } kind;
+    nodoka_binding binding;
+    nodoka_string *name;
+};
+
+static struct target codegenTarget(nodoka_code_emitter *emitter, nodoka_lex_class *node) {
+    struct target target;
+    if (resolveSlot(emitter, node, &target.binding)) {
+        target.kind = TARGET_SLOT;
+    } else if (node->clazz == NODOKA_LEX_TOKEN && ((nodoka_token *)node)->type == NODOKA_TOKEN_ID) {
+        target.kind = TARGET_NAME;
+        target.name = nodoka_newStringDup(((nodoka_token *)node)->stringValue);
+    } else if (isMember(node)) {
+        target.kind = TARGET_PROP;
+        commonBinary(emitter, (nodoka_binary_node *)node);
+        nodoka_emitBytecode(emitter, NODOKA_BC_KEY);
+    } else {
+        target.kind = TARGET_OTHER;
+        nodoka_codegen(emitter, node);
+    }
+    return target;
+}
+
+/* Push the value of the target, keeping its operands */
+static void emitTargetLoad(nodoka_code_emitter *emitter, struct target target) {
+    switch (target.kind) {
+        case TARGET_SLOT:
+            emitLoad(emitter, target.binding);
+            break;
+        case TARGET_NAME:
+            nodoka_emitBytecode(emitter, NODOKA_BC_GET_NAME, target.name);
+            break;
+        case TARGET_PROP:
+            nodoka_emitBytecode(emitter, NODOKA_BC_DUP2);
+            nodoka_emitBytecode(emitter, NODOKA_BC_GET_PROP);
+            break;
+        case TARGET_OTHER:
+            nodoka_emitBytecode(emitter, NODOKA_BC_DUP);
+            nodoka_emitBytecode(emitter, NODOKA_BC_GET);
+            break;
+    }
+}
+
+/* Store the stack top to the target, consuming its operands but keeping the value */
+static void emitTargetStore(nodoka_code_emitter *emitter, struct target target) {
+    switch (target.kind) {
+        case TARGET_SLOT:
+            nodoka_emitBytecode(emitter, NODOKA_BC_DUP);
+            emitStore(emitter, target.binding);
+            break;
+        case TARGET_NAME:
+            nodoka_emitBytecode(emitter, NODOKA_BC_PUT_NAME, target.name);
+            break;
+        case TARGET_PROP:
+            nodoka_emitBytecode(emitter, NODOKA_BC_PUT_PROP);
+            break;
+        case TARGET_OTHER:
+            nodoka_emitBytecode(emitter, NODOKA_BC_DUP);
+            nodoka_emitBytecode(emitter, NODOKA_BC_XCHG3);
+            nodoka_emitBytecode(emitter, NODOKA_BC_PUT);
+            break;
+    }
+}
+
+/* Move the stack top below the operands of the target */
+static void emitBelowTarget(nodoka_code_emitter *emitter, struct target target) {
+    switch (target.kind) {
+        case TARGET_PROP:
+            nodoka_emitBytecode(emitter, NODOKA_BC_XCHG4);
+            break;
+        case TARGET_OTHER:
+            nodoka_emitBytecode(emitter, NODOKA_BC_XCHG3);
+            break;
+        default:
+            break;
+    }
+}
+
 static void codegenToken(nodoka_code_emitter *emitter, nodoka_token *node) {
     switch (node->type) {
         case NODOKA_TOKEN_ID: {
-            nodoka_emitBytecode(emitter, NODOKA_BC_LOAD_STR, nodoka_newStringDup(node->stringValue));
-            nodoka_emitBytecode(emitter, NODOKA_BC_ID);
+            nodoka_binding binding;
+            if (resolveSlot(emitter, (nodoka_lex_class *)node, &binding)) {
+                emitLoad(emitter, binding);
+                break;
+            }
+            nodoka_emitBytecode(emitter, NODOKA_BC_GET_NAME, nodoka_newStringDup(node->stringValue));
             break;
         }
         case NODOKA_TOKEN_STR: {
@@ -53,12 +199,23 @@ static void commonUnary(nodoka_code_emitter *emitter, nodoka_unary_node *node) {
 static void codegenUnary(nodoka_code_emitter *emitter, nodoka_unary_node *node) {
     switch (node->type) {
         case NODOKA_DELETE_NODE: {
-            nodoka_codegen(emitter, node->_1);
+            nodoka_binding binding;
+            if (resolveSlot(emitter, node->_1, &binding)) {
+                /* Declared variables are not deletable */
+                nodoka_emitBytecode(emitter, NODOKA_BC_FALSE);
+                break;
+            }
+            codegenReference(emitter, node->_1);
             nodoka_emitBytecode(emitter, NODOKA_BC_DEL);
             break;
         }
         case NODOKA_TYPEOF_NODE: {
-            nodoka_codegen(emitter, node->_1);
+            nodoka_binding binding;
+            if (resolveSlot(emitter, node->_1, &binding)) {
+                emitLoad(emitter, binding);
+            } else {
+                codegenReference(emitter, node->_1);
+            }
             nodoka_emitBytecode(emitter, NODOKA_BC_TYPEOF);
             break;
         }
@@ -91,56 +248,28 @@ static void codegenUnary(nodoka_code_emitter *emitter, nodoka_unary_node *node)
             nodoka_emitBytecode(emitter, NODOKA_BC_L_NOT);
             break;
         }
-        case NODOKA_POST_INC_NODE: {
-            nodoka_codegen(emitter, node->_1);
-            /* a check */
-            nodoka_emitBytecode(emitter, NODOKA_BC_DUP);
-            nodoka_emitBytecode(emitter, NODOKA_BC_GET);
-            nodoka_emitBytecode(emitter, NODOKA_BC_NUM);
-            nodoka_emitBytecode(emitter, NODOKA_BC_DUP);
-            nodoka_emitBytecode(emitter, NODOKA_BC_XCHG3);
-            nodoka_emitBytecode(emitter, NODOKA_BC_LOAD_NUM, 1.0);
-            nodoka_emitBytecode(emitter, NODOKA_BC_ADD);
-            nodoka_emitBytecode(emitter, NODOKA_BC_PUT);
-            break;
-        }
+        case NODOKA_POST_INC_NODE:
         case NODOKA_POST_DEC_NODE: {
-            nodoka_codegen(emitter, node->_1);
-            /* a check */
-            nodoka_emitBytecode(emitter, NODOKA_BC_DUP);
-            nodoka_emitBytecode(emitter, NODOKA_BC_GET);
+            struct target target = codegenTarget(emitter, node->_1);
+            emitTargetLoad(emitter, target);
             nodoka_emitBytecode(emitter, NODOKA_BC_NUM);
+            /* Keep the old value as the result */
             nodoka_emitBytecode(emitter, NODOKA_BC_DUP);
-            nodoka_emitBytecode(emitter, NODOKA_BC_XCHG3);
+            emitBelowTarget(emitter, target);
             nodoka_emitBytecode(emitter, NODOKA_BC_LOAD_NUM, 1.0);
-            nodoka_emitBytecode(emitter, NODOKA_BC_SUB);
-            nodoka_emitBytecode(emitter, NODOKA_BC_PUT);
-            break;
-        }
-        case NODOKA_PRE_INC_NODE: {
-            nodoka_codegen(emitter, node->_1);
-            /* a check */
-            nodoka_emitBytecode(emitter, NODOKA_BC_DUP);
-            nodoka_emitBytecode(emitter, NODOKA_BC_GET);
-            nodoka_emitBytecode(emitter, NODOKA_BC_NUM);
-            nodoka_emitBytecode(emitter, NODOKA_BC_LOAD_NUM, 1.0);
-            nodoka_emitBytecode(emitter, NODOKA_BC_ADD);
-            nodoka_emitBytecode(emitter, NODOKA_BC_DUP);
-            nodoka_emitBytecode(emitter, NODOKA_BC_XCHG3);
-            nodoka_emitBytecode(emitter, NODOKA_BC_PUT);
+            nodoka_emitBytecode(emitter, node->type == NODOKA_POST_INC_NODE ? NODOKA_BC_ADD : NODOKA_BC_SUB);
+            emitTargetStore(emitter, target);
+            nodoka_emitBytecode(emitter, NODOKA_BC_POP);
             break;
         }
+        case NODOKA_PRE_INC_NODE:
         case NODOKA_PRE_DEC_NODE: {
-            nodoka_codegen(emitter, node->_1);
-            /* a check */
-            nodoka_emitBytecode(emitter, NODOKA_BC_DUP);
-            nodoka_emitBytecode(emitter, NODOKA_BC_GET);
+            struct target target = codegenTarget(emitter, node->_1);
+            emitTargetLoad(emitter, target);
             nodoka_emitBytecode(emitter, NODOKA_BC_NUM);
             nodoka_emitBytecode(emitter, NODOKA_BC_LOAD_NUM, 1.0);
-            nodoka_emitBytecode(emitter, NODOKA_BC_SUB);
-            nodoka_emitBytecode(emitter, NODOKA_BC_DUP);
-            nodoka_emitBytecode(emitter, NODOKA_BC_XCHG3);
-            nodoka_emitBytecode(emitter, NODOKA_BC_PUT);
+            nodoka_emitBytecode(emitter, node->type == NODOKA_PRE_INC_NODE ? NODOKA_BC_ADD : NODOKA_BC_SUB);
+            emitTargetStore(emitter, target);
             break;
         }
 
@@ -155,13 +284,6 @@ static void codegenUnary(nodoka_code_emitter *emitter, nodoka_unary_node *node)
     }
 }
 
-static void commonBinary(nodoka_code_emitter *emitter, nodoka_binary_node *node) {
-    nodoka_codegen(emitter, node->_1);
-    nodoka_emitBytecode(emitter, NODOKA_BC_GET);
-    nodoka_codegen(emitter, node->_2);
-    nodoka_emitBytecode(emitter, NODOKA_BC_GET);
-}
-
 static void commonBinaryNum(nodoka_code_emitter *emitter, nodoka_binary_node *node) {
     commonBinary(emitter, node);
     nodoka_emitBytecode(emitter, NODOKA_BC_XCHG);
@@ -174,14 +296,24 @@ static void codegenBinary(nodoka_code_emitter *emitter, nodoka_binary_node *node
     switch (node->type) {
         case NODOKA_MEMBER_NODE: {
             commonBinary(emitter, node);
-            /* Call CheckObjectCoercible(baseValue). */
-            nodoka_emitBytecode(emitter, NODOKA_BC_STR);
-            nodoka_emitBytecode(emitter, NODOKA_BC_REF);
+            nodoka_emitBytecode(emitter, NODOKA_BC_KEY);
+            nodoka_emitBytecode(emitter, NODOKA_BC_GET_PROP);
             break;
         }
 
         case NODOKA_CALL_NODE: {
-            nodoka_codegen(emitter, node->_1);
+            /* The callee decides this, so it is not evaluated to a plain value */
+            nodoka_binding binding;
+            bool name = node->_1->clazz == NODOKA_LEX_TOKEN && ((nodoka_token *)node->_1)->type == NODOKA_TOKEN_ID
+                        && !resolveSlot(emitter, node->_1, &binding);
+            bool member = isMember(node->_1);
+            if (member) {
+                commonBinary(emitter, (nodoka_binary_node *)node->_1);
+                nodoka_emitBytecode(emitter, NODOKA_BC_KEY);
+            } else if (!name) {
+                nodoka_codegen(emitter, node->_1);
+                nodoka_emitBytecode(emitter, NODOKA_BC_GET);
+            }
             nodoka_node_list *list = (nodoka_node_list *)node->_2;
             size_t count;
             if (list) {
@@ -190,7 +322,13 @@ static void codegenBinary(nodoka_code_emitter *emitter, nodoka_binary_node *node
             } else {
                 count = 0;
             }
-            nodoka_emitBytecode(emitter, NODOKA_BC_CALL, count);
+            if (member) {
+                nodoka_emitBytecode(emitter, NODOKA_BC_CALL_PROP, count);
+            } else if (name) {
+                nodoka_emitBytecode(emitter, NODOKA_BC_CALL_NAME, nodoka_newStringDup(((nodoka_token *)node->_1)->stringValue), count);
+            } else {
+                nodoka_emitBytecode(emitter, NODOKA_BC_CALL, count);
+            }
             break;
         }
 
@@ -343,20 +481,16 @@ static void codegenBinary(nodoka_code_emitter *emitter, nodoka_binary_node *node
         }
 
         case NODOKA_ASSIGN_NODE: {
-            nodoka_codegen(emitter, node->_1);
+            struct target target = codegenTarget(emitter, node->_1);
             nodoka_codegen(emitter, node->_2);
             nodoka_emitBytecode(emitter, NODOKA_BC_GET);
-            nodoka_emitBytecode(emitter, NODOKA_BC_DUP);
-            nodoka_emitBytecode(emitter, NODOKA_BC_XCHG3);
-            /* A check */
-            nodoka_emitBytecode(emitter, NODOKA_BC_PUT);
+            emitTargetStore(emitter, target);
             break;
         }
 
         case NODOKA_ADD_ASSIGN_NODE: {
-            nodoka_codegen(emitter, node->_1);
-            nodoka_emitBytecode(emitter, NODOKA_BC_DUP);
-            nodoka_emitBytecode(emitter, NODOKA_BC_GET);
+            struct target target = codegenTarget(emitter, node->_1);
+            emitTargetLoad(emitter, target);
             nodoka_codegen(emitter, node->_2);
             nodoka_emitBytecode(emitter, NODOKA_BC_GET);
             nodoka_emitBytecode(emitter, NODOKA_BC_XCHG);
@@ -364,10 +498,7 @@ static void codegenBinary(nodoka_code_emitter *emitter, nodoka_binary_node *node
             nodoka_emitBytecode(emitter, NODOKA_BC_XCHG);
             nodoka_emitBytecode(emitter, NODOKA_BC_PRIM);
             nodoka_emitBytecode(emitter, NODOKA_BC_ADD);
-            nodoka_emitBytecode(emitter, NODOKA_BC_DUP);
-            nodoka_emitBytecode(emitter, NODOKA_BC_XCHG3);
-            /* A check */
-            nodoka_emitBytecode(emitter, NODOKA_BC_PUT);
+            emitTargetStore(emitter, target);
             break;
         }
         case NODOKA_MUL_ASSIGN_NODE:
@@ -380,9 +511,8 @@ static void codegenBinary(nodoka_code_emitter *emitter, nodoka_binary_node *node
         case NODOKA_AND_ASSIGN_NODE:
         case NODOKA_OR_ASSIGN_NODE:
         case NODOKA_XOR_ASSIGN_NODE: {
-            nodoka_codegen(emitter, node->_1);
-            nodoka_emitBytecode(emitter, NODOKA_BC_DUP);
-            nodoka_emitBytecode(emitter, NODOKA_BC_GET);
+            struct target target = codegenTarget(emitter, node->_1);
+            emitTargetLoad(emitter, target);
             nodoka_codegen(emitter, node->_2);
             nodoka_emitBytecode(emitter, NODOKA_BC_GET);
             nodoka_emitBytecode(emitter, NODOKA_BC_XCHG);
@@ -402,10 +532,7 @@ static void codegenBinary(nodoka_code_emitter *emitter, nodoka_binary_node *node
                 case NODOKA_XOR_ASSIGN_NODE: nodoka_emitBytecode(emitter, NODOKA_BC_XOR); break;
                 default: assert(0);
             }
-            nodoka_emitBytecode(emitter, NODOKA_BC_DUP);
-            nodoka_emitBytecode(emitter, NODOKA_BC_XCHG3);
-            /* A check */
-            nodoka_emitBytecode(emitter, NODOKA_BC_PUT);
+            emitTargetStore(emitter, target);
             break;
         }
 
@@ -510,19 +637,154 @@ void codegenTernary(nodoka_code_emitter *emitter, nodoka_ternary_node *node) {
     }
 }
 
+/*
+ * A finally block being generated. It is compiled once, and entered with
+ * the completion value of the try statement, a value and the kind of
+ * completion which led to it on the stack. Abrupt completions made inside
+ * the protected code jump to it, and it resumes them when it is done.
+ */
+struct nodoka_finally {
+    nodoka_finally *outer;
+    /* Stack depth of the try statement */
+    size_t depth;
+    /* Jumps of return statements to the entry, relocated once it is known */
+    nodoka_relocatable *returns;
+    size_t returnLength;
+};
+
+enum {
+    COMPLETION_NORMAL,
+    COMPLETION_THROW,
+    COMPLETION_RETURN,
+};
+
+/* Return the stack top, depth being the number of values below it */
+static void emitReturn(nodoka_code_emitter *emitter, nodoka_finally *finally, size_t depth) {
+    if (!finally) {
+        /* RET discards the operand stack */
+        nodoka_emitBytecode(emitter, NODOKA_BC_RET);
+        return;
+    }
+    for (size_t i = finally->depth; i < depth; i++) {
+        nodoka_emitBytecode(emitter, NODOKA_BC_XCHG);
+        nodoka_emitBytecode(emitter, NODOKA_BC_POP);
+    }
+    finally->returns = realloc(finally->returns, (finally->returnLength + 1) * sizeof(nodoka_relocatable));
+    nodoka_emitBytecode(emitter, NODOKA_BC_LOAD_NUM, (double)COMPLETION_RETURN);
+    nodoka_emitBytecode(emitter, NODOKA_BC_JMP, &finally->returns[finally->returnLength++]);
+}
+
+static void emitCatchParam(nodoka_code_emitter *emitter, nodoka_lex_class *param) {
+    nodoka_binding binding;
+    if (resolveSlot(emitter, param, &binding)) {
+        emitStore(emitter, binding);
+    } else {
+        nodoka_emitBytecode(emitter, NODOKA_BC_PUT_NAME, nodoka_newStringDup(((nodoka_token *)param)->stringValue));
+        nodoka_emitBytecode(emitter, NODOKA_BC_POP);
+    }
+}
+
+/*
+ * The try statement is compiled inline, and the ranges it protects are
+ * recorded in the exception table, so nothing is done on entry. The catch
+ * block is entered with the exception pushed on top of the completion value.
+ */
+static void codegenTry(nodoka_code_emitter *emitter, nodoka_node_list *node) {
+    size_t depth = emitter->depth;
+    nodoka_finally finally = {
+        .outer = emitter->finally,
+         .depth = depth,
+          .returns = NULL,
+           .returnLength = 0
+    };
+    nodoka_relocatable toEnd, toFinally[2];
+    if (node->_[3]) {
+        emitter->finally = &finally;
+    }
+
+    nodoka_label tryStart = nodoka_putLabel(emitter);
+    nodoka_codegen(emitter, node->_[0]);
+    nodoka_label tryEnd = nodoka_putLabel(emitter);
+    if (node->_[3]) {
+        nodoka_emitBytecode(emitter, NODOKA_BC_UNDEF);
+        nodoka_emitBytecode(emitter, NODOKA_BC_LOAD_NUM, (double)COMPLETION_NORMAL);
+        nodoka_emitBytecode(emitter, NODOKA_BC_JMP, &toFinally[0]);
+    } else {
+        nodoka_emitBytecode(emitter, NODOKA_BC_JMP, &toEnd);
+    }
+
+    nodoka_label catchStart = 0, catchEnd = 0;
+    if (node->_[1]) {
+        catchStart = nodoka_putLabel(emitter);
+        emitCatchParam(emitter, node->_[1]);
+        nodoka_codegen(emitter, node->_[2]);
+        catchEnd = nodoka_putLabel(emitter);
+        nodoka_emitHandler(emitter, tryStart, tryEnd, catchStart, depth);
+    }
+
+    if (!node->_[3]) {
+        nodoka_relocate(emitter, toEnd, nodoka_putLabel(emitter));
+        return;
+    }
+    emitter->finally = finally.outer;
+    nodoka_emitBytecode(emitter, NODOKA_BC_UNDEF);
+    nodoka_emitBytecode(emitter, NODOKA_BC_LOAD_NUM, (double)COMPLETION_NORMAL);
+    nodoka_emitBytecode(emitter, NODOKA_BC_JMP, &toFinally[1]);
+
+    /* Exceptions not caught are rethrown after the finally block */
+    nodoka_label throwPoint = nodoka_putLabel(emitter);
+    nodoka_emitBytecode(emitter, NODOKA_BC_LOAD_NUM, (double)COMPLETION_THROW);
+    if (node->_[1]) {
+        nodoka_emitHandler(emitter, catchStart, catchEnd, throwPoint, depth);
+    } else {
+        nodoka_emitHandler(emitter, tryStart, tryEnd, throwPoint, depth);
+    }
+
+    nodoka_label entry = nodoka_putLabel(emitter);
+    nodoka_relocate(emitter, toFinally[0], entry);
+    nodoka_relocate(emitter, toFinally[1], entry);
+    for (size_t i = 0; i < finally.returnLength; i++) {
+        nodoka_relocate(emitter, finally.returns[i], entry);
+    }
+    emitter->depth = depth + 3;
+    nodoka_emitBytecode(emitter, NODOKA_BC_UNDEF);
+    nodoka_codegen(emitter, node->_[3]);
+    nodoka_emitBytecode(emitter, NODOKA_BC_POP);
+    emitter->depth = depth;
+
+    /* Resume the completion the block was entered with */
+    nodoka_relocatable toNormal, toThrow;
+    nodoka_emitBytecode(emitter, NODOKA_BC_DUP);
+    nodoka_emitBytecode(emitter, NODOKA_BC_LOAD_NUM, (double)COMPLETION_NORMAL);
+    nodoka_emitBytecode(emitter, NODOKA_BC_S_EQ);
+    nodoka_emitBytecode(emitter, NODOKA_BC_JT, &toNormal);
+    if (finally.returnLength) {
+        nodoka_emitBytecode(emitter, NODOKA_BC_DUP);
+        nodoka_emitBytecode(emitter, NODOKA_BC_LOAD_NUM, (double)COMPLETION_THROW);
+        nodoka_emitBytecode(emitter, NODOKA_BC_S_EQ);
+        nodoka_emitBytecode(emitter, NODOKA_BC_JT, &toThrow);
+        nodoka_emitBytecode(emitter, NODOKA_BC_POP);
+        emitReturn(emitter, finally.outer, depth);
+        nodoka_relocate(emitter, toThrow, nodoka_putLabel(emitter));
+    }
+    nodoka_emitBytecode(emitter, NODOKA_BC_POP);
+    nodoka_emitBytecode(emitter, NODOKA_BC_THROW);
+    nodoka_relocate(emitter, toNormal, nodoka_putLabel(emitter));
+    nodoka_emitBytecode(emitter, NODOKA_BC_POP);
+    nodoka_emitBytecode(emitter, NODOKA_BC_POP);
+    free(finally.returns);
+}
+
 void codegen(nodoka_code_emitter *emitter, nodoka_node_list *node) {
     switch (node->type) {
         case NODOKA_RETURN_STMT: {
             /* must be function */
             if (node->_[0]) {
-                nodoka_emitBytecode(emitter, NODOKA_BC_POP);
                 commonCodegen(emitter, node);
-                nodoka_emitBytecode(emitter, NODOKA_BC_RET);
             } else {
-                nodoka_emitBytecode(emitter, NODOKA_BC_POP);
                 nodoka_emitBytecode(emitter, NODOKA_BC_UNDEF);
-                nodoka_emitBytecode(emitter, NODOKA_BC_RET);
             }
+            emitReturn(emitter, emitter->finally, emitter->depth);
             break;
         }
         case NODOKA_THROW_STMT: {
@@ -533,10 +795,10 @@ void codegen(nodoka_code_emitter *emitter, nodoka_node_list *node) {
         case NODOKA_OBJ_LIT_VAL: {
             nodoka_emitBytecode(emitter, NODOKA_BC_DUP);
             nodoka_codegen(emitter, node->_[0]);
-            nodoka_emitBytecode(emitter, NODOKA_BC_REF);
             nodoka_codegen(emitter, node->_[1]);
             nodoka_emitBytecode(emitter, NODOKA_BC_GET);
-            nodoka_emitBytecode(emitter, NODOKA_BC_PUT);
+            nodoka_emitBytecode(emitter, NODOKA_BC_PUT_PROP);
+            nodoka_emitBytecode(emitter, NODOKA_BC_POP);
             break;
         }
         case NODOKA_NEW_NODE: {
@@ -554,11 +816,16 @@ void codegen(nodoka_code_emitter *emitter, nodoka_node_list *node) {
             break;
         }
         case NODOKA_VAR_STMT: {
-            if (node->_[1]) {
-                nodoka_codegen(emitter, node->_[0]);
+            nodoka_binding binding;
+            if (node->_[1] && resolveSlot(emitter, node->_[0], &binding)) {
+                nodoka_codegen(emitter, node->_[1]);
+                nodoka_emitBytecode(emitter, NODOKA_BC_GET);
+                emitStore(emitter, binding);
+            } else if (node->_[1]) {
                 nodoka_codegen(emitter, node->_[1]);
                 nodoka_emitBytecode(emitter, NODOKA_BC_GET);
-                nodoka_emitBytecode(emitter, NODOKA_BC_PUT);
+                nodoka_emitBytecode(emitter, NODOKA_BC_PUT_NAME, nodoka_newStringDup(((nodoka_token *)node->_[0])->stringValue));
+                nodoka_emitBytecode(emitter, NODOKA_BC_POP);
             }
             break;
         }
@@ -573,7 +840,22 @@ void codegen(nodoka_code_emitter *emitter, nodoka_node_list *node) {
         }
         case NODOKA_FUNCTION_NODE: {
             /* Codegen */
+            nodoka_scope *scope = nodoka_newScope(emitter->scope, node);
             nodoka_code_emitter *funcBody = nodoka_newCodeEmitter();
+            funcBody->scope = scope;
+            /* Move captured parameters from the frame to the environment record */
+            for (size_t i = 0; i < scope->length; i++) {
+                nodoka_variable *var = &scope->vars[i];
+                if (var->param && var->captured) {
+                    nodoka_emitBytecode(funcBody, NODOKA_BC_GET_LOCAL, var->local);
+                    nodoka_emitBytecode(funcBody, NODOKA_BC_SET_UPVAL, 0, var->slot);
+                }
+            }
+            if (scope->hasSelf && scope->self.captured) {
+                nodoka_emitBytecode(funcBody, NODOKA_BC_GET_LOCAL, scope->self.local);
+                nodoka_emitBytecode(funcBody, NODOKA_BC_SET_UPVAL, 0, scope->self.slot);
+            }
+            nodoka_declgen(funcBody, node->_[2]);
             nodoka_emitBytecode(funcBody, NODOKA_BC_UNDEF);
             nodoka_codegen(funcBody, node->_[2]);
             nodoka_emitBytecode(funcBody, NODOKA_BC_POP);
@@ -581,6 +863,13 @@ void codegen(nodoka_code_emitter *emitter, nodoka_node_list *node) {
             nodoka_emitBytecode(funcBody, NODOKA_BC_RET);
             nodoka_optimizer(funcBody);
             nodoka_code *code = nodoka_packCode(funcBody);
+            code->localCount = scope->localCount;
+            code->slotCount = scope->slotCount;
+            code->dynamicScope = scope->dynamic;
+            nodoka_disposeScope(scope);
+            if (!nodoka_verifyCode(code)) {
+                assert(0);
+            }
 
             nodoka_node_list *param = (nodoka_node_list *)node->_[1];
             if (param) {
@@ -589,7 +878,7 @@ void codegen(nodoka_code_emitter *emitter, nodoka_node_list *node) {
                 for (int i = 0; i < param->length; i++) {
                     nodoka_token *id = (nodoka_token *)param->_[i];
                     assert(id->base.clazz == NODOKA_LEX_TOKEN && id->type == NODOKA_TOKEN_ID);
-                    code->formalParameters.array[i] = nodoka_new_string(id->stringValue);
+                    code->formalParameters.array[i] = nodoka_newAtom(id->stringValue);
                     id->stringValue.str = NULL;
                 }
             } else {
@@ -599,7 +888,7 @@ void codegen(nodoka_code_emitter *emitter, nodoka_node_list *node) {
             if (node->_[0]) {
                 nodoka_token *id = (nodoka_token *)node->_[0];
                 assert(id->base.clazz == NODOKA_LEX_TOKEN && id->type == NODOKA_TOKEN_ID);
-                code->name = nodoka_new_string(id->stringValue);
+                code->name = nodoka_newAtom(id->stringValue);
                 id->stringValue.str = NULL;
             }
             nodoka_emitBytecode(emitter, NODOKA_BC_FUNC, code);
@@ -662,68 +951,7 @@ void codegen(nodoka_code_emitter *emitter, nodoka_node_list *node) {
             break;
         }
         case NODOKA_TRY_STMT: {
-            nodoka_code *finallyBlock = NULL;
-            if (node->_[3]) {
-                nodoka_code_emitter *finallyBody = nodoka_newCodeEmitter();
-                nodoka_codegen(finallyBody, node->_[3]);
-                nodoka_emitBytecode(finallyBody, NODOKA_BC_RET);
-                nodoka_optimizer(finallyBody);
-                finallyBlock = nodoka_packCode(finallyBody);
-            }
-            nodoka_code_emitter *tryBody = nodoka_newCodeEmitter();
-            nodoka_relocatable catchPtr;
-            nodoka_emitBytecode(tryBody, NODOKA_BC_CATCH, &catchPtr);
-            nodoka_codegen(tryBody, node->_[0]);
-            if (node->_[1]) {
-                if (finallyBlock) {
-                    nodoka_label finallyRet = nodoka_putLabel(tryBody);
-                    nodoka_emitBytecode(tryBody, NODOKA_BC_NOCATCH);
-                    nodoka_emitBytecode(tryBody, NODOKA_BC_DUP);
-                    nodoka_emitBytecode(tryBody, NODOKA_BC_TRY, finallyBlock);
-                    nodoka_emitBytecode(tryBody, NODOKA_BC_POP);
-                    nodoka_emitBytecode(tryBody, NODOKA_BC_RET);
-                    nodoka_relocate(tryBody, catchPtr, nodoka_putLabel(tryBody));
-                    nodoka_relocatable finallyPtr;
-                    nodoka_emitBytecode(tryBody, NODOKA_BC_CATCH, &finallyPtr);
-                    nodoka_codegen(tryBody, node->_[1]);
-                    nodoka_emitBytecode(tryBody, NODOKA_BC_XCHG);
-                    nodoka_emitBytecode(tryBody, NODOKA_BC_PUT);
-                    nodoka_codegen(tryBody, node->_[2]);
-                    nodoka_relocatable toFinally;
-                    nodoka_emitBytecode(tryBody, NODOKA_BC_JMP, &toFinally);
-                    nodoka_relocate(tryBody, toFinally, finallyRet);
-                    nodoka_relocate(tryBody, finallyPtr, nodoka_putLabel(tryBody));
-                    nodoka_emitBytecode(tryBody, NODOKA_BC_NOCATCH);
-                    nodoka_emitBytecode(tryBody, NODOKA_BC_DUP);
-                    nodoka_emitBytecode(tryBody, NODOKA_BC_TRY, finallyBlock);
-                    nodoka_emitBytecode(tryBody, NODOKA_BC_POP);
-                    nodoka_emitBytecode(tryBody, NODOKA_BC_THROW);
-                } else {
-                    nodoka_emitBytecode(tryBody, NODOKA_BC_RET);
-                    nodoka_relocate(tryBody, catchPtr, nodoka_putLabel(tryBody));
-                    nodoka_codegen(tryBody, node->_[1]);
-                    nodoka_emitBytecode(tryBody, NODOKA_BC_NOCATCH);
-                    nodoka_emitBytecode(tryBody, NODOKA_BC_XCHG);
-                    nodoka_emitBytecode(tryBody, NODOKA_BC_PUT);
-                    nodoka_codegen(tryBody, node->_[2]);
-                    nodoka_emitBytecode(tryBody, NODOKA_BC_RET);
-                }
-            } else {
-                nodoka_emitBytecode(tryBody, NODOKA_BC_NOCATCH);
-                nodoka_emitBytecode(tryBody, NODOKA_BC_DUP);
-                nodoka_emitBytecode(tryBody, NODOKA_BC_TRY, finallyBlock);
-                nodoka_emitBytecode(tryBody, NODOKA_BC_POP);
-                nodoka_emitBytecode(tryBody, NODOKA_BC_RET);
-                nodoka_relocate(tryBody, catchPtr, nodoka_putLabel(tryBody));
-                nodoka_emitBytecode(tryBody, NODOKA_BC_NOCATCH);
-                nodoka_emitBytecode(tryBody, NODOKA_BC_DUP);
-                nodoka_emitBytecode(tryBody, NODOKA_BC_TRY, finallyBlock);
-                nodoka_emitBytecode(tryBody, NODOKA_BC_POP);
-                nodoka_emitBytecode(tryBody, NODOKA_BC_THROW);
-            }
-            nodoka_optimizer(tryBody);
-            nodoka_code *code = nodoka_packCode(tryBody);
-            nodoka_emitBytecode(emitter, NODOKA_BC_TRY, code);
+            codegenTry(emitter, node);
             break;
         }
         case NODOKA_ARR_LIT: {
@@ -734,11 +962,11 @@ void codegen(nodoka_code_emitter *emitter, nodoka_node_list *node) {
                 if (node->_[i]) {
                     nodoka_emitBytecode(emitter, NODOKA_BC_DUP);
                     nodoka_emitBytecode(emitter, NODOKA_BC_LOAD_NUM, (double)i);
-                    nodoka_emitBytecode(emitter, NODOKA_BC_STR);
-                    nodoka_emitBytecode(emitter, NODOKA_BC_REF);
+                    nodoka_emitBytecode(emitter, NODOKA_BC_KEY);
                     nodoka_codegen(emitter, node->_[i]);
                     nodoka_emitBytecode(emitter, NODOKA_BC_GET);
-                    nodoka_emitBytecode(emitter, NODOKA_BC_PUT);
+                    nodoka_emitBytecode(emitter, NODOKA_BC_PUT_PROP);
+                    nodoka_emitBytecode(emitter, NODOKA_BC_POP);
                 }
             }
             break;
@@ -59,15 +59,29 @@ static void declgen(nodoka_code_emitter *emitter, nodoka_node_list *node) {
         }
         case NODOKA_VAR_STMT: {
             nodoka_token *id = (nodoka_token *)node->_[0];
-            nodoka_emitBytecode(emitter, NODOKA_BC_DECL, nodoka_newStringDup(id->stringValue));
+            /* Variables resolved to slots need no declaration */
+            if (nodoka_resolveBinding(emitter->scope, id->stringValue).type == NODOKA_BINDING_DYNAMIC) {
+                nodoka_emitBytecode(emitter, NODOKA_BC_DECL, nodoka_newStringDup(id->stringValue));
+            }
             break;
         }
         case NODOKA_FUNC_DECL: {
             nodoka_token *id = (nodoka_token *)node->_[0];
-            nodoka_emitBytecode(emitter, NODOKA_BC_DECL, nodoka_newStringDup(id->stringValue));
-            nodoka_codegen(emitter, node->_[0]);
+            nodoka_binding binding = nodoka_resolveBinding(emitter->scope, id->stringValue);
+            if (binding.type == NODOKA_BINDING_LOCAL) {
+                nodoka_codegen(emitter, node->_[1]);
+                nodoka_emitBytecode(emitter, NODOKA_BC_SET_LOCAL, binding.index);
+                break;
+            } else if (binding.type == NODOKA_BINDING_UPVAL) {
+                nodoka_codegen(emitter, node->_[1]);
+                nodoka_emitBytecode(emitter, NODOKA_BC_SET_UPVAL, binding.depth, binding.index);
+                break;
+            }
+            nodoka_string *name = nodoka_newStringDup(id->stringValue);
+            nodoka_emitBytecode(emitter, NODOKA_BC_DECL, name);
             nodoka_codegen(emitter, node->_[1]);
-            nodoka_emitBytecode(emitter, NODOKA_BC_PUT);
+            nodoka_emitBytecode(emitter, NODOKA_BC_PUT_NAME, name);
+            nodoka_emitBytecode(emitter, NODOKA_BC_POP);
             break;
         }
         case NODOKA_STMT_LIST: {
@@ -0,0 +1,282 @@
+#include "c/stdlib.h"
+#include "c/assert.h"
+
+#include "unicode/hash.h"
+
+#include "js/lex.h"
+
+enum {
+    DEF_VAR_CAPACITY = 8,
+    VAR_CAPACITY_INC_STEP = 8,
+};
+
+static bool nameEquals(utf16_string_t a, utf16_string_t b) {
+    return unicode_utf16Cmp(&a, &b) == 0;
+}
+
+static bool isEval(utf16_string_t name) {
+    return name.len == 4 && name.str[0] == 'e' && name.str[1] == 'v' && name.str[2] == 'a' && name.str[3] == 'l';
+}
+
+static nodoka_scope *allocScope(nodoka_scope *outer) {
+    nodoka_scope *scope = malloc(sizeof(nodoka_scope));
+    scope->outer = outer;
+    scope->vars = malloc(DEF_VAR_CAPACITY * sizeof(nodoka_variable));
+    scope->length = 0;
+    scope->capacity = DEF_VAR_CAPACITY;
+    scope->hasSelf = false;
+    scope->localCount = 0;
+    scope->slotCount = 0;
+    scope->dynamic = false;
+    return scope;
+}
+
+static nodoka_variable *lookup(nodoka_scope *scope, utf16_string_t name) {
+    for (size_t i = 0; i < scope->length; i++) {
+        if (nameEquals(scope->vars[i].name, name)) {
+            return &scope->vars[i];
+        }
+    }
+    /* The name of a function expression is shadowed by anything declared in it */
+    if (scope->hasSelf && nameEquals(scope->self.name, name)) {
+        return &scope->self;
+    }
+    return NULL;
+}
+
+static nodoka_variable *declare(nodoka_scope *scope, utf16_string_t name) {
+    for (size_t i = 0; i < scope->length; i++) {
+        if (nameEquals(scope->vars[i].name, name)) {
+            return &scope->vars[i];
+        }
+    }
+    if (scope->length == scope->capacity) {
+        scope->capacity += VAR_CAPACITY_INC_STEP;
+        scope->vars = realloc(scope->vars, scope->capacity * sizeof(nodoka_variable));
+    }
+    nodoka_variable *var = &scope->vars[scope->length++];
+    var->name = name;
+    var->captured = false;
+    var->param = false;
+    var->local = 0;
+    var->slot = 0;
+    return var;
+}
+
+/* Collect var, function and catch declarations, without entering nested functions */
+static void collectDecl(nodoka_scope *scope, nodoka_lex_class *node) {
+    if (!node) {
+        return;
+    }
+    switch (node->clazz) {
+        case NODOKA_LEX_TOKEN:
+        case NODOKA_LEX_EMPTY_NODE:
+            break;
+        case NODOKA_LEX_UNARY_NODE: {
+            nodoka_unary_node *n = (nodoka_unary_node *)node;
+            collectDecl(scope, n->_1);
+            break;
+        }
+        case NODOKA_LEX_BINARY_NODE: {
+            nodoka_binary_node *n = (nodoka_binary_node *)node;
+            collectDecl(scope, n->_1);
+            collectDecl(scope, n->_2);
+            break;
+        }
+        case NODOKA_LEX_TERNARY_NODE: {
+            nodoka_ternary_node *n = (nodoka_ternary_node *)node;
+            collectDecl(scope, n->_1);
+            collectDecl(scope, n->_2);
+            collectDecl(scope, n->_3);
+            break;
+        }
+        case NODOKA_LEX_NODE_LIST: {
+            nodoka_node_list *n = (nodoka_node_list *)node;
+            switch (n->type) {
+                case NODOKA_FUNCTION_NODE:
+                    return;
+                case NODOKA_FUNC_DECL:
+                    declare(scope, ((nodoka_token *)n->_[0])->stringValue);
+                    return;
+                case NODOKA_VAR_STMT:
+                    declare(scope, ((nodoka_token *)n->_[0])->stringValue);
+                    collectDecl(scope, n->_[1]);
+                    return;
+                case NODOKA_TRY_STMT:
+                    /* The catch parameter lives in the function scope */
+                    if (n->_[1]) {
+                        declare(scope, ((nodoka_token *)n->_[1])->stringValue);
+                    }
+                    collectDecl(scope, n->_[0]);
+                    collectDecl(scope, n->_[2]);
+                    collectDecl(scope, n->_[3]);
+                    return;
+                default:
+                    for (size_t i = 0; i < n->length; i++) {
+                        collectDecl(scope, n->_[i]);
+                    }
+                    return;
+            }
+        }
+        default: assert(0);
+    }
+}
+
+static nodoka_scope *declScope(nodoka_scope *outer, nodoka_node_list *func) {
+    nodoka_scope *scope = allocScope(outer);
+    nodoka_node_list *param = (nodoka_node_list *)func->_[1];
+    if (param) {
+        for (size_t i = 0; i < param->length; i++) {
+            nodoka_variable *var = declare(scope, ((nodoka_token *)param->_[i])->stringValue);
+            /* With duplicate names, the last parameter wins */
+            var->param = true;
+            var->local = i;
+        }
+        scope->localCount = param->length;
+    }
+    if (func->_[0]) {
+        scope->hasSelf = true;
+        scope->self.name = ((nodoka_token *)func->_[0])->stringValue;
+        scope->self.captured = false;
+        scope->self.param = true;
+        scope->self.local = scope->localCount++;
+        scope->self.slot = 0;
+    }
+    collectDecl(scope, func->_[2]);
+    return scope;
+}
+
+/*
+ * Find references to variables of owner made from inside nested functions.
+ * current is the innermost scope around node, which is either owner or a
+ * scope nested in it.
+ */
+static void scanRef(nodoka_scope *owner, nodoka_scope *current, nodoka_lex_class *node) {
+    if (!node) {
+        return;
+    }
+    switch (node->clazz) {
+        case NODOKA_LEX_TOKEN: {
+            nodoka_token *n = (nodoka_token *)node;
+            if (n->type != NODOKA_TOKEN_ID) {
+                break;
+            }
+            /* eval could see and introduce any name, so keep this scope dynamic */
+            if (isEval(n->stringValue)) {
+                owner->dynamic = true;
+            }
+            for (nodoka_scope *scope = current; scope != owner; scope = scope->outer) {
+                if (lookup(scope, n->stringValue)) {
+                    return;
+                }
+            }
+            if (current != owner) {
+                nodoka_variable *var = lookup(owner, n->stringValue);
+                if (var) {
+                    var->captured = true;
+                }
+            }
+            break;
+        }
+        case NODOKA_LEX_EMPTY_NODE:
+            break;
+        case NODOKA_LEX_UNARY_NODE: {
+            nodoka_unary_node *n = (nodoka_unary_node *)node;
+            scanRef(owner, current, n->_1);
+            break;
+        }
+        case NODOKA_LEX_BINARY_NODE: {
+            nodoka_binary_node *n = (nodoka_binary_node *)node;
+            scanRef(owner, current, n->_1);
+            scanRef(owner, current, n->_2);
+            break;
+        }
+        case NODOKA_LEX_TERNARY_NODE: {
+            nodoka_ternary_node *n = (nodoka_ternary_node *)node;
+            scanRef(owner, current, n->_1);
+            scanRef(owner, current, n->_2);
+            scanRef(owner, current, n->_3);
+            break;
+        }
+        case NODOKA_LEX_NODE_LIST: {
+            nodoka_node_list *n = (nodoka_node_list *)node;
+            if (n->type == NODOKA_FUNCTION_NODE) {
+                nodoka_scope *inner = declScope(current, n);
+                scanRef(owner, inner, n->_[2]);
+                nodoka_disposeScope(inner);
+                break;
+            }
+            for (size_t i = 0; i < n->length; i++) {
+                scanRef(owner, current, n->_[i]);
+            }
+            break;
+        }
+        default: assert(0);
+    }
+}
+
+/*
+ * Analyze the variables of a function node. Variables which are never
+ * referenced by nested functions live in frame slots of the activation;
+ * captured ones are moved to indexed slots of the environment record.
+ * Parameters always occupy the first frame slots, followed by the function
+ * itself if it is named.
+ */
+nodoka_scope *nodoka_newScope(nodoka_scope *outer, nodoka_node_list *func) {
+    assert(func->base.clazz == NODOKA_LEX_NODE_LIST && func->type == NODOKA_FUNCTION_NODE);
+    nodoka_scope *scope = declScope(outer, func);
+    scanRef(scope, scope, func->_[2]);
+    if (scope->dynamic) {
+        scope->localCount = 0;
+        return scope;
+    }
+    if (scope->hasSelf && scope->self.captured) {
+        scope->self.slot = scope->slotCount++;
+    }
+    for (size_t i = 0; i < scope->length; i++) {
+        nodoka_variable *var = &scope->vars[i];
+        if (var->captured) {
+            var->slot = scope->slotCount++;
+        } else if (!var->param) {
+            var->local = scope->localCount++;
+        }
+    }
+    return scope;
+}
+
+void nodoka_disposeScope(nodoka_scope *scope) {
+    free(scope->vars);
+    free(scope);
+}
+
+nodoka_binding nodoka_resolveBinding(nodoka_scope *scope, utf16_string_t name) {
+    uint16_t depth = 0;
+    for (nodoka_scope *s = scope; s; s = s->outer) {
+        if (s->dynamic) {
+            break;
+        }
+        nodoka_variable *var = lookup(s, name);
+        if (var) {
+            if (var->captured) {
+                return (nodoka_binding) {
+                    .type = NODOKA_BINDING_UPVAL,
+                     .depth = depth,
+                      .index = var->slot
+                };
+            }
+            assert(s == scope);
+            return (nodoka_binding) {
+                .type = NODOKA_BINDING_LOCAL,
+                 .depth = 0,
+                  .index = var->local
+            };
+        }
+        /* Only scopes with captured variables have their own environment record */
+        if (s->slotCount) {
+            depth++;
+        }
+    }
+    return (nodoka_binding) {
+        .type = NODOKA_BINDING_DYNAMIC
+    };
+}
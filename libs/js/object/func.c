@@ -5,51 +5,94 @@
 
 #include "unicode/hash.h"
 
-enum nodoka_completion nodoka_call(nodoka_context *C, nodoka_object *O, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv) {
+enum nodoka_completion nodoka_call(nodoka_context *C, nodoka_object *O, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
     return O->call(C, O, this, ret, argc, argv);
 }
 
-enum nodoka_completion nodoka_construct(nodoka_context *C, nodoka_object *O, nodoka_data **ret, int argc, nodoka_data **argv) {
+enum nodoka_completion nodoka_construct(nodoka_context *C, nodoka_object *O, nodoka_value *ret, int argc, nodoka_value *argv) {
     return O->construct(C, O, ret, argc, argv);
 }
 
-static enum nodoka_completion function_call(nodoka_context *C, nodoka_object *O, nodoka_data *this, nodoka_data **ret, int argc, nodoka_data **argv) {
+/**
+ * Set up the activation of a function created from code, without running
+ * it. Returns NULL and sets *ret to the exception if the maximum stack depth
+ * is reached.
+ */
+nodoka_context *nodoka_newFunctionContext(nodoka_context *C, nodoka_object *O, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
+    if (C->global->stack->depth >= nodoka_config.stackDepth) {
+        *ret = nodoka_box(nodoka_newRangeError(C->global, nodoka_newStringFromUtf8("Maximum call stack size exceeded")));
+        return NULL;
+    }
     nodoka_object *thisBinding;
     if (true/*!strict*/) {
-        if (this->type == NODOKA_NULL || this->type == NODOKA_UNDEF) {
+        if (this == nodoka_null || this == nodoka_undefined) {
             thisBinding = C->global->global;
-        } else if (this->type != NODOKA_OBJECT) {
+        } else if (!nodoka_isObject(this)) {
             thisBinding = nodoka_toObject(C, this);
         } else {
-            thisBinding = (nodoka_object *)this;
+            thisBinding = nodoka_unbox(this);
         }
     }
     nodoka_code *code = O->code;
+    if (!code->dynamicScope) {
+        /* Functions without captured variables need no environment record at all */
+        nodoka_envRec *rec = code->slotCount ? nodoka_newSlotEnvRecord(O->scope, code->slotCount) : O->scope;
+        /* Parameters are the first frame slots, so the arguments are used as they are */
+        nodoka_context *context = nodoka_pushContext(C->global, rec, code, thisBinding, argc, argv);
+        size_t paramCount = code->formalParameters.length;
+        for (size_t i = argc < paramCount ? argc : paramCount; i < code->localCount; i++) {
+            context->locals[i] = nodoka_undefined;
+        }
+        if (code->name && code->name->value.len) {
+            context->locals[paramCount] = nodoka_box(O);
+        }
+        return context;
+    }
     nodoka_envRec *rec = nodoka_newDeclEnvRecord(O->scope);
     nodoka_context *context = nodoka_newContext(C->global, rec, code, thisBinding);
     for (int i = 0; i < code->formalParameters.length; i++) {
         nodoka_setMutableBinding(rec, code->formalParameters.array[i], i >= argc ? nodoka_undefined : argv[i]);
     }
     if (code->name && code->name->value.len) {
-        nodoka_setMutableBinding(rec, code->name, (nodoka_data *)O);
+        nodoka_setMutableBinding(rec, code->name, nodoka_box(O));
     }
     /* FunctionDeclaration */
     /* Argument object */
     /* Variable list */
-    enum nodoka_completion comp = nodoka_exec(context, ret);
-    return comp;
+    return context;
 }
 
-static enum nodoka_completion function_construct(nodoka_context *C, nodoka_object *O, nodoka_data **ret, int argc, nodoka_data **argv) {
+/* The interpreter replaces a non-object return value with the constructed object */
+nodoka_context *nodoka_newConstructContext(nodoka_context *C, nodoka_object *O, nodoka_value *ret, int argc, nodoka_value *argv) {
     nodoka_object *obj = nodoka_newObject(C->global);
-    nodoka_data *proto = nodoka_get(O, nodoka_newStringFromUtf8("prototype"));
-    if (proto->type == NODOKA_OBJECT) {
-        obj->prototype = (nodoka_object *)proto;
+    nodoka_value proto = nodoka_get(O, nodoka_newStringFromUtf8("prototype"));
+    if (nodoka_isObject(proto)) {
+        obj->prototype = nodoka_unbox(proto);
     }
-    enum nodoka_completion comp = nodoka_call(C, O, (nodoka_data *)obj, ret, argc, argv);
-    if ((*ret)->type != NODOKA_OBJECT) {
-        *ret = (nodoka_data *)obj;
+    nodoka_context *context = nodoka_newFunctionContext(C, O, nodoka_box(obj), ret, argc, argv);
+    if (context) {
+        context->constructed = obj;
     }
+    return context;
+}
+
+static enum nodoka_completion function_call(nodoka_context *C, nodoka_object *O, nodoka_value this, nodoka_value *ret, int argc, nodoka_value *argv) {
+    nodoka_context *context = nodoka_newFunctionContext(C, O, this, ret, argc, argv);
+    if (!context) {
+        return NODOKA_COMPLETION_THROW;
+    }
+    enum nodoka_completion comp = nodoka_exec(context, ret);
+    nodoka_disposeContext(context);
+    return comp;
+}
+
+static enum nodoka_completion function_construct(nodoka_context *C, nodoka_object *O, nodoka_value *ret, int argc, nodoka_value *argv) {
+    nodoka_context *context = nodoka_newConstructContext(C, O, ret, argc, argv);
+    if (!context) {
+        return NODOKA_COMPLETION_THROW;
+    }
+    enum nodoka_completion comp = nodoka_exec(context, ret);
+    nodoka_disposeContext(context);
     return comp;
 }
 
@@ -61,8 +104,8 @@ nodoka_object *nodoka_newFunction(nodoka_context *context, nodoka_code *code) {
     F->scope = context->env;
     F->code = code;
     nodoka_object *proto = nodoka_newObject(context->global);
-    nodoka_global_defineValue(proto, "constructor", (nodoka_data *)F, true, false, true);
-    nodoka_global_defineValue(F, "prototype", (nodoka_data *)proto, true, false, false);
+    nodoka_global_defineValue(proto, "constructor", nodoka_box(F), true, false, true);
+    nodoka_global_defineValue(F, "prototype", nodoka_box(proto), true, false, false);
     /* strict blah */
     return F;
 }
\ No newline at end of file
@@ -1,36 +1,417 @@
 #include "c/assert.h"
+#include "c/stdlib.h"
+#include "c/string.h"
 
 #include "js/object.h"
-#include "unicode/hash.h"
+
+#include "data-struct/slab.h"
 
 int nodoka_compareString(void *a, void *b) {
     nodoka_string *x = a;
     nodoka_string *y = b;
-    return unicode_utf16Cmp(&x->value, &y->value);
+    if (x == y) {
+        return 0;
+    }
+    /* Distinct atoms never have the same contents */
+    if (x->atom && y->atom) {
+        return 1;
+    }
+    return nodoka_compareContents(x, y);
 }
 
+/* Hash of an atom, or of a string being interned */
 int nodoka_hashString(void *a) {
     nodoka_string *x = a;
-    return unicode_utf16Hash(&x->value);
+    return x->hash;
+}
+
+/* Changed whenever a cached property lookup could become stale, see nodoka_ic */
+size_t nodoka_propertyEpoch = 0;
+
+/* Property kept in the object itself, whatever its getOwnProperty does */
+nodoka_property *nodoka_findOwnProperty(nodoka_object *O, nodoka_string *P) {
+    assert(P->atom);
+    if (!O->shape) {
+        return hashmap_get(O->prop, P);
+    }
+    int32_t slot = nodoka_lookupShape(O->shape, P);
+    return slot < 0 ? NULL : &O->slots[slot];
+}
+
+/* Names which are the canonical form of an integer below 2^32 - 1 (ES5 15.4) */
+bool nodoka_isArrayIndex(nodoka_string *P, uint32_t *index) {
+    size_t len = P->value.len;
+    if (!len || len > 10 || (nodoka_charAt(P, 0) == '0' && len != 1)) {
+        return false;
+    }
+    uint64_t value = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint16_t c = nodoka_charAt(P, i);
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        value = value * 10 + (c - '0');
+    }
+    if (value >= UINT32_MAX) {
+        return false;
+    }
+    *index = value;
+    return true;
+}
+
+static bool isDense(nodoka_object *O) {
+    return O->elementsKind == NODOKA_ELEMENTS_PACKED || O->elementsKind == NODOKA_ELEMENTS_HOLEY;
+}
+
+static bool getOwnProperty(nodoka_object *O, nodoka_string *P, nodoka_property *prop) {
+    /* The length and the dense elements of arrays are not kept as properties */
+    if (O->elementsKind != NODOKA_ELEMENTS_NONE) {
+        if (P == nodoka_lengthStr) {
+            prop->value = nodoka_fromNumber(O->length);
+            prop->attributes = NODOKA_WRITABLE;
+            return true;
+        }
+        uint32_t index;
+        if (isDense(O) && nodoka_isArrayIndex(P, &index)) {
+            prop->value = nodoka_getElement(O, index);
+            prop->attributes = NODOKA_DEFAULT_ATTRIBUTES;
+            return !!prop->value;
+        }
+    }
+    nodoka_property *own = nodoka_findOwnProperty(O, P);
+    if (!own) {
+        return false;
+    }
+    *prop = *own;
+    return true;
 }
 
-static nodoka_prop_desc *getOwnProperty(nodoka_object *O, nodoka_string *P) {
-    nodoka_prop_desc *desc = hashmap_get(O->prop, P);
-    if (!desc) {
-        return NULL;
+/* [[GetProperty]], without making a descriptor */
+static bool lookupProperty(nodoka_object *O, nodoka_string *P, nodoka_property *prop) {
+    for (; O; O = O->prototype) {
+        if (O->getOwnProperty(O, P, prop)) {
+            return true;
+        }
     }
-    return desc;
+    return false;
+}
+
+static nodoka_property *allocSlots(nodoka_object *O, size_t count) {
+    size_t size = count * sizeof(nodoka_property);
+    return O->region ? region_alloc(O->region, size) : malloc(size);
+}
+
+static void freeSlots(nodoka_object *O) {
+    if (O->slots != O->inlineSlots && !O->region) {
+        free(O->slots);
+    }
+}
+
+/* Properties of dictionary mode objects are allocated one by one */
+static nodoka_property *allocProperty(nodoka_object *O) {
+    return O->region ? region_alloc(O->region, sizeof(nodoka_property)) : slab_alloc(sizeof(nodoka_property));
+}
+
+static void freeProperty(nodoka_object *O, nodoka_property *prop) {
+    if (!O->region) {
+        slab_free(prop, sizeof(nodoka_property));
+    }
+}
+
+static void setShape(nodoka_object *O, nodoka_shape *shape) {
+    nodoka_writeBarrier(nodoka_box(O->shape));
+    O->shape = shape;
+}
+
+/* Move the properties to a table, for objects which have too many or lost some */
+static void toDictionary(nodoka_object *O) {
+    uint32_t count = O->shape->count;
+    O->prop = hashmap_new_region(nodoka_hashString, nodoka_compareString, count + 1, O->region);
+    /* The shape chain runs from the newest name, but the table keeps the order they are put in */
+    nodoka_string **names = malloc(count * sizeof(nodoka_string *));
+    for (nodoka_shape *shape = O->shape; shape->name; shape = shape->parent) {
+        names[shape->count - 1] = shape->name;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        nodoka_property *prop = allocProperty(O);
+        *prop = O->slots[i];
+        hashmap_put(O->prop, names[i], prop);
+    }
+    free(names);
+    freeSlots(O);
+    O->slots = NULL;
+    O->capacity = 0;
+    setShape(O, NULL);
+    /* Cached lookups point into the slots */
+    nodoka_propertyEpoch++;
+}
+
+static void addOwnProperty(nodoka_object *O, nodoka_string *P, nodoka_value value, uint32_t attributes) {
+    if (O->shape && O->shape->count == NODOKA_MAX_SHAPE_PROPERTIES) {
+        toDictionary(O);
+    }
+    if (!O->shape) {
+        nodoka_property *prop = allocProperty(O);
+        prop->value = value;
+        prop->attributes = attributes;
+        hashmap_put(O->prop, P, prop);
+        return;
+    }
+    uint32_t count = O->shape->count;
+    if (count == O->capacity) {
+        nodoka_property *slots = allocSlots(O, O->capacity * 2);
+        memcpy(slots, O->slots, count * sizeof(nodoka_property));
+        freeSlots(O);
+        O->slots = slots;
+        O->capacity *= 2;
+    }
+    /* The shape is looked up first, as the slot is not traced until it is set */
+    nodoka_shape *shape = nodoka_addToShape(O->shape, P);
+    O->slots[count].value = value;
+    O->slots[count].attributes = attributes;
+    setShape(O, shape);
+}
+
+static size_t elementSize(enum nodoka_elements_type type) {
+    switch (type) {
+        case NODOKA_ELEMENTS_INT32: return sizeof(int32_t);
+        case NODOKA_ELEMENTS_DOUBLE: return sizeof(double);
+        default: return sizeof(nodoka_value);
+    }
+}
+
+static enum nodoka_elements_type elementType(nodoka_value value) {
+    if (nodoka_isInt32(value)) {
+        return NODOKA_ELEMENTS_INT32;
+    }
+    return nodoka_isNumber(value) ? NODOKA_ELEMENTS_DOUBLE : NODOKA_ELEMENTS_VALUE;
+}
+
+static void *allocElements(nodoka_object *O, enum nodoka_elements_type type, uint32_t capacity) {
+    size_t size = capacity * elementSize(type);
+    if (O->region) {
+        return region_alloc(O->region, size);
+    }
+    nodoka_gcAllocated += size;
+    return malloc(size);
+}
+
+static void freeElements(nodoka_object *O) {
+    if (!O->region) {
+        free(O->elements.values);
+    }
+}
+
+/* Fill storage which holds nothing yet with holes */
+static void fillHoles(nodoka_object *O, uint32_t start, uint32_t end) {
+    switch (O->elementsType) {
+        case NODOKA_ELEMENTS_INT32:
+            /* Only the length tells which int32 elements there are */
+            break;
+        case NODOKA_ELEMENTS_DOUBLE:
+            for (uint32_t i = start; i < end; i++) {
+                O->elements.doubles[i] = int2double(NODOKA_HOLE_BITS);
+            }
+            break;
+        default:
+            /* nodoka_empty is all zeroes */
+            memset(O->elements.values + start, 0, (end - start) * sizeof(nodoka_value));
+            break;
+    }
+}
+
+/* Remove the elements from start to end */
+static void clearElements(nodoka_object *O, uint32_t start, uint32_t end) {
+    if (O->elementsType == NODOKA_ELEMENTS_VALUE) {
+        for (uint32_t i = start; i < end; i++) {
+            nodoka_writeBarrier(O->elements.values[i]);
+        }
+    }
+    fillHoles(O, start, end);
+}
+
+/* Move the elements to a more general representation */
+static void convertElements(nodoka_object *O, enum nodoka_elements_type type) {
+    assert(type > O->elementsType);
+    uint32_t capacity = O->elementsCapacity;
+    void *elements = allocElements(O, type, capacity);
+    for (uint32_t i = 0; i < capacity; i++) {
+        nodoka_value value = nodoka_getElement(O, i);
+        if (type == NODOKA_ELEMENTS_DOUBLE) {
+            ((double *)elements)[i] = value ? nodoka_getNumber(value) : int2double(NODOKA_HOLE_BITS);
+        } else {
+            ((nodoka_value *)elements)[i] = value;
+        }
+    }
+    freeElements(O);
+    O->elements.values = elements;
+    O->elementsType = type;
+}
+
+static void makeHoley(nodoka_object *O) {
+    if (O->elementsType == NODOKA_ELEMENTS_INT32) {
+        convertElements(O, NODOKA_ELEMENTS_DOUBLE);
+    }
+    O->elementsKind = NODOKA_ELEMENTS_HOLEY;
+}
+
+/* Make room for the element at index, returns false if the array is too sparse for it */
+static bool reserveElements(nodoka_object *O, uint32_t index) {
+    uint32_t old = O->elementsCapacity;
+    if (index < old) {
+        return true;
+    }
+    if (index - old >= old + NODOKA_MAX_ELEMENTS_GAP) {
+        return false;
+    }
+    uint64_t capacity = (uint64_t)old * 2;
+    if (capacity <= index) {
+        capacity = (uint64_t)index + 1;
+    }
+    if (capacity < NODOKA_INLINE_SLOTS * 2) {
+        capacity = NODOKA_INLINE_SLOTS * 2;
+    }
+    if (capacity > UINT32_MAX) {
+        capacity = UINT32_MAX;
+    }
+    size_t size = elementSize(O->elementsType);
+    if (O->region) {
+        void *elements = region_alloc(O->region, capacity * size);
+        memcpy(elements, O->elements.values, old * size);
+        O->elements.values = elements;
+    } else {
+        O->elements.values = realloc(O->elements.values, capacity * size);
+        nodoka_gcAllocated += (capacity - old) * size;
+    }
+    O->elementsCapacity = capacity;
+    fillHoles(O, old, capacity);
+    return true;
+}
+
+/* Store to an element which reserveElements made room for */
+static void setDenseElement(nodoka_object *O, uint32_t index, nodoka_value V) {
+    if (index > O->length) {
+        makeHoley(O);
+    }
+    enum nodoka_elements_type type = elementType(V);
+    if (type > O->elementsType) {
+        convertElements(O, type);
+    }
+    if (index >= O->length) {
+        O->length = index + 1;
+    }
+    switch (O->elementsType) {
+        case NODOKA_ELEMENTS_INT32:
+            O->elements.int32s[index] = nodoka_getInt32(V);
+            break;
+        case NODOKA_ELEMENTS_DOUBLE:
+            O->elements.doubles[index] = nodoka_getNumber(V);
+            break;
+        default:
+            nodoka_writeBarrier(O->elements.values[index]);
+            O->elements.values[index] = V;
+            break;
+    }
+}
+
+/* Move the elements to ordinary properties */
+static void toDictionaryElements(nodoka_object *O) {
+    for (uint32_t i = 0; i < O->elementsCapacity; i++) {
+        nodoka_value value = nodoka_getElement(O, i);
+        if (value) {
+            addOwnProperty(O, nodoka_toAtom(nodoka_num2str(i)), value, NODOKA_DEFAULT_ATTRIBUTES);
+        }
+    }
+    freeElements(O);
+    O->elements.values = NULL;
+    O->elementsCapacity = 0;
+    O->elementsKind = NODOKA_ELEMENTS_DICTIONARY;
+    O->elementsType = NODOKA_ELEMENTS_VALUE;
+}
+
+/*
+ * Remove the dictionary elements from length on, except for the ones which
+ * cannot be deleted, returning the length which is left
+ */
+static uint32_t truncateDictionaryElements(nodoka_object *O, uint32_t length) {
+    if (O->shape) {
+        toDictionary(O);
+    }
+    for (pair_t *it = hashmap_iterator(O->prop); (it = hashmap_next(it));) {
+        uint32_t index;
+        if (nodoka_isArrayIndex(it->first, &index) && index >= length) {
+            nodoka_property *prop = it->second;
+            if (!(prop->attributes & NODOKA_CONFIGURABLE)) {
+                length = index + 1;
+            }
+        }
+    }
+    for (pair_t *it = hashmap_iterator(O->prop); (it = hashmap_next(it));) {
+        uint32_t index;
+        if (nodoka_isArrayIndex(it->first, &index) && index >= length) {
+            nodoka_delete(O, it->first, false);
+        }
+    }
+    return length;
+}
+
+/* Returns false if elements which cannot be deleted kept the array longer */
+bool nodoka_setArrayLength(nodoka_object *O, uint32_t length) {
+    assert(O->elementsKind != NODOKA_ELEMENTS_NONE);
+    bool success = true;
+    if (length < O->length) {
+        if (isDense(O)) {
+            uint32_t end = O->length < O->elementsCapacity ? O->length : O->elementsCapacity;
+            clearElements(O, length, end);
+        } else {
+            uint32_t left = truncateDictionaryElements(O, length);
+            success = left == length;
+            length = left;
+        }
+    } else if (length > O->length && O->elementsKind == NODOKA_ELEMENTS_PACKED) {
+        makeHoley(O);
+    }
+    O->length = length;
+    return success;
+}
+
+/*
+ * [[Put]] with an array index, which needs no name for dense arrays. Their
+ * prototypes are not looked at, as nothing can make an element read-only.
+ * Returns false like nodoka_put.
+ */
+bool nodoka_putElement(nodoka_object *O, uint32_t index, nodoka_value V) {
+    if (nodoka_escapesRegion(O, V)) {
+        return false;
+    }
+    if (nodoka_replaceElement(O, index, V)) {
+        return true;
+    }
+    if (isDense(O) && O->extensible && reserveElements(O, index)) {
+        setDenseElement(O, index, V);
+        return true;
+    }
+    return nodoka_put(O, nodoka_toAtom(nodoka_num2str(index)), V, false);
 }
 
 nodoka_object *nodoka_newNativeObject(void) {
     nodoka_object *obj = (nodoka_object *)nodoka_new_data(NODOKA_OBJECT);
-    obj->prop = hashmap_new(nodoka_hashString, nodoka_compareString, 11);
+    obj->shape = nodoka_emptyShape;
+    obj->slots = obj->inlineSlots;
+    obj->capacity = NODOKA_INLINE_SLOTS;
+    obj->prop = NULL;
+    obj->region = nodoka_regionMemory();
+    obj->elementsKind = NODOKA_ELEMENTS_NONE;
+    obj->elementsType = NODOKA_ELEMENTS_VALUE;
+    obj->length = 0;
+    obj->elementsCapacity = 0;
+    obj->elements.values = NULL;
     obj->prototype = NULL;
     obj->_class = NULL;
     obj->extensible = true;
     obj->getOwnProperty = getOwnProperty;
 
-    obj->primitiveValue = NULL;
+    obj->primitiveValue = nodoka_empty;
     obj->construct = NULL;
     obj->call = NULL;
     // bool HasInstance(any)
@@ -39,7 +420,7 @@ nodoka_object *nodoka_newNativeObject(void) {
     obj->formalParameters.array = NULL;
     obj->code = NULL;
     obj->targetFunction = NULL;
-    obj->boundThis = NULL;
+    obj->boundThis = nodoka_empty;
     obj->boundArguments.length = 0;
     obj->boundArguments.array = NULL;
     obj->codeString = NULL;
@@ -47,27 +428,50 @@ nodoka_object *nodoka_newNativeObject(void) {
 }
 
 nodoka_prop_desc *nodoka_getOwnProperty(nodoka_object *O, nodoka_string *P) {
-    return O->getOwnProperty(O, P);
+    nodoka_property prop;
+    return O->getOwnProperty(O, P, &prop) ? nodoka_newDescFromProperty(&prop) : NULL;
 }
 
 nodoka_prop_desc *nodoka_getProperty(nodoka_object *O, nodoka_string *P) {
-    nodoka_prop_desc *prop = nodoka_getOwnProperty(O, P);
-    if (prop) {
-        return prop;
-    }
-    if (!O->prototype) {
-        return NULL;
+    nodoka_property prop;
+    return lookupProperty(O, P, &prop) ? nodoka_newDescFromProperty(&prop) : NULL;
+}
+
+/*
+ * Resolve P to a data property kept in the slots of the object it is found
+ * on, when every object on the way keeps its own properties itself, so that
+ * the holder and the slot can be cached. Otherwise return NULL, and the
+ * lookup has to go through nodoka_get.
+ */
+nodoka_property *nodoka_getCacheableProperty(nodoka_object *O, nodoka_string *P, nodoka_object **holder) {
+    for (; O; O = O->prototype) {
+        if (O->getOwnProperty != getOwnProperty) {
+            return NULL;
+        }
+        /* The length and the elements of arrays are not kept as properties */
+        uint32_t index;
+        if (O->elementsKind != NODOKA_ELEMENTS_NONE && (P == nodoka_lengthStr || nodoka_isArrayIndex(P, &index))) {
+            return NULL;
+        }
+        nodoka_property *prop = nodoka_findOwnProperty(O, P);
+        if (prop) {
+            if (!O->shape || (prop->attributes & NODOKA_ACCESSOR)) {
+                return NULL;
+            }
+            *holder = O;
+            return prop;
+        }
     }
-    return nodoka_getProperty(O->prototype, P);
+    return NULL;
 }
 
-nodoka_data *nodoka_get(nodoka_object *O, nodoka_string *P) {
-    nodoka_prop_desc *desc = nodoka_getProperty(O, P);
-    if (!desc) {
+nodoka_value nodoka_get(nodoka_object *O, nodoka_string *P) {
+    nodoka_property prop;
+    if (!lookupProperty(O, P, &prop)) {
         return nodoka_undefined;
     }
-    if (nodoka_isDataDescriptor(desc)) {
-        return desc->value;
+    if (!(prop.attributes & NODOKA_ACCESSOR)) {
+        return prop.value;
     } else {
         // If getter is undefined, return undefined.
         // Return the result calling the [[Call]] internal method of getter providing O as the this value and providing no
@@ -77,71 +481,115 @@ nodoka_data *nodoka_get(nodoka_object *O, nodoka_string *P) {
 }
 
 bool nodoka_canPut(nodoka_object *O, nodoka_string *P) {
-    nodoka_prop_desc *desc = nodoka_getOwnProperty(O, P);
-    if (desc) {
-        if (nodoka_isAccessorDescriptor(desc)) {
-            return !!desc->set;
+    nodoka_property prop;
+    if (O->getOwnProperty(O, P, &prop)) {
+        if (prop.attributes & NODOKA_ACCESSOR) {
+            return ((nodoka_prop_desc *)nodoka_unbox(prop.value))->set != nodoka_undefined;
         } else {
-            return desc->writable == nodoka_true;
+            return !!(prop.attributes & NODOKA_WRITABLE);
         }
     }
-    if (!O->prototype) {
+    if (!O->prototype || !lookupProperty(O->prototype, P, &prop)) {
         return O->extensible;
     }
-    nodoka_prop_desc *inherited = nodoka_getProperty(O->prototype, P);
-    if (!inherited) {
-        return O->extensible;
-    }
-    if (nodoka_isAccessorDescriptor(desc)) {
-        return !!desc->set;
+    if (prop.attributes & NODOKA_ACCESSOR) {
+        return ((nodoka_prop_desc *)nodoka_unbox(prop.value))->set != nodoka_undefined;
     } else {
-        if (!O->extensible) {
-            return false;
-        } else {
-            return inherited->writable == nodoka_true;
-        }
+        return O->extensible && (prop.attributes & NODOKA_WRITABLE);
     }
 }
 
-void nodoka_put(nodoka_object *O, nodoka_string *P, nodoka_data *V, bool throw) {
-    if (!nodoka_canPut(O, P)) {
-        if (throw) {
-            assert(!"TypeError");
-        } else {
-            return;
-        }
+/*
+ * [[Put]] looks the property up once. Own data properties kept in the object
+ * are written in place, and new ones are added directly, so that no
+ * descriptor is made unless the property is made up by getOwnProperty.
+ * Returns false, storing nothing, if V is data of the current region which
+ * O must not refer to, for the caller to throw a TypeError.
+ */
+bool nodoka_put(nodoka_object *O, nodoka_string *P, nodoka_value V, bool throw) {
+    if (nodoka_escapesRegion(O, V)) {
+        return false;
     }
-    nodoka_prop_desc *ownDesc = nodoka_getOwnProperty(O, P);
-    if (nodoka_isDataDescriptor(ownDesc)) {
+    nodoka_property *own = nodoka_findOwnProperty(O, P);
+    nodoka_property prop = {nodoka_empty, NODOKA_WRITABLE};
+    bool inherited = false;
+    if (own) {
+        prop = *own;
+    } else if (O->getOwnProperty(O, P, &prop)) {
+        /* Made up by getOwnProperty, as the length and the elements of arrays */
+        if (!(prop.attributes & NODOKA_WRITABLE)) {
+            if (throw) {
+                assert(!"TypeError");
+            }
+            return true;
+        }
         nodoka_prop_desc *valueDesc = nodoka_newPropertyDesc();
         valueDesc->value = V;
         nodoka_defineOwnProperty(O, P, valueDesc, throw);
-        return;
+        return true;
+    } else if (O->prototype) {
+        inherited = lookupProperty(O->prototype, P, &prop);
     }
-    nodoka_prop_desc *desc = nodoka_getProperty(O, P);
-    if (nodoka_isAccessorDescriptor(desc)) {
+    if (prop.attributes & NODOKA_ACCESSOR) {
         assert(0);
-    } else {
+    }
+    if (!(prop.attributes & NODOKA_WRITABLE) || (!own && !O->extensible)) {
+        if (throw) {
+            assert(!"TypeError");
+        }
+        return true;
+    }
+    if (own) {
+        nodoka_writeBarrier(own->value);
+        own->value = V;
+        return true;
+    }
+    if (O->elementsKind != NODOKA_ELEMENTS_NONE) {
+        /* Array index names may have to update the length */
         nodoka_prop_desc *newDesc = nodoka_newPropertyDesc();
         newDesc->value = V;
         newDesc->writable = nodoka_true;
         newDesc->enumerable = nodoka_true;
         newDesc->configurable = nodoka_true;
         nodoka_defineOwnProperty(O, P, newDesc, throw);
+        return true;
     }
+    /* Lookups which went past O would now find it */
+    if (inherited) {
+        nodoka_propertyEpoch++;
+    }
+    addOwnProperty(O, P, V, NODOKA_DEFAULT_ATTRIBUTES);
+    return true;
 }
 
 bool nodoka_hasProperty(nodoka_object *O, nodoka_string *P) {
-    return !!nodoka_getProperty(O, P);
+    nodoka_property prop;
+    return lookupProperty(O, P, &prop);
 }
 
 bool nodoka_delete(nodoka_object *O, nodoka_string *P, bool throw) {
-    nodoka_prop_desc *desc = nodoka_getOwnProperty(O, P);
-    if (!desc) {
+    uint32_t index;
+    if (isDense(O) && nodoka_isArrayIndex(P, &index)) {
+        if (nodoka_getElement(O, index)) {
+            makeHoley(O);
+            clearElements(O, index, index + 1);
+        }
         return true;
     }
-    if (desc->configurable == nodoka_true) {
-        hashmap_remove(O->prop, P);
+    nodoka_property prop;
+    if (!O->getOwnProperty(O, P, &prop)) {
+        return true;
+    }
+    /* Properties made up by getOwnProperty are never configurable */
+    if (prop.attributes & NODOKA_CONFIGURABLE) {
+        if (O->shape) {
+            toDictionary(O);
+        }
+        nodoka_writeBarrier(nodoka_box(P));
+        nodoka_property *removed = hashmap_remove(O->prop, P);
+        nodoka_writeBarrier(removed->value);
+        freeProperty(O, removed);
+        nodoka_propertyEpoch++;
         return true;
     }
     if (throw) {
@@ -150,13 +598,13 @@ bool nodoka_delete(nodoka_object *O, nodoka_string *P, bool throw) {
     return false;
 }
 
-nodoka_data *nodoka_defaultValue(nodoka_context *C, nodoka_object *O, enum nodoka_data_type hint) {
+nodoka_value nodoka_defaultValue(nodoka_context *C, nodoka_object *O, enum nodoka_data_type hint) {
     if (hint == NODOKA_STRING) {
-        nodoka_object *toString = (nodoka_object *)nodoka_get(O, nodoka_newStringFromUtf8("toString"));
-        if (toString->base.type == NODOKA_OBJECT && toString->call) {
-            nodoka_data *ret;
-            nodoka_call(C, toString, (nodoka_data *)O, &ret, 0, NULL);
-            if (ret->type != NODOKA_OBJECT) {
+        nodoka_value toString = nodoka_get(O, nodoka_newStringFromUtf8("toString"));
+        if (nodoka_isObject(toString) && ((nodoka_object *)nodoka_unbox(toString))->call) {
+            nodoka_value ret;
+            nodoka_call(C, nodoka_unbox(toString), nodoka_box(O), &ret, 0, NULL);
+            if (!nodoka_isObject(ret)) {
                 return ret;
             }
         }
@@ -166,21 +614,45 @@ nodoka_data *nodoka_defaultValue(nodoka_context *C, nodoka_object *O, enum nodok
     }
 }
 
-bool nodoka_defineOwnProperty(nodoka_object *O, nodoka_string *P, nodoka_prop_desc *desc, bool throw) {
-    nodoka_prop_desc *current = nodoka_getOwnProperty(O, P);
+/* Attributes with the bit set or cleared as a descriptor field says, if it is present */
+static uint32_t updateAttribute(uint32_t attributes, uint32_t bit, nodoka_value value) {
+    if (!value) {
+        return attributes;
+    }
+    return value == nodoka_true ? attributes | bit : attributes & ~bit;
+}
+
+/* Accessor properties keep their getter and setter in a descriptor of their own */
+static nodoka_value newAccessor(nodoka_prop_desc *desc) {
+    nodoka_prop_desc *accessor = nodoka_newPropertyDesc();
+    accessor->get = desc->get ? desc->get : nodoka_undefined;
+    accessor->set = desc->set ? desc->set : nodoka_undefined;
+    return nodoka_box(nodoka_tenure(&accessor->base));
+}
+
+static bool defineOrdinaryProperty(nodoka_object *O, nodoka_string *P, nodoka_prop_desc *desc, bool throw) {
+    nodoka_property *current = nodoka_findOwnProperty(O, P);
     if (!current) {
-        if (O->extensible) {
-            if (nodoka_isGenericDescriptor(desc) || nodoka_isDataDescriptor(desc)) {
-                if (!desc->value)desc->value = nodoka_undefined;
-                if (!desc->writable)desc->writable = nodoka_false;
-                if (!desc->enumerable)desc->enumerable = nodoka_false;
-                if (!desc->configurable)desc->configurable = nodoka_false;
+        nodoka_property prop;
+        /* Properties made up by getOwnProperty cannot be redefined */
+        if (O->extensible && !O->getOwnProperty(O, P, &prop)) {
+            uint32_t attributes = updateAttribute(0, NODOKA_ENUMERABLE, desc->enumerable);
+            attributes = updateAttribute(attributes, NODOKA_CONFIGURABLE, desc->configurable);
+            nodoka_value value;
+            if (nodoka_isAccessorDescriptor(desc)) {
+                value = newAccessor(desc);
+                attributes |= NODOKA_ACCESSOR;
+            } else {
                 assert(!desc->set);
                 assert(!desc->get);
-                hashmap_put(O->prop, P, desc);
-            } else {
-                assert(0);
+                value = desc->value ? desc->value : nodoka_undefined;
+                attributes = updateAttribute(attributes, NODOKA_WRITABLE, desc->writable);
+            }
+            /* Lookups which went past O would now find it */
+            if (O->prototype && lookupProperty(O->prototype, P, &prop)) {
+                nodoka_propertyEpoch++;
             }
+            addOwnProperty(O, P, value, attributes);
             return true;
         } else {
             if (throw) {
@@ -194,8 +666,11 @@ bool nodoka_defineOwnProperty(nodoka_object *O, nodoka_string *P, nodoka_prop_de
     return true;
     }*/
     // SameValue
-    if (current->configurable == nodoka_false) {
-        if (desc->configurable == nodoka_true || (desc->enumerable && desc->enumerable != current->enumerable)) {
+    bool configurable = current->attributes & NODOKA_CONFIGURABLE;
+    bool isAccessor = current->attributes & NODOKA_ACCESSOR;
+    if (!configurable) {
+        if (desc->configurable == nodoka_true
+                || (desc->enumerable && desc->enumerable != nodoka_fromBool(current->attributes & NODOKA_ENUMERABLE))) {
             if (throw) {
                 assert(!"TypeError");
             } else {
@@ -205,35 +680,33 @@ bool nodoka_defineOwnProperty(nodoka_object *O, nodoka_string *P, nodoka_prop_de
     }
     if (nodoka_isGenericDescriptor(desc)) {
 
-    } else if (nodoka_isDataDescriptor(current) != nodoka_isDataDescriptor(desc)) {
-        if (current->configurable == nodoka_false) {
+    } else if (isAccessor != nodoka_isAccessorDescriptor(desc)) {
+        if (!configurable) {
             if (throw) {
                 assert(!"TypeError");
             } else {
                 return false;
             }
         }
-        if (nodoka_isDataDescriptor(current)) {
-            desc->set = nodoka_undefined;
-            desc->get = nodoka_undefined;
-            desc->value = NULL;
-            desc->writable = NULL;
-            hashmap_put(O->prop, P, desc);
+        /* Only the enumerable and configurable attributes are kept */
+        nodoka_writeBarrier(current->value);
+        if (isAccessor) {
+            current->value = nodoka_undefined;
+            current->attributes &= NODOKA_ENUMERABLE | NODOKA_CONFIGURABLE;
         } else {
-            desc->set = NULL;
-            desc->get = NULL;
-            desc->value = nodoka_undefined;
-            desc->writable = nodoka_false;
+            current->value = newAccessor(desc);
+            current->attributes = (current->attributes & (NODOKA_ENUMERABLE | NODOKA_CONFIGURABLE)) | NODOKA_ACCESSOR;
         }
     } else if (nodoka_isDataDescriptor(desc)) {
-        if (current->configurable == nodoka_false) {
-            if (current->writable == nodoka_false && desc->writable == nodoka_true) {
+        if (!configurable) {
+            bool writable = current->attributes & NODOKA_WRITABLE;
+            if (!writable && desc->writable == nodoka_true) {
                 if (throw) {
                     assert(!"TypeError");
                 } else {
                     return false;
                 }
-            } else if (current->writable == nodoka_false) {
+            } else if (!writable) {
                 if (desc->value && true/*SameValue for Value*/) {
                     if (throw) {
                         assert(!"TypeError");
@@ -244,7 +717,7 @@ bool nodoka_defineOwnProperty(nodoka_object *O, nodoka_string *P, nodoka_prop_de
             }
         }
     } else {
-        if (current->configurable == nodoka_false) {
+        if (!configurable) {
             if (true/*SameValue for Set */) {
                 if (throw) {
                     assert(!"TypeError");
@@ -261,12 +734,111 @@ bool nodoka_defineOwnProperty(nodoka_object *O, nodoka_string *P, nodoka_prop_de
             }
         }
     }
-    if (desc->set)current->set = desc->set;
-    if (desc->get)current->get = desc->get;
-    if (desc->value)current->value = desc->value;
-    if (desc->writable)current->writable = desc->writable;
-    if (desc->configurable)current->configurable = desc->configurable;
-    if (desc->enumerable)current->enumerable = desc->enumerable;
+    /* Only plain value updates keep cached lookups valid */
+    if (desc->set || desc->get || desc->writable) {
+        nodoka_propertyEpoch++;
+    }
+    if (current->attributes & NODOKA_ACCESSOR) {
+        nodoka_prop_desc *accessor = nodoka_unbox(current->value);
+        if (desc->set) {
+            nodoka_writeBarrier(accessor->set);
+            accessor->set = desc->set;
+        }
+        if (desc->get) {
+            nodoka_writeBarrier(accessor->get);
+            accessor->get = desc->get;
+        }
+    } else {
+        if (desc->value) {
+            nodoka_writeBarrier(current->value);
+            current->value = desc->value;
+        }
+        current->attributes = updateAttribute(current->attributes, NODOKA_WRITABLE, desc->writable);
+    }
+    current->attributes = updateAttribute(current->attributes, NODOKA_CONFIGURABLE, desc->configurable);
+    current->attributes = updateAttribute(current->attributes, NODOKA_ENUMERABLE, desc->enumerable);
+    return true;
+}
+
+
+/* Whether desc leaves the element (current being nodoka_empty if there is none) plain data */
+static bool isPlainElement(nodoka_prop_desc *desc, nodoka_value current) {
+    if (desc->get || desc->set) {
+        return false;
+    }
+    nodoka_value attributes[] = {desc->writable, desc->enumerable, desc->configurable};
+    for (size_t i = 0; i < sizeof(attributes) / sizeof(attributes[0]); i++) {
+        if (attributes[i] != nodoka_true && (!current || attributes[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* [[DefineOwnProperty]] of arrays (ES5 15.4.5.1) */
+static bool defineArrayProperty(nodoka_object *O, nodoka_string *P, nodoka_prop_desc *desc, bool throw) {
+    if (P == nodoka_lengthStr) {
+        /* Only the value of the length can be changed */
+        if (desc->get || desc->set || desc->writable == nodoka_false
+                || desc->enumerable == nodoka_true || desc->configurable == nodoka_true) {
+            if (throw) {
+                assert(!"TypeError");
+            }
+            return false;
+        }
+        if (!desc->value) {
+            return true;
+        }
+        double num = nodoka_toNumber(desc->value);
+        uint32_t length = nodoka_toUint32(num);
+        if (length != num) {
+            if (throw) {
+                assert(!"RangeError");
+            }
+            return false;
+        }
+        if (!nodoka_setArrayLength(O, length)) {
+            if (throw) {
+                assert(!"TypeError");
+            }
+            return false;
+        }
+        return true;
+    }
+    uint32_t index;
+    if (!nodoka_isArrayIndex(P, &index)) {
+        return defineOrdinaryProperty(O, P, desc, throw);
+    }
+    if (isDense(O)) {
+        nodoka_value current = nodoka_getElement(O, index);
+        if (!current && !O->extensible) {
+            if (throw) {
+                assert(!"TypeError");
+            }
+            return false;
+        }
+        if (isPlainElement(desc, current) && reserveElements(O, index)) {
+            setDenseElement(O, index, desc->value ? desc->value : current ? current : nodoka_undefined);
+            return true;
+        }
+        toDictionaryElements(O);
+    }
+    if (!defineOrdinaryProperty(O, P, desc, throw)) {
+        return false;
+    }
+    if (index >= O->length) {
+        O->length = index + 1;
+    }
     return true;
 }
 
+/* Also returns false, whatever throw is, for data of the current region which O must not refer to */
+bool nodoka_defineOwnProperty(nodoka_object *O, nodoka_string *P, nodoka_prop_desc *desc, bool throw) {
+    if (nodoka_escapesRegion(O, desc->value) || nodoka_escapesRegion(O, desc->get) || nodoka_escapesRegion(O, desc->set)) {
+        return false;
+    }
+    if (O->elementsKind != NODOKA_ELEMENTS_NONE) {
+        return defineArrayProperty(O, P, desc, throw);
+    }
+    return defineOrdinaryProperty(O, P, desc, throw);
+}
@@ -15,4 +15,18 @@ bool nodoka_isGenericDescriptor(nodoka_prop_desc *desc) {
     return !nodoka_isDataDescriptor(desc) && !nodoka_isAccessorDescriptor(desc);
 }
 
-
+/* Descriptor of a property, for the APIs which deal in descriptors */
+nodoka_prop_desc *nodoka_newDescFromProperty(nodoka_property *prop) {
+    nodoka_prop_desc *desc = nodoka_newPropertyDesc();
+    if (prop->attributes & NODOKA_ACCESSOR) {
+        nodoka_prop_desc *accessor = nodoka_unbox(prop->value);
+        desc->get = accessor->get;
+        desc->set = accessor->set;
+    } else {
+        desc->value = prop->value;
+        desc->writable = nodoka_fromBool(prop->attributes & NODOKA_WRITABLE);
+    }
+    desc->enumerable = nodoka_fromBool(prop->attributes & NODOKA_ENUMERABLE);
+    desc->configurable = nodoka_fromBool(prop->attributes & NODOKA_CONFIGURABLE);
+    return desc;
+}
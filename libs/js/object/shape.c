@@ -0,0 +1,89 @@
+#include "c/assert.h"
+#include "c/stdlib.h"
+
+#include "js/object.h"
+
+#include "data-struct/hashmap.h"
+
+enum {
+    /* Shapes with more properties than this are looked up in a table */
+    MAX_WALK = 8,
+    DEF_TRANSITION_SIZE = 7,
+    DEF_TABLE_SIZE = 31,
+};
+
+nodoka_shape *nodoka_emptyShape;
+
+static nodoka_shape *newShape(nodoka_shape *parent, nodoka_string *name) {
+    nodoka_shape *shape = (nodoka_shape *)nodoka_new_data(NODOKA_SHAPE);
+    shape->parent = parent;
+    shape->name = name;
+    shape->count = parent ? parent->count + 1 : 0;
+    shape->transitions = NULL;
+    shape->table = NULL;
+    return shape;
+}
+
+void nodoka_initShapes(void) {
+    nodoka_emptyShape = newShape(NULL, NULL);
+}
+
+/* Shape of an object of the given shape once name is added to it */
+nodoka_shape *nodoka_addToShape(nodoka_shape *shape, nodoka_string *name) {
+    if (!shape->transitions) {
+        shape->transitions = hashmap_new_pointer(DEF_TRANSITION_SIZE);
+    }
+    nodoka_shape *child = hashmap_get(shape->transitions, name);
+    if (child) {
+        /* The table holds it weakly, so it may not have been marked yet */
+        if (nodoka_gcMarking) {
+            nodoka_shade(child);
+        }
+        return child;
+    }
+    child = newShape(shape, name);
+    hashmap_put(shape->transitions, name, child);
+    return child;
+}
+
+/* Slot of the property, or -1. Names are interned, so they are compared by identity */
+int32_t nodoka_lookupShape(nodoka_shape *shape, nodoka_string *name) {
+    if (shape->count <= MAX_WALK) {
+        for (; shape->name; shape = shape->parent) {
+            if (shape->name == name) {
+                return shape->count - 1;
+            }
+        }
+        return -1;
+    }
+    if (!shape->table) {
+        shape->table = hashmap_new_pointer(DEF_TABLE_SIZE);
+        for (nodoka_shape *s = shape; s->name; s = s->parent) {
+            hashmap_put(shape->table, s->name, (void *)(uintptr_t)s->count);
+        }
+    }
+    return (int32_t)(uintptr_t)hashmap_get(shape->table, name) - 1;
+}
+
+static void sweepShape(nodoka_shape *shape) {
+    if (!shape->transitions) {
+        return;
+    }
+    for (pair_t *it = hashmap_iterator(shape->transitions); (it = hashmap_next(it));) {
+        nodoka_shape *child = it->second;
+        if (child->base.marked) {
+            sweepShape(child);
+        } else {
+            hashmap_remove(shape->transitions, it->first);
+        }
+    }
+}
+
+/*
+ * Drop the transitions to shapes which are not marked, once marking is
+ * complete and before they are swept. A shape keeps its parent alive, so
+ * the live shapes are all found from nodoka_emptyShape.
+ */
+void nodoka_sweepTransitions(void) {
+    sweepShape(nodoka_emptyShape);
+}
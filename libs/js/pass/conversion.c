@@ -96,6 +96,15 @@ bool nodoka_convPass(nodoka_code_emitter *emitter, nodoka_code_emitter *target,
                 PUSH(sp0);
                 break;
             }
+            case NODOKA_BC_DUP2: {
+                enum nodoka_data_type sp0 = POP();
+                enum nodoka_data_type sp1 = POP();
+                PUSH(sp1);
+                PUSH(sp0);
+                PUSH(sp1);
+                PUSH(sp0);
+                break;
+            }
             case NODOKA_BC_POP: POP(); break;
             case NODOKA_BC_XCHG: {
                 enum nodoka_data_type sp0 = POP();
@@ -113,6 +122,17 @@ bool nodoka_convPass(nodoka_code_emitter *emitter, nodoka_code_emitter *target,
                 PUSH(sp1);
                 break;
             }
+            case NODOKA_BC_XCHG4: {
+                enum nodoka_data_type sp0 = POP();
+                enum nodoka_data_type sp1 = POP();
+                enum nodoka_data_type sp2 = POP();
+                enum nodoka_data_type sp3 = POP();
+                PUSH(sp0);
+                PUSH(sp3);
+                PUSH(sp2);
+                PUSH(sp1);
+                break;
+            }
             case NODOKA_BC_RET:
             case NODOKA_BC_THROW: {
                 if (i != end) {
@@ -121,14 +141,6 @@ bool nodoka_convPass(nodoka_code_emitter *emitter, nodoka_code_emitter *target,
                 }
                 break;
             }
-            case NODOKA_BC_NOCATCH:
-                break;
-            case NODOKA_BC_TRY: {
-                uint16_t offset = nodoka_pass_fetch16(emitter, &i);
-                PUSH(NODOKA_UNDEF | NODOKA_NULL | NODOKA_BOOL | NODOKA_NUMBER | NODOKA_STRING | NODOKA_OBJECT);
-                nodoka_emitBytecode(target, bc, emitter->codePool[offset]);
-                continue;
-            }
             case NODOKA_BC_THIS: PUSH(NODOKA_OBJECT); break;
             case NODOKA_BC_PRIM: {
                 enum nodoka_data_type type = POP();
@@ -171,6 +183,16 @@ bool nodoka_convPass(nodoka_code_emitter *emitter, nodoka_code_emitter *target,
                     break;
                 }
             }
+            case NODOKA_BC_KEY: {
+                enum nodoka_data_type type = POP();
+                if (type == NODOKA_STRING) {
+                    PUSH(NODOKA_STRING);
+                    mod = true;
+                    continue;
+                }
+                PUSH(type & NODOKA_NUMBER ? NODOKA_STRING | NODOKA_NUMBER : NODOKA_STRING);
+                break;
+            }
             case NODOKA_BC_REF: {
                 POP();
                 POP();
@@ -182,6 +204,29 @@ bool nodoka_convPass(nodoka_code_emitter *emitter, nodoka_code_emitter *target,
                 PUSH(NODOKA_REFERENCE);
                 break;
             }
+            case NODOKA_BC_GET_LOCAL:
+            case NODOKA_BC_SET_LOCAL: {
+                uint16_t index = nodoka_pass_fetch16(emitter, &i);
+                if (bc == NODOKA_BC_GET_LOCAL) {
+                    PUSH(NODOKA_UNDEF | NODOKA_NULL | NODOKA_BOOL | NODOKA_NUMBER | NODOKA_STRING | NODOKA_OBJECT);
+                } else {
+                    POP();
+                }
+                nodoka_emitBytecode(target, bc, index);
+                continue;
+            }
+            case NODOKA_BC_GET_UPVAL:
+            case NODOKA_BC_SET_UPVAL: {
+                uint8_t depth = nodoka_pass_fetch8(emitter, &i);
+                uint16_t index = nodoka_pass_fetch16(emitter, &i);
+                if (bc == NODOKA_BC_GET_UPVAL) {
+                    PUSH(NODOKA_UNDEF | NODOKA_NULL | NODOKA_BOOL | NODOKA_NUMBER | NODOKA_STRING | NODOKA_OBJECT);
+                } else {
+                    POP();
+                }
+                nodoka_emitBytecode(target, bc, depth, index);
+                continue;
+            }
             case NODOKA_BC_GET: {
                 enum nodoka_data_type type = POP();
                 if (!canBeRef(type)) {
@@ -198,6 +243,28 @@ bool nodoka_convPass(nodoka_code_emitter *emitter, nodoka_code_emitter *target,
                 POP();
                 break;
             }
+            case NODOKA_BC_GET_PROP: {
+                POP();
+                POP();
+                PUSH(NODOKA_UNDEF | NODOKA_NULL | NODOKA_BOOL | NODOKA_NUMBER | NODOKA_STRING | NODOKA_OBJECT);
+                break;
+            }
+            case NODOKA_BC_PUT_PROP: {
+                enum nodoka_data_type sp0 = POP();
+                POP();
+                POP();
+                PUSH(sp0);
+                break;
+            }
+            case NODOKA_BC_GET_NAME:
+            case NODOKA_BC_PUT_NAME: {
+                uint16_t offset = nodoka_pass_fetch16(emitter, &i);
+                if (bc == NODOKA_BC_GET_NAME) {
+                    PUSH(NODOKA_UNDEF | NODOKA_NULL | NODOKA_BOOL | NODOKA_NUMBER | NODOKA_STRING | NODOKA_OBJECT);
+                }
+                nodoka_emitBytecode(target, bc, emitter->stringPool[offset]);
+                continue;
+            }
             case NODOKA_BC_DEL: {
                 POP();
                 PUSH(NODOKA_BOOL);
@@ -213,6 +280,27 @@ bool nodoka_convPass(nodoka_code_emitter *emitter, nodoka_code_emitter *target,
                 PUSH(NODOKA_UNDEF | NODOKA_NULL | NODOKA_BOOL | NODOKA_NUMBER | NODOKA_STRING | NODOKA_OBJECT);
                 continue;
             }
+            case NODOKA_BC_CALL_PROP: {
+                uint8_t count = nodoka_pass_fetch8(emitter, &i);
+                nodoka_emitBytecode(target, NODOKA_BC_CALL_PROP, count);
+                for (int i = 0; i < count; i++) {
+                    POP();
+                }
+                POP();
+                POP();
+                PUSH(NODOKA_UNDEF | NODOKA_NULL | NODOKA_BOOL | NODOKA_NUMBER | NODOKA_STRING | NODOKA_OBJECT);
+                continue;
+            }
+            case NODOKA_BC_CALL_NAME: {
+                uint16_t offset = nodoka_pass_fetch16(emitter, &i);
+                uint8_t count = nodoka_pass_fetch8(emitter, &i);
+                nodoka_emitBytecode(target, NODOKA_BC_CALL_NAME, emitter->stringPool[offset], count);
+                for (int i = 0; i < count; i++) {
+                    POP();
+                }
+                PUSH(NODOKA_UNDEF | NODOKA_NULL | NODOKA_BOOL | NODOKA_NUMBER | NODOKA_STRING | NODOKA_OBJECT);
+                continue;
+            }
             case NODOKA_BC_NEW: {
                 uint8_t count = nodoka_pass_fetch8(emitter, &i);
                 nodoka_emitBytecode(target, NODOKA_BC_NEW, count);
@@ -17,9 +17,9 @@
     }while (0)
 
 #define POP() ({\
-        nodoka_data* ret;\
+        nodoka_value ret;\
         if(stackTop<=typeStack){\
-            ret=NULL;\
+            ret=nodoka_empty;\
         }else{\
             ret=*(--stackTop);\
         }\
@@ -27,9 +27,9 @@
     })
 
 #define PEEK() ({\
-        nodoka_data* ret;\
+        nodoka_value ret;\
         if(stackTop<=typeStack){\
-            ret=NULL;\
+            ret=nodoka_empty;\
         }else{\
             ret=*(stackTop-1);\
         }\
@@ -37,9 +37,9 @@
     })
 
 bool nodoka_foldPass(nodoka_code_emitter *emitter, nodoka_code_emitter *target, size_t start, size_t end) {
-    nodoka_data **typeStack = malloc(128);
-    nodoka_data **stackTop = typeStack;
-    nodoka_data **stackLimit = typeStack + 128;
+    nodoka_value *typeStack = malloc(sizeof(nodoka_value) * 128);
+    nodoka_value *stackTop = typeStack;
+    nodoka_value *stackLimit = typeStack + 128;
     bool mod = false;
     for (size_t i = start; i < end;) {
         enum nodoka_bytecode bc = nodoka_pass_fetch8(emitter, &i);
@@ -50,54 +50,74 @@ bool nodoka_foldPass(nodoka_code_emitter *emitter, nodoka_code_emitter *target,
             case NODOKA_BC_FALSE: PUSH(nodoka_false); break;
             case NODOKA_BC_LOAD_STR: {
                 nodoka_string *str = emitter->stringPool[nodoka_pass_fetch16(emitter, &i)];
-                PUSH((nodoka_data *)str);
+                PUSH(nodoka_box(str));
                 nodoka_emitBytecode(target, bc, str);
                 continue;
             }
             case NODOKA_BC_LOAD_NUM: {
                 double val = int2double(nodoka_pass_fetch64(emitter, &i));
-                PUSH((nodoka_data *)nodoka_newNumber(val));
+                PUSH(nodoka_fromNumber(val));
                 nodoka_emitBytecode(target, bc, val);
                 continue;
             }
             case NODOKA_BC_LOAD_OBJ: {
-                PUSH(NULL);
+                PUSH(nodoka_empty);
                 break;
             }
             case NODOKA_BC_LOAD_ARR: {
-                PUSH(NULL);
+                PUSH(nodoka_empty);
                 break;
             }
             case NODOKA_BC_FUNC: {
                 nodoka_code *code = emitter->codePool[nodoka_pass_fetch16(emitter, &i)];
-                PUSH(NULL);
+                PUSH(nodoka_empty);
                 nodoka_emitBytecode(target, bc, code);
                 continue;
             }
             case NODOKA_BC_NOP: continue;
             case NODOKA_BC_DUP: {
-                nodoka_data *sp0 = POP();
+                nodoka_value sp0 = POP();
                 PUSH(sp0);
                 PUSH(sp0);
                 break;
             }
+            case NODOKA_BC_DUP2: {
+                nodoka_value sp0 = POP();
+                nodoka_value sp1 = POP();
+                PUSH(sp1);
+                PUSH(sp0);
+                PUSH(sp1);
+                PUSH(sp0);
+                break;
+            }
             case NODOKA_BC_POP: POP(); break;
             case NODOKA_BC_XCHG: {
-                nodoka_data *sp0 = POP();
-                nodoka_data *sp1 = POP();
+                nodoka_value sp0 = POP();
+                nodoka_value sp1 = POP();
                 PUSH(sp0);
                 PUSH(sp1);
                 break;
             }
             case NODOKA_BC_XCHG3: {
-                nodoka_data *sp0 = POP();
-                nodoka_data *sp1 = POP();
-                nodoka_data *sp2 = POP();
+                nodoka_value sp0 = POP();
+                nodoka_value sp1 = POP();
+                nodoka_value sp2 = POP();
                 PUSH(sp0);
                 PUSH(sp2);
                 PUSH(sp1);
                 break;
             }
+            case NODOKA_BC_XCHG4: {
+                nodoka_value sp0 = POP();
+                nodoka_value sp1 = POP();
+                nodoka_value sp2 = POP();
+                nodoka_value sp3 = POP();
+                PUSH(sp0);
+                PUSH(sp3);
+                PUSH(sp2);
+                PUSH(sp1);
+                break;
+            }
             case NODOKA_BC_RET:
             case NODOKA_BC_THROW: {
                 if (i != end) {
@@ -106,69 +126,119 @@ bool nodoka_foldPass(nodoka_code_emitter *emitter, nodoka_code_emitter *target,
                 }
                 break;
             }
-            case NODOKA_BC_TRY: {
-                uint16_t offset = nodoka_pass_fetch16(emitter, &i);
-                PUSH(NULL);
-                nodoka_emitBytecode(target, bc, emitter->codePool[offset]);
-                continue;
-            }
-            case NODOKA_BC_NOCATCH:
-                break;
-            case NODOKA_BC_THIS: PUSH(NULL); break;
+            case NODOKA_BC_THIS: PUSH(nodoka_empty); break;
             /* Notice that constants are all primitives, so this instruction needs no special deal */
             case NODOKA_BC_PRIM: break;
             case NODOKA_BC_BOOL: {
-                nodoka_data *sp0 = POP();
+                nodoka_value sp0 = POP();
                 if (sp0) {
-                    nodoka_data *result = nodoka_toBoolean(sp0);
+                    bool result = nodoka_toBoolean(sp0);
                     nodoka_emitBytecode(target, NODOKA_BC_POP);
-                    nodoka_emitBytecode(target, result == nodoka_true ? NODOKA_BC_TRUE : NODOKA_BC_FALSE);
-                    PUSH(result);
+                    nodoka_emitBytecode(target, result ? NODOKA_BC_TRUE : NODOKA_BC_FALSE);
+                    PUSH(nodoka_fromBool(result));
                     continue;
                 } else {
-                    PUSH(NULL);
+                    PUSH(nodoka_empty);
                     break;
                 }
             }
             case NODOKA_BC_NUM: {
-                nodoka_data *sp0 = POP();
+                nodoka_value sp0 = POP();
                 if (sp0) {
-                    nodoka_number *result = nodoka_toNumber(sp0);
+                    double result = nodoka_toNumber(sp0);
                     nodoka_emitBytecode(target, NODOKA_BC_POP);
-                    nodoka_emitBytecode(target, NODOKA_BC_LOAD_NUM, result->value);
-                    PUSH((nodoka_data *)result);
+                    nodoka_emitBytecode(target, NODOKA_BC_LOAD_NUM, result);
+                    PUSH(nodoka_fromNumber(result));
                     continue;
                 } else {
-                    PUSH(NULL);
+                    PUSH(nodoka_empty);
                     break;
                 }
             }
             case NODOKA_BC_STR: {
-                nodoka_data *sp0 = POP();
+                nodoka_value sp0 = POP();
                 if (sp0) {
-                    nodoka_string *result = nodoka_toString(NULL, sp0);
+                    nodoka_string *result = nodoka_toAtom(nodoka_toString(NULL, sp0));
                     nodoka_emitBytecode(target, NODOKA_BC_POP);
                     nodoka_emitBytecode(target, NODOKA_BC_LOAD_STR, result);
-                    PUSH((nodoka_data *)result);
+                    PUSH(nodoka_box(result));
                     continue;
                 } else {
-                    PUSH(NULL);
+                    PUSH(nodoka_empty);
+                    break;
+                }
+            }
+            case NODOKA_BC_KEY: {
+                nodoka_value sp0 = POP();
+                if (sp0 && (nodoka_isString(sp0) || (nodoka_isInt32(sp0) && nodoka_getInt32(sp0) >= 0))) {
+                    /* Already a key */
+                    PUSH(sp0);
+                    mod = true;
+                    continue;
+                } else if (sp0) {
+                    nodoka_string *result = nodoka_toAtom(nodoka_toString(NULL, sp0));
+                    nodoka_emitBytecode(target, NODOKA_BC_POP);
+                    nodoka_emitBytecode(target, NODOKA_BC_LOAD_STR, result);
+                    PUSH(nodoka_box(result));
+                    continue;
+                } else {
+                    PUSH(nodoka_empty);
                     break;
                 }
             }
             case NODOKA_BC_GET: break;
+            case NODOKA_BC_GET_LOCAL:
+            case NODOKA_BC_SET_LOCAL: {
+                uint16_t index = nodoka_pass_fetch16(emitter, &i);
+                if (bc == NODOKA_BC_GET_LOCAL) {
+                    PUSH(nodoka_empty);
+                } else {
+                    POP();
+                }
+                nodoka_emitBytecode(target, bc, index);
+                continue;
+            }
+            case NODOKA_BC_GET_UPVAL:
+            case NODOKA_BC_SET_UPVAL: {
+                uint8_t depth = nodoka_pass_fetch8(emitter, &i);
+                uint16_t index = nodoka_pass_fetch16(emitter, &i);
+                if (bc == NODOKA_BC_GET_UPVAL) {
+                    PUSH(nodoka_empty);
+                } else {
+                    POP();
+                }
+                nodoka_emitBytecode(target, bc, depth, index);
+                continue;
+            }
             case NODOKA_BC_PUT: POP(); POP(); break;
-            case NODOKA_BC_REF: POP(); POP(); PUSH(NULL); break;
-            case NODOKA_BC_ID: POP(); PUSH(NULL); break;
+            case NODOKA_BC_REF: POP(); POP(); PUSH(nodoka_empty); break;
+            case NODOKA_BC_GET_PROP: POP(); POP(); PUSH(nodoka_empty); break;
+            case NODOKA_BC_PUT_PROP: {
+                nodoka_value sp0 = POP();
+                POP();
+                POP();
+                PUSH(sp0);
+                break;
+            }
+            case NODOKA_BC_GET_NAME:
+            case NODOKA_BC_PUT_NAME: {
+                nodoka_string *str = emitter->stringPool[nodoka_pass_fetch16(emitter, &i)];
+                if (bc == NODOKA_BC_GET_NAME) {
+                    PUSH(nodoka_empty);
+                }
+                nodoka_emitBytecode(target, bc, str);
+                continue;
+            }
+            case NODOKA_BC_ID: POP(); PUSH(nodoka_empty); break;
             case NODOKA_BC_DEL: {
-                nodoka_data *sp0 = POP();
+                nodoka_value sp0 = POP();
                 if (sp0) {
                     nodoka_emitBytecode(target, NODOKA_BC_POP);
                     nodoka_emitBytecode(target, NODOKA_BC_TRUE);
                     PUSH(nodoka_true);
                     continue;
                 } else {
-                    PUSH(NULL);
+                    PUSH(nodoka_empty);
                     break;
                 }
             }
@@ -180,43 +250,63 @@ bool nodoka_foldPass(nodoka_code_emitter *emitter, nodoka_code_emitter *target,
                     POP();
                 }
                 POP();
-                PUSH(NULL);
+                PUSH(nodoka_empty);
+                continue;
+            }
+            case NODOKA_BC_CALL_PROP: {
+                uint8_t count = nodoka_pass_fetch8(emitter, &i);
+                nodoka_emitBytecode(target, bc, count);
+                for (int i = 0; i < count + 2; i++) {
+                    POP();
+                }
+                PUSH(nodoka_empty);
+                continue;
+            }
+            case NODOKA_BC_CALL_NAME: {
+                nodoka_string *str = emitter->stringPool[nodoka_pass_fetch16(emitter, &i)];
+                uint8_t count = nodoka_pass_fetch8(emitter, &i);
+                nodoka_emitBytecode(target, bc, str, count);
+                for (int i = 0; i < count; i++) {
+                    POP();
+                }
+                PUSH(nodoka_empty);
                 continue;
             }
             case NODOKA_BC_TYPEOF: {
                 POP();
-                PUSH(NULL);
+                PUSH(nodoka_empty);
                 break;
             }
             case NODOKA_BC_NEG: {
-                nodoka_number *sp0 = (nodoka_number *)POP();
+                nodoka_value sp0 = POP();
                 if (sp0) {
                     assertNumber(sp0);
+                    double value = -nodoka_getNumber(sp0);
                     nodoka_emitBytecode(target, NODOKA_BC_POP);
-                    nodoka_emitBytecode(target, NODOKA_BC_LOAD_NUM, -sp0->value);
-                    PUSH((nodoka_data *)nodoka_newNumber(-sp0->value));
+                    nodoka_emitBytecode(target, NODOKA_BC_LOAD_NUM, value);
+                    PUSH(nodoka_fromNumber(value));
                     continue;
                 } else {
-                    PUSH(NULL);
+                    PUSH(nodoka_empty);
                     break;
                 }
             }
             case NODOKA_BC_NOT: {
-                nodoka_number *sp0 = (nodoka_number *)POP();
+                nodoka_value sp0 = POP();
                 if (sp0) {
                     assertNumber(sp0);
-                    double value = ~nodoka_toInt32(sp0);
+                    double value = ~nodoka_toInt32(nodoka_getNumber(sp0));
                     nodoka_emitBytecode(target, NODOKA_BC_POP);
                     nodoka_emitBytecode(target, NODOKA_BC_LOAD_NUM, value);
-                    PUSH((nodoka_data *)nodoka_newNumber(value));
+                    PUSH(nodoka_fromNumber(value));
                     continue;
                 } else {
-                    PUSH(NULL);
+                    PUSH(nodoka_empty);
                     break;
                 }
             }
             case NODOKA_BC_L_NOT: {
-                nodoka_data *sp0 = POP();
+                nodoka_value sp0 = POP();
                 if (sp0) {
                     assertBoolean(sp0);
                     nodoka_emitBytecode(target, NODOKA_BC_POP);
@@ -224,7 +314,7 @@ bool nodoka_foldPass(nodoka_code_emitter *emitter, nodoka_code_emitter *target,
                     PUSH(sp0 == nodoka_true ? nodoka_false : nodoka_true);
                     continue;
                 } else {
-                    PUSH(NULL);
+                    PUSH(nodoka_empty);
                     break;
                 }
             }
@@ -238,59 +328,59 @@ bool nodoka_foldPass(nodoka_code_emitter *emitter, nodoka_code_emitter *target,
             case NODOKA_BC_AND:
             case NODOKA_BC_OR:
             case NODOKA_BC_XOR: {
-                nodoka_number *sp0 = (nodoka_number *)POP();
-                nodoka_number *sp1 = (nodoka_number *)POP();
+                nodoka_value sp0 = POP();
+                nodoka_value sp1 = POP();
                 if (sp0 && sp1) {
                     assertNumber(sp1);
                     assertNumber(sp0);
+                    double num1 = nodoka_getNumber(sp1);
+                    double num0 = nodoka_getNumber(sp0);
                     double value;
                     switch (bc) {
-                        case NODOKA_BC_MUL: value = sp1->value * sp0->value; break;
-                        case NODOKA_BC_MOD: value = fmod(sp1->value, sp0->value); break;
-                        case NODOKA_BC_DIV: value = sp1->value / sp0->value; break;
-                        case NODOKA_BC_SUB: value = sp1->value - sp0->value; break;
-                        case NODOKA_BC_SHL: value = nodoka_toInt32(sp1) << (nodoka_toUint32(sp0) & 0x1F); break;
-                        case NODOKA_BC_SHR: value = nodoka_toInt32(sp1) >> (nodoka_toUint32(sp0) & 0x1F); break;
-                        case NODOKA_BC_USHR: value = nodoka_toUint32(sp1) >> (nodoka_toUint32(sp0) & 0x1F); break;
-                        case NODOKA_BC_AND: value = nodoka_toInt32(sp1) & nodoka_toInt32(sp0); break;
-                        case NODOKA_BC_OR: value = nodoka_toInt32(sp1) | nodoka_toInt32(sp0); break;
-                        case NODOKA_BC_XOR: value = nodoka_toInt32(sp1) ^ nodoka_toInt32(sp0); break;
+                        case NODOKA_BC_MUL: value = num1 * num0; break;
+                        case NODOKA_BC_MOD: value = fmod(num1, num0); break;
+                        case NODOKA_BC_DIV: value = num1 / num0; break;
+                        case NODOKA_BC_SUB: value = num1 - num0; break;
+                        case NODOKA_BC_SHL: value = nodoka_toInt32(num1) << (nodoka_toUint32(num0) & 0x1F); break;
+                        case NODOKA_BC_SHR: value = nodoka_toInt32(num1) >> (nodoka_toUint32(num0) & 0x1F); break;
+                        case NODOKA_BC_USHR: value = nodoka_toUint32(num1) >> (nodoka_toUint32(num0) & 0x1F); break;
+                        case NODOKA_BC_AND: value = nodoka_toInt32(num1) & nodoka_toInt32(num0); break;
+                        case NODOKA_BC_OR: value = nodoka_toInt32(num1) | nodoka_toInt32(num0); break;
+                        case NODOKA_BC_XOR: value = nodoka_toInt32(num1) ^ nodoka_toInt32(num0); break;
                         default: assert(0);
                     }
                     nodoka_emitBytecode(target, NODOKA_BC_POP);
                     nodoka_emitBytecode(target, NODOKA_BC_POP);
                     nodoka_emitBytecode(target, NODOKA_BC_LOAD_NUM, value);
-                    PUSH((nodoka_data *)nodoka_newNumber(value));
+                    PUSH(nodoka_fromNumber(value));
                     continue;
                 } else {
-                    PUSH(NULL);
+                    PUSH(nodoka_empty);
                     break;
                 }
             }
             case NODOKA_BC_ADD: {
-                nodoka_data *sp0 = POP();
-                nodoka_data *sp1 = POP();
+                nodoka_value sp0 = POP();
+                nodoka_value sp1 = POP();
                 if (sp0 && sp1) {
                     assertPrimitive(sp1);
                     assertPrimitive(sp0);
                     nodoka_emitBytecode(target, NODOKA_BC_POP);
                     nodoka_emitBytecode(target, NODOKA_BC_POP);
-                    if (sp1->type == NODOKA_STRING || sp0->type == NODOKA_STRING) {
+                    if (nodoka_isString(sp1) || nodoka_isString(sp0)) {
                         nodoka_string *lstr = nodoka_toString(NULL, sp1);
                         nodoka_string *rstr = nodoka_toString(NULL, sp0);
-                        nodoka_string *result = nodoka_concatString(2, lstr, rstr);
-                        PUSH((nodoka_data *)result);
+                        nodoka_string *result = nodoka_toAtom(nodoka_concatString(2, lstr, rstr));
+                        PUSH(nodoka_box(result));
                         nodoka_emitBytecode(target, NODOKA_BC_LOAD_STR, result);
                     } else {
-                        nodoka_number *lnum = nodoka_toNumber(sp1);
-                        nodoka_number *rnum = nodoka_toNumber(sp0);
-                        double value = lnum->value + rnum->value;
-                        PUSH((nodoka_data *)nodoka_newNumber(value));
+                        double value = nodoka_toNumber(sp1) + nodoka_toNumber(sp0);
+                        PUSH(nodoka_fromNumber(value));
                         nodoka_emitBytecode(target, NODOKA_BC_LOAD_NUM, value);
                     }
                     continue;
                 } else {
-                    PUSH(NULL);
+                    PUSH(nodoka_empty);
                     break;
                 }
             }
@@ -298,8 +388,8 @@ bool nodoka_foldPass(nodoka_code_emitter *emitter, nodoka_code_emitter *target,
             case NODOKA_BC_LTEQ:
             case NODOKA_BC_EQ:
             case NODOKA_BC_S_EQ: {
-                nodoka_data *sp0 = POP();
-                nodoka_data *sp1 = POP();
+                nodoka_value sp0 = POP();
+                nodoka_value sp1 = POP();
                 if (sp0 && sp1) {
                     bool result;
                     switch (bc) {
@@ -315,7 +405,7 @@ bool nodoka_foldPass(nodoka_code_emitter *emitter, nodoka_code_emitter *target,
                     nodoka_emitBytecode(target, result ? NODOKA_BC_TRUE : NODOKA_BC_FALSE);
                     continue;
                 } else {
-                    PUSH(NULL);
+                    PUSH(nodoka_empty);
                     break;
                 }
                 break;
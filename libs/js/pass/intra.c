@@ -11,25 +11,39 @@ bool nodoka_intraPcr(nodoka_code_emitter *source, nodoka_intraPcrPass pass) {
     nodoka_code_emitter *temp = nodoka_newCodeEmitter();
 
     size_t size = source->bytecodeLength;
-    uint16_t *labelMap = malloc(sizeof(uint16_t) * size);
+    uint16_t *labelMap = malloc(sizeof(uint16_t) * (size + 1));
     for (int i = 0; i < size; i++) {
         labelMap[i] = 0xFFFF;
     }
 
+    /* Boundaries of protected ranges and handlers start new blocks as well */
+    for (size_t i = 0; i < source->handlerLength; i++) {
+        nodoka_handler *h = &source->handlers[i];
+        labelMap[h->start] = 0;
+        labelMap[h->end] = 0;
+        labelMap[h->handler] = 0;
+    }
+
     /* Mark all branch nodes (target or origin of a branch instruction) */
     for (size_t i = 0; i < size;) {
         enum nodoka_bytecode bc = nodoka_pass_fetch8(source, &i);
         switch (bc) {
             case NODOKA_BC_LOAD_NUM: i += 8; break;
             case NODOKA_BC_CALL:
+            case NODOKA_BC_CALL_PROP:
             case NODOKA_BC_NEW: i++; break;
+            case NODOKA_BC_CALL_NAME: i += 3; break;
             case NODOKA_BC_LOAD_STR:
             case NODOKA_BC_DECL:
+            case NODOKA_BC_GET_NAME:
+            case NODOKA_BC_PUT_NAME:
             case NODOKA_BC_FUNC:
-            case NODOKA_BC_TRY: i += 2; break;
+            case NODOKA_BC_GET_LOCAL:
+            case NODOKA_BC_SET_LOCAL: i += 2; break;
+            case NODOKA_BC_GET_UPVAL:
+            case NODOKA_BC_SET_UPVAL: i += 3; break;
             case NODOKA_BC_JMP:
-            case NODOKA_BC_JT:
-            case NODOKA_BC_CATCH: {
+            case NODOKA_BC_JT: {
                 labelMap[i - 1] = 0;
                 uint16_t offset = nodoka_pass_fetch16(source, &i);
                 labelMap[offset] = 0;
@@ -56,8 +70,7 @@ bool nodoka_intraPcr(nodoka_code_emitter *source, nodoka_intraPcrPass pass) {
         }
         switch (source->bytecode[start]) {
             case NODOKA_BC_JMP:
-            case NODOKA_BC_JT:
-            case NODOKA_BC_CATCH: {
+            case NODOKA_BC_JT: {
                 labelMap[start] = temp->bytecodeLength;
                 nodoka_emitBytecode(temp, source->bytecode[start], NULL);
                 mod |= pass(source, temp, start + 3, end);
@@ -78,14 +91,14 @@ bool nodoka_intraPcr(nodoka_code_emitter *source, nodoka_intraPcrPass pass) {
         }
         start = end;
     }
+    labelMap[size] = temp->bytecodeLength;
 
     /* Fill in the corresponding label */
     for (int i = 0; i < size; i++) {
         if (labelMap[i] != 0xFFFF) {
             switch (source->bytecode[i]) {
                 case NODOKA_BC_JMP:
-                case NODOKA_BC_JT:
-                case NODOKA_BC_CATCH: {
+                case NODOKA_BC_JT: {
                     nodoka_relocatable rel = labelMap[i] + 1;
                     nodoka_label prevRel = (source->bytecode[i + 1] << 8) | source->bytecode[i + 2];
                     nodoka_relocate(temp, rel, labelMap[prevRel]);
@@ -96,6 +109,11 @@ bool nodoka_intraPcr(nodoka_code_emitter *source, nodoka_intraPcrPass pass) {
         }
     }
 
+    for (size_t i = 0; i < source->handlerLength; i++) {
+        nodoka_handler *h = &source->handlers[i];
+        nodoka_emitHandler(temp, labelMap[h->start], labelMap[h->end], labelMap[h->handler], h->depth);
+    }
+
     /* Switch the emitter */
     nodoka_xchgEmitter(source, temp);
     nodoka_freeEmitter(temp);
@@ -106,17 +106,48 @@ continue;
                 nodoka_emitBytecode(target, bc, emitter->codePool[offset]);
                 continue;
             }
-            case NODOKA_BC_TRY: {
-                uint16_t offset = nodoka_pass_fetch16(emitter, &i);
-                nodoka_emitBytecode(target, bc, emitter->codePool[offset]);
-                continue;
-            }
             case NODOKA_BC_CALL:
+            case NODOKA_BC_CALL_PROP:
             case NODOKA_BC_NEW: {
                 uint8_t count = nodoka_pass_fetch8(emitter, &i);
                 nodoka_emitBytecode(target, bc, count);
                 continue;
             }
+            case NODOKA_BC_CALL_NAME: {
+                uint16_t offset = nodoka_pass_fetch16(emitter, &i);
+                uint8_t count = nodoka_pass_fetch8(emitter, &i);
+                nodoka_emitBytecode(target, bc, emitter->stringPool[offset], count);
+                continue;
+            }
+            case NODOKA_BC_GET_NAME:
+            case NODOKA_BC_PUT_NAME: {
+                uint16_t offset = nodoka_pass_fetch16(emitter, &i);
+                nodoka_emitBytecode(target, bc, emitter->stringPool[offset]);
+                continue;
+            }
+            case NODOKA_BC_GET_LOCAL: {
+                uint16_t index = nodoka_pass_fetch16(emitter, &i);
+                /* GET_LOCAL [imm16] POP can be removed with no side-effect */
+                if (i < end && emitter->bytecode[i] == NODOKA_BC_POP) {
+                    i++;
+                    mod = true;
+                } else {
+                    nodoka_emitBytecode(target, bc, index);
+                }
+                continue;
+            }
+            case NODOKA_BC_SET_LOCAL: {
+                uint16_t index = nodoka_pass_fetch16(emitter, &i);
+                nodoka_emitBytecode(target, bc, index);
+                continue;
+            }
+            case NODOKA_BC_GET_UPVAL:
+            case NODOKA_BC_SET_UPVAL: {
+                uint8_t depth = nodoka_pass_fetch8(emitter, &i);
+                uint16_t index = nodoka_pass_fetch16(emitter, &i);
+                nodoka_emitBytecode(target, bc, depth, index);
+                continue;
+            }
             case NODOKA_BC_XCHG: {
                 /* XCHG XCHG can be removed with no side-effect */
                 if (i < end && emitter->bytecode[i] == NODOKA_BC_XCHG) {
@@ -137,6 +168,16 @@ continue;
                     mod = true;
                     continue;
                 }
+                /* DUP SET_LOCAL [imm16] POP can be reduced to SET_LOCAL [imm16] */
+                if (i + 3 < end &&
+                        emitter->bytecode[i] == NODOKA_BC_SET_LOCAL &&
+                        emitter->bytecode[i + 3] == NODOKA_BC_POP) {
+                    uint16_t index = emitter->bytecode[i + 1] << 8 | emitter->bytecode[i + 2];
+                    i += 4;
+                    mod = true;
+                    nodoka_emitBytecode(target, NODOKA_BC_SET_LOCAL, index);
+                    continue;
+                }
                 if (i + 2 < end &&
                         emitter->bytecode[i] == NODOKA_BC_XCHG3 &&
                         emitter->bytecode[i + 1] == NODOKA_BC_PUT &&
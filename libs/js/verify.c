@@ -0,0 +1,264 @@
+#include "c/stdlib.h"
+#include "c/string.h"
+
+#include "js/js.h"
+#include "js/bytecode.h"
+
+enum {
+    UNVISITED = -1,
+};
+
+/* Number of values an instruction pops and pushes */
+static void stackEffect(uint8_t *bytecode, size_t ptr, size_t *pops, size_t *pushes) {
+    switch (bytecode[ptr]) {
+        case NODOKA_BC_NOP:
+        case NODOKA_BC_DECL:
+        case NODOKA_BC_JMP:
+            *pops = 0; *pushes = 0; break;
+        case NODOKA_BC_UNDEF:
+        case NODOKA_BC_NULL:
+        case NODOKA_BC_TRUE:
+        case NODOKA_BC_FALSE:
+        case NODOKA_BC_LOAD_STR:
+        case NODOKA_BC_LOAD_NUM:
+        case NODOKA_BC_FUNC:
+        case NODOKA_BC_LOAD_OBJ:
+        case NODOKA_BC_LOAD_ARR:
+        case NODOKA_BC_THIS:
+        case NODOKA_BC_GET_LOCAL:
+        case NODOKA_BC_GET_UPVAL:
+        case NODOKA_BC_GET_NAME:
+            *pops = 0; *pushes = 1; break;
+        case NODOKA_BC_POP:
+        case NODOKA_BC_SET_LOCAL:
+        case NODOKA_BC_SET_UPVAL:
+        case NODOKA_BC_JT:
+        case NODOKA_BC_RET:
+        case NODOKA_BC_THROW:
+            *pops = 1; *pushes = 0; break;
+        case NODOKA_BC_DUP:
+            *pops = 1; *pushes = 2; break;
+        case NODOKA_BC_DUP2:
+            *pops = 2; *pushes = 4; break;
+        case NODOKA_BC_XCHG:
+            *pops = 2; *pushes = 2; break;
+        case NODOKA_BC_XCHG3:
+            *pops = 3; *pushes = 3; break;
+        case NODOKA_BC_XCHG4:
+            *pops = 4; *pushes = 4; break;
+        case NODOKA_BC_PUT:
+            *pops = 2; *pushes = 0; break;
+        case NODOKA_BC_PUT_PROP:
+            *pops = 3; *pushes = 1; break;
+        case NODOKA_BC_CALL:
+        case NODOKA_BC_NEW:
+            *pops = bytecode[ptr + 1] + 1; *pushes = 1; break;
+        case NODOKA_BC_CALL_PROP:
+            *pops = bytecode[ptr + 1] + 2; *pushes = 1; break;
+        case NODOKA_BC_CALL_NAME:
+            *pops = bytecode[ptr + 3]; *pushes = 1; break;
+        case NODOKA_BC_REF:
+        case NODOKA_BC_GET_PROP:
+        case NODOKA_BC_MUL:
+        case NODOKA_BC_MOD:
+        case NODOKA_BC_DIV:
+        case NODOKA_BC_ADD:
+        case NODOKA_BC_SUB:
+        case NODOKA_BC_SHL:
+        case NODOKA_BC_SHR:
+        case NODOKA_BC_USHR:
+        case NODOKA_BC_LT:
+        case NODOKA_BC_LTEQ:
+        case NODOKA_BC_EQ:
+        case NODOKA_BC_S_EQ:
+        case NODOKA_BC_AND:
+        case NODOKA_BC_OR:
+        case NODOKA_BC_XOR:
+            *pops = 2; *pushes = 1; break;
+        default:
+            /* Conversions and unary operators replace the stack top */
+            *pops = 1; *pushes = 1; break;
+    }
+}
+
+/* Whether the instruction can never throw, so that it may run below the depth of a handler */
+static bool neverThrows(uint8_t bc) {
+    switch (bc) {
+        case NODOKA_BC_UNDEF:
+        case NODOKA_BC_NULL:
+        case NODOKA_BC_TRUE:
+        case NODOKA_BC_FALSE:
+        case NODOKA_BC_LOAD_STR:
+        case NODOKA_BC_LOAD_NUM:
+        case NODOKA_BC_NOP:
+        case NODOKA_BC_DUP:
+        case NODOKA_BC_DUP2:
+        case NODOKA_BC_POP:
+        case NODOKA_BC_XCHG:
+        case NODOKA_BC_XCHG3:
+        case NODOKA_BC_XCHG4:
+        case NODOKA_BC_RET:
+        case NODOKA_BC_GET_LOCAL:
+        case NODOKA_BC_SET_LOCAL:
+        case NODOKA_BC_JMP:
+        case NODOKA_BC_JT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static uint16_t read16(uint8_t *bytecode, size_t ptr) {
+    return (uint16_t)(bytecode[ptr] << 8 | bytecode[ptr + 1]);
+}
+
+/* Check the operands which refer to the pools and to the slots of the frame */
+static bool checkOperand(nodoka_code *code, size_t ptr) {
+    uint8_t *bytecode = code->bytecode;
+    switch (bytecode[ptr]) {
+        case NODOKA_BC_LOAD_STR:
+        case NODOKA_BC_DECL:
+        case NODOKA_BC_GET_NAME:
+        case NODOKA_BC_PUT_NAME:
+        case NODOKA_BC_CALL_NAME:
+            return read16(bytecode, ptr + 1) < code->strPoolLength;
+        case NODOKA_BC_FUNC:
+            return read16(bytecode, ptr + 1) < code->codePoolLength;
+        case NODOKA_BC_GET_LOCAL:
+        case NODOKA_BC_SET_LOCAL:
+            return read16(bytecode, ptr + 1) < code->localCount;
+        case NODOKA_BC_GET_UPVAL:
+        case NODOKA_BC_SET_UPVAL:
+            /* Only the record of the code itself is known here */
+            return bytecode[ptr + 1] || !code->slotCount || read16(bytecode, ptr + 2) < code->slotCount;
+        case NODOKA_BC_JMP:
+        case NODOKA_BC_JT:
+            return read16(bytecode, ptr + 1) < code->bytecodeLength;
+        default:
+            return true;
+    }
+}
+
+/*
+ * Verify the code before it is run, so that the interpreter can trust it:
+ * every opcode and operand must be valid, jumps and the exception table must
+ * point to instructions, and every instruction must be reached with the same
+ * operand stack depth whichever path is taken, without underflowing it and
+ * without falling off the end of the code. An instruction which may throw
+ * must also leave the values kept by its handlers untouched. The maximum
+ * depth is recorded as the size of the operand stack of the code.
+ */
+bool nodoka_verifyCode(nodoka_code *code) {
+    uint8_t *bytecode = code->bytecode;
+    size_t length = code->bytecodeLength;
+    if (!length) {
+        return false;
+    }
+
+    /* Depth on entry of each instruction, UNVISITED for the other bytes */
+    int32_t *depth = malloc(length * sizeof(int32_t));
+    bool *start = calloc(length + 1, sizeof(bool));
+    size_t *worklist = malloc(length * sizeof(size_t));
+    size_t worklistLength = 0;
+    size_t maxDepth = 0;
+    bool valid = false;
+
+    for (size_t i = 0; i < length; ) {
+        if (bytecode[i] >= NODOKA_BC_PROTECTOR) {
+            goto end;
+        }
+        size_t next = i + 1 + nodoka_operandLength(bytecode[i]);
+        if (next > length || !checkOperand(code, i)) {
+            goto end;
+        }
+        start[i] = true;
+        i = next;
+    }
+    start[length] = true;
+
+    for (size_t i = 0; i < length; i++) {
+        depth[i] = UNVISITED;
+    }
+    depth[0] = 0;
+    worklist[worklistLength++] = 0;
+    for (size_t i = 0; i < code->handlerLength; i++) {
+        nodoka_handler *h = &code->handlers[i];
+        if (h->start > h->end || !start[h->start] || !start[h->end] || h->handler >= length || !start[h->handler]) {
+            goto end;
+        }
+        if (depth[h->handler] == UNVISITED) {
+            depth[h->handler] = h->depth + 1;
+            worklist[worklistLength++] = h->handler;
+        } else if (depth[h->handler] != h->depth + 1) {
+            goto end;
+        }
+    }
+
+    while (worklistLength) {
+        size_t ptr = worklist[--worklistLength];
+        while (true) {
+            uint8_t bc = bytecode[ptr];
+            size_t d = depth[ptr];
+            if (d > maxDepth) {
+                maxDepth = d;
+            }
+            size_t pops, pushes;
+            stackEffect(bytecode, ptr, &pops, &pushes);
+            if (d < pops) {
+                goto end;
+            }
+            if (!neverThrows(bc)) {
+                for (size_t i = 0; i < code->handlerLength; i++) {
+                    nodoka_handler *h = &code->handlers[i];
+                    if (ptr >= h->start && ptr < h->end && d - pops < h->depth) {
+                        goto end;
+                    }
+                }
+            }
+            d = d - pops + pushes;
+            if (d > maxDepth) {
+                maxDepth = d;
+            }
+            if (d > UINT16_MAX) {
+                goto end;
+            }
+            if (bc == NODOKA_BC_RET || bc == NODOKA_BC_THROW) {
+                break;
+            }
+            if (bc == NODOKA_BC_JMP || bc == NODOKA_BC_JT) {
+                size_t target = read16(bytecode, ptr + 1);
+                if (!start[target]) {
+                    goto end;
+                }
+                if (depth[target] == UNVISITED) {
+                    depth[target] = d;
+                    worklist[worklistLength++] = target;
+                } else if (depth[target] != d) {
+                    goto end;
+                }
+                if (bc == NODOKA_BC_JMP) {
+                    break;
+                }
+            }
+            ptr += 1 + nodoka_operandLength(bc);
+            if (ptr == length) {
+                goto end;
+            }
+            if (depth[ptr] != UNVISITED) {
+                if (depth[ptr] != d) {
+                    goto end;
+                }
+                break;
+            }
+            depth[ptr] = d;
+        }
+    }
+
+    code->stackSize = maxDepth;
+    valid = true;
+end:
+    free(depth);
+    free(start);
+    free(worklist);
+    return valid;
+}
@@ -5,8 +5,8 @@
 #include "js/js.h"
 #include "js/object.h"
 
-nodoka_data *nodoka_toPrimitive(nodoka_data *value) {
-    switch (value->type) {
+nodoka_value nodoka_toPrimitive(nodoka_value value) {
+    switch (nodoka_typeOf(value)) {
         case NODOKA_UNDEF:
         case NODOKA_NULL:
         case NODOKA_BOOL:
@@ -18,58 +18,52 @@ nodoka_data *nodoka_toPrimitive(nodoka_data *value) {
     }
 }
 
-nodoka_data *nodoka_toBoolean(nodoka_data *value) {
-    switch (value->type) {
+bool nodoka_toBoolean(nodoka_value value) {
+    switch (nodoka_typeOf(value)) {
         case NODOKA_UNDEF:
         case NODOKA_NULL:
-            return nodoka_false;
+            return false;
         case NODOKA_BOOL:
-            return value;
+            return value == nodoka_true;
         case NODOKA_NUMBER: {
-            nodoka_number *num = (nodoka_number *)value;
-            if (num->value == 0.0 || isnan(num->value)) {
-                return nodoka_false;
-            } else {
-                return nodoka_true;
+            if (nodoka_isInt32(value)) {
+                return nodoka_getInt32(value) != 0;
             }
+            double num = nodoka_getDouble(value);
+            return !(num == 0.0 || isnan(num));
         }
         case NODOKA_STRING: {
-            nodoka_string *str = (nodoka_string *)value;
-            if (str->value.len) {
-                return nodoka_true;
-            } else {
-                return nodoka_false;
-            }
+            nodoka_string *str = nodoka_unbox(value);
+            return str->value.len != 0;
         }
         case NODOKA_OBJECT:
-            return nodoka_true;
+            return true;
         default: assert(0);
     }
 }
 
-nodoka_number *nodoka_toNumber(nodoka_data *value) {
-    switch (value->type) {
+double nodoka_toNumber(nodoka_value value) {
+    switch (nodoka_typeOf(value)) {
         case NODOKA_UNDEF:
-            return nodoka_nan;
+            return NAN;
         case NODOKA_NULL:
-            return nodoka_zero;
+            return 0;
         case NODOKA_BOOL:
             if (value == nodoka_true) {
-                return nodoka_one;
+                return 1;
             } else {
-                return nodoka_zero;
+                return 0;
             }
         case NODOKA_NUMBER:
-            return (nodoka_number *)value;
+            return nodoka_getNumber(value);
         case NODOKA_STRING: {
-            return nodoka_str2num((nodoka_string *)value);
+            return nodoka_getNumber(nodoka_str2num(nodoka_flatten(nodoka_unbox(value))));
         }
         default: assert(0);
     }
 }
 
-int32_t nodoka_toInt32(nodoka_number *value) {
-    double number = value->value;
+int32_t nodoka_toInt32(double number) {
     if (isnan(number) || isinf(number) || number == 0) {
         return 0;
     }
@@ -78,16 +72,16 @@ int32_t nodoka_toInt32(nodoka_number *value) {
     return int32bit;
 }
 
-uint32_t nodoka_toUint32(nodoka_number *value) {
+uint32_t nodoka_toUint32(double value) {
     return (uint32_t)nodoka_toInt32(value);
 }
 
-uint16_t nodoka_toUint16(nodoka_number *value) {
+uint16_t nodoka_toUint16(double value) {
     return (uint16_t)nodoka_toInt32(value);
 }
 
-nodoka_string *nodoka_toString(nodoka_context *C, nodoka_data *value) {
-    switch (value->type) {
+nodoka_string *nodoka_toString(nodoka_context *C, nodoka_value value) {
+    switch (nodoka_typeOf(value)) {
         case NODOKA_UNDEF:
             return nodoka_undefStr;
         case NODOKA_NULL:
@@ -99,29 +93,28 @@ nodoka_string *nodoka_toString(nodoka_context *C, nodoka_data *value) {
                 return nodoka_falseStr;
             }
         case NODOKA_NUMBER: {
-            return nodoka_num2str(((nodoka_number *)value)->value);
+            return nodoka_num2str(nodoka_getNumber(value));
         }
         case NODOKA_STRING:
-            return (nodoka_string *)value;
+            return nodoka_flatten(nodoka_unbox(value));
         case NODOKA_OBJECT: {
-            return nodoka_toString(C, nodoka_defaultValue(C, (nodoka_object *)value, NODOKA_STRING));
+            return nodoka_toString(C, nodoka_defaultValue(C, nodoka_unbox(value), NODOKA_STRING));
         }
         default:
             assert(0);
     }
 }
 
-nodoka_object *nodoka_toObject(nodoka_context *C, nodoka_data *value) {
-    switch (value->type) {
+nodoka_object *nodoka_toObject(nodoka_context *C, nodoka_value value) {
+    switch (nodoka_typeOf(value)) {
         case NODOKA_STRING: {
-            nodoka_data *ret;
-            nodoka_construct(C, C->global->String, &ret, 1, (nodoka_data*[1]) {
+            nodoka_value ret;
+            nodoka_construct(C, C->global->String, &ret, 1, (nodoka_value[1]) {
                 value
             });
-            return (nodoka_object *)ret;
+            return nodoka_unbox(ret);
         }
-        case NODOKA_OBJECT: return (nodoka_object *)value;
+        case NODOKA_OBJECT: return nodoka_unbox(value);
         default: assert(0);
     }
 }
-
@@ -5,13 +5,6 @@
 #include "js/bytecode.h"
 #include "js/object.h"
 
-nodoka_data *nodoka_null;
-nodoka_data *nodoka_undefined;
-nodoka_data *nodoka_true;
-nodoka_data *nodoka_false;
-nodoka_number *nodoka_nan;
-nodoka_number *nodoka_zero;
-nodoka_number *nodoka_one;
 nodoka_string *nodoka_nullStr;
 nodoka_string *nodoka_undefStr;
 nodoka_string *nodoka_trueStr;
@@ -20,16 +13,13 @@ nodoka_string *nodoka_nanStr;
 nodoka_string *nodoka_infStr;
 nodoka_string *nodoka_negInfStr;
 nodoka_string *nodoka_zeroStr;
+nodoka_string *nodoka_lengthStr;
+/* Strings of a single code unit below 0x100, by the unit */
+nodoka_string *nodoka_charStrings[256];
 
 void nodoka_initConstant(void) {
-    nodoka_null = nodoka_new_data(NODOKA_NULL);
-    nodoka_undefined = nodoka_new_data(NODOKA_UNDEF);
-    nodoka_true = nodoka_new_data(NODOKA_BOOL);
-    nodoka_false = nodoka_new_data(NODOKA_BOOL);
-    nodoka_nan = nodoka_newNumber(0.0 / 0.0);
-    nodoka_zero = nodoka_newNumber(0);
-    nodoka_one = nodoka_newNumber(1);
     nodoka_initStringPool();
+    nodoka_initShapes();
     nodoka_nullStr = nodoka_newStringFromUtf8("null");
     nodoka_undefStr = nodoka_newStringFromUtf8("undefined");
     nodoka_trueStr = nodoka_newStringFromUtf8("true");
@@ -38,50 +28,30 @@ void nodoka_initConstant(void) {
     nodoka_infStr = nodoka_newStringFromUtf8("Infinity");
     nodoka_negInfStr = nodoka_newStringFromUtf8("-Infinity");
     nodoka_zeroStr = nodoka_newStringFromUtf8("0");
-}
-
-nodoka_data *nodoka_new_data(enum nodoka_data_type type) {
-    size_t size;
-    switch (type) {
-        case NODOKA_NULL:
-        case NODOKA_UNDEF:
-        case NODOKA_BOOL: size = sizeof(nodoka_data); break;
-        case NODOKA_NUMBER: size = sizeof(nodoka_number); break;
-        case NODOKA_STRING: size = sizeof(nodoka_string); break;
-        case NODOKA_OBJECT: size = sizeof(nodoka_object); break;
-
-        case NODOKA_REFERENCE: size = sizeof(nodoka_reference); break;
-        case NODOKA_PROPERTY: size = sizeof(nodoka_prop_desc); break;
-        case NODOKA_CODE: size = sizeof(nodoka_code); break;
-        case NODOKA_ENV: size = sizeof(nodoka_envRec); break;
-        default: assert(0);
+    nodoka_lengthStr = nodoka_newStringFromUtf8("length");
+    for (int i = 0; i < 256; i++) {
+        uint16_t unit = i;
+        nodoka_charStrings[i] = nodoka_newStringDup((utf16_string_t) {
+            .str = &unit, .len = 1
+        });
     }
-    nodoka_data *data = malloc(size);
-    data->type = type;
-    return data;
-}
-
-nodoka_number *nodoka_newNumber(double val) {
-    nodoka_number *number = (nodoka_number *)nodoka_new_data(NODOKA_NUMBER);
-    number->value = val;
-    return number;
 }
 
-nodoka_reference *nodoka_newReference(nodoka_data *base, nodoka_string *name) {
-    nodoka_reference *ref = (nodoka_reference *)nodoka_new_data(NODOKA_REFERENCE);
+nodoka_reference *nodoka_newReference(nodoka_value base, nodoka_string *name) {
+    nodoka_reference *ref = (nodoka_reference *)nodoka_newYoungData(NODOKA_REFERENCE, sizeof(nodoka_reference));
     ref->base = base;
     ref->name = name;
     return ref;
 }
 
 nodoka_prop_desc *nodoka_newPropertyDesc(void) {
-    nodoka_prop_desc *propDesc = (nodoka_prop_desc *)nodoka_new_data(NODOKA_PROPERTY);
-    propDesc->value = NULL;
-    propDesc->get = NULL;
-    propDesc->set = NULL;
-    propDesc->writable = NULL;
-    propDesc->enumerable = NULL;
-    propDesc->configurable = NULL;
+    nodoka_prop_desc *propDesc = (nodoka_prop_desc *)nodoka_newYoungData(NODOKA_PROPERTY, sizeof(nodoka_prop_desc));
+    propDesc->value = nodoka_empty;
+    propDesc->get = nodoka_empty;
+    propDesc->set = nodoka_empty;
+    propDesc->writable = nodoka_empty;
+    propDesc->enumerable = nodoka_empty;
+    propDesc->configurable = nodoka_empty;
     return propDesc;
 }
 
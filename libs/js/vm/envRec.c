@@ -7,6 +7,22 @@ nodoka_envRec *nodoka_newDeclEnvRecord(nodoka_envRec *outer) {
     nodoka_envRec *rec = (nodoka_envRec *)nodoka_new_data(NODOKA_ENV);
     rec->outer = outer;
     rec->object = nodoka_newNativeObject();
+    rec->slots = NULL;
+    rec->slotCount = 0;
+    rec->this = nodoka_undefined;
+    return rec;
+}
+
+nodoka_envRec *nodoka_newSlotEnvRecord(nodoka_envRec *outer, size_t count) {
+    nodoka_envRec *rec = (nodoka_envRec *)nodoka_new_data(NODOKA_ENV);
+    rec->outer = outer;
+    rec->object = NULL;
+    region_t *region = nodoka_regionMemory();
+    rec->slots = region ? region_alloc(region, count * sizeof(nodoka_value)) : malloc(count * sizeof(nodoka_value));
+    rec->slotCount = count;
+    for (size_t i = 0; i < count; i++) {
+        rec->slots[i] = nodoka_undefined;
+    }
     rec->this = nodoka_undefined;
     return rec;
 }
@@ -15,15 +31,21 @@ nodoka_envRec *nodoka_newObjEnvRecord(nodoka_object *obj, nodoka_envRec *outer)
     nodoka_envRec *rec = (nodoka_envRec *)nodoka_new_data(NODOKA_ENV);
     rec->outer = outer;
     rec->object = obj;
-    rec->this = (nodoka_data *)obj;
+    rec->slots = NULL;
+    rec->slotCount = 0;
+    rec->this = nodoka_box(obj);
     return rec;
 }
 
 bool nodoka_hasBinding(nodoka_envRec *env, nodoka_string *name) {
+    /* Slot records hold resolved variables only, which are never looked up by name */
+    if (!env->object) {
+        return false;
+    }
     return nodoka_hasProperty(env->object, name);
 }
 
-nodoka_data *nodoka_getBindingValue(nodoka_envRec *env, nodoka_string *name) {
+nodoka_value nodoka_getBindingValue(nodoka_envRec *env, nodoka_string *name) {
     if (!nodoka_hasProperty(env->object, name)) {
         //strict?
         return nodoka_undefined;
@@ -31,9 +53,10 @@ nodoka_data *nodoka_getBindingValue(nodoka_envRec *env, nodoka_string *name) {
     return nodoka_get(env->object, name);
 }
 
-void nodoka_setMutableBinding(nodoka_envRec *env, nodoka_string *name, nodoka_data *val) {
+/* Returns false like nodoka_put */
+bool nodoka_setMutableBinding(nodoka_envRec *env, nodoka_string *name, nodoka_value val) {
     /* SetMutableBinding on env records will result in TypeError
      * if trying to modify immuntable bindings in strict mode */
-    nodoka_put(env->object, name, val, false);
+    return nodoka_put(env->object, name, val, false);
 }
 
@@ -0,0 +1,639 @@
+#include "c/assert.h"
+#include "c/stdlib.h"
+#include "c/string.h"
+#include "c/time.h"
+
+#include "js/js.h"
+#include "js/bytecode.h"
+#include "js/object.h"
+
+#include "data-struct/slab.h"
+#include "data-struct/region.h"
+
+enum {
+    /* Allocation volume before the first major collection, and the least between two */
+    MIN_THRESHOLD = 4 * 1024 * 1024,
+    NURSERY_SIZE = 256 * 1024,
+    /* Allocation volume between two steps of a major collection, and the work done by each */
+    STEP_SIZE = 128 * 1024,
+    MARK_SLICE = 8192,
+    SWEEP_SLICE = 16384,
+    DEF_WORKLIST_CAPACITY = 256,
+    DEF_ROOT_CAPACITY = 8,
+};
+
+/*
+ * A major collection is incremental: the roots are marked in one step, then
+ * marking and sweeping each proceed by slices, at the safe points of the
+ * interpreter, while the program keeps running in between.
+ */
+enum gc_phase {
+    PHASE_IDLE,
+    PHASE_MARKING,
+    PHASE_SWEEPING,
+};
+
+struct worklist {
+    nodoka_data **data;
+    size_t length;
+    size_t capacity;
+};
+
+size_t nodoka_gcAllocated = 0;
+bool nodoka_gcPending = false;
+bool nodoka_gcMarking = false;
+static enum gc_phase phase = PHASE_IDLE;
+static size_t threshold = MIN_THRESHOLD;
+/* Value of nodoka_gcAllocated at which the next step is due */
+static size_t nextStep = MIN_THRESHOLD;
+
+/* Every object of the old space, most recently allocated first */
+static nodoka_data *heap = NULL;
+
+/* Objects being swept, which are detached from the heap meanwhile */
+static nodoka_data *sweepList = NULL;
+static nodoka_data **sweepPtr = NULL;
+static size_t live = 0;
+
+/*
+ * The nursery takes the values which rarely outlive the instruction which
+ * creates them. Survivors of a minor collection are copied to the old space,
+ * and the nursery is then reused as a whole.
+ */
+static uint64_t nursery[NURSERY_SIZE / sizeof(uint64_t)];
+uint8_t *nodoka_nurseryTop = (uint8_t *)nursery;
+uint8_t *nodoka_nurseryLimit = (uint8_t *)nursery + NURSERY_SIZE;
+
+/* Objects which are marked but whose children are not yet */
+static struct worklist grey;
+/* Copies made by a minor collection whose children are not yet evacuated */
+static struct worklist promoted;
+
+/* Values registered by the host with nodoka_addRoot */
+static nodoka_value **roots = NULL;
+static size_t rootLength = 0;
+static size_t rootCapacity = 0;
+
+static nodoka_gc_stats stats;
+
+/*
+ * Objects, records, references and descriptors created while a region is
+ * current are allocated in it instead of the old space. They are never
+ * collected, but traced on each major collection, as they may refer to the
+ * heap. Strings and codes are shared with the heap, and stay in it. The
+ * heap is never made to refer to them, as stores which would are rejected,
+ * see nodoka_escapesRegion.
+ */
+struct nodoka_region {
+    region_t *memory;
+    /* Everything allocated in the region, most recently allocated first */
+    nodoka_data *data;
+    struct nodoka_region *prev;
+    struct nodoka_region *next;
+};
+
+nodoka_region *nodoka_currentRegion = NULL;
+static nodoka_region *regions = NULL;
+
+static void pushWork(struct worklist *list, nodoka_data *data) {
+    if (list->length == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : DEF_WORKLIST_CAPACITY;
+        list->data = realloc(list->data, list->capacity * sizeof(nodoka_data *));
+    }
+    list->data[list->length++] = data;
+}
+
+static size_t dataSize(enum nodoka_data_type type) {
+    switch (type) {
+        case NODOKA_STRING: return sizeof(nodoka_string);
+        case NODOKA_OBJECT: return sizeof(nodoka_object);
+
+        case NODOKA_REFERENCE: return sizeof(nodoka_reference);
+        case NODOKA_PROPERTY: return sizeof(nodoka_prop_desc);
+        case NODOKA_CODE: return sizeof(nodoka_code);
+        case NODOKA_ENV: return sizeof(nodoka_envRec);
+        case NODOKA_SHAPE: return sizeof(nodoka_shape);
+        default: assert(0);
+    }
+}
+
+static nodoka_data *newRegionData(nodoka_region *region, enum nodoka_data_type type, size_t size) {
+    nodoka_data *data = region_alloc(region->memory, size);
+    data->type = type;
+    /* Always marked, so that marking leaves it to markRoots */
+    data->marked = true;
+    data->inRegion = true;
+    data->next = region->data;
+    region->data = data;
+    return data;
+}
+
+nodoka_data *nodoka_new_data(enum nodoka_data_type type) {
+    size_t size = dataSize(type);
+    if (nodoka_currentRegion && (type & (NODOKA_OBJECT | NODOKA_ENV | NODOKA_REFERENCE | NODOKA_PROPERTY))) {
+        return newRegionData(nodoka_currentRegion, type, size);
+    }
+    nodoka_data *data = slab_alloc(size);
+    data->type = type;
+    /* Objects allocated while marking are live for this collection */
+    data->marked = phase == PHASE_MARKING;
+    data->inRegion = false;
+    data->next = heap;
+    heap = data;
+    nodoka_gcAllocated += size;
+    if (nodoka_gcAllocated >= nextStep) {
+        nodoka_gcPending = true;
+    }
+    return data;
+}
+
+/* The nursery is full, so fall back to the old space until the next safe point */
+nodoka_data *nodoka_newYoungDataSlow(enum nodoka_data_type type) {
+    nodoka_gcPending = true;
+    return nodoka_new_data(type);
+}
+
+static bool isYoung(nodoka_data *data) {
+    return (uint8_t *)data >= (uint8_t *)nursery && (uint8_t *)data < (uint8_t *)nursery + NURSERY_SIZE;
+}
+
+/* Copy of a nursery value in the old space, for it to be stored in the heap */
+nodoka_data *nodoka_tenure(nodoka_data *data) {
+    if (!isYoung(data)) {
+        return data;
+    }
+    nodoka_data *copy = nodoka_new_data(data->type);
+    memcpy(copy + 1, data + 1, dataSize(data->type) - sizeof(nodoka_data));
+    return copy;
+}
+
+/* Register a location outside of the heap and the VM stack which holds a value */
+void nodoka_addRoot(nodoka_value *root) {
+    if (rootLength == rootCapacity) {
+        rootCapacity = rootCapacity ? rootCapacity * 2 : DEF_ROOT_CAPACITY;
+        roots = realloc(roots, rootCapacity * sizeof(nodoka_value *));
+    }
+    roots[rootLength++] = root;
+}
+
+void nodoka_removeRoot(nodoka_value *root) {
+    for (size_t i = rootLength; i-- > 0;) {
+        if (roots[i] == root) {
+            roots[i] = roots[--rootLength];
+            return;
+        }
+    }
+    assert(!"Root not registered");
+}
+
+/*
+ * Move a nursery value to the old space, leaving a forwarding pointer in
+ * the next field of the original. The copy is queued so that what it
+ * refers to gets evacuated as well.
+ */
+static nodoka_data *evacuate(nodoka_data *data) {
+    if (!data || !isYoung(data)) {
+        return data;
+    }
+    if (data->marked) {
+        return data->next;
+    }
+    nodoka_data *copy = nodoka_tenure(data);
+    data->marked = true;
+    data->next = copy;
+    pushWork(&promoted, copy);
+    return copy;
+}
+
+static void evacuateValues(nodoka_value *values, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (nodoka_isPointer(values[i])) {
+            values[i] = nodoka_box(evacuate(nodoka_unbox(values[i])));
+        }
+    }
+}
+
+/*
+ * Only nursery values refer to nursery values, as nodoka_tenure is used to
+ * store them anywhere else, so the roots are the VM stack and the host.
+ */
+static void minorCollection(nodoka_global *global) {
+    for (nodoka_context *context = global->stack->context; context; context = context->prev) {
+        evacuateValues(context->locals, context->code->localCount);
+        evacuateValues(context->stack, context->stackTop - context->stack);
+    }
+    for (size_t i = 0; i < rootLength; i++) {
+        evacuateValues(roots[i], 1);
+    }
+    while (promoted.length) {
+        nodoka_data *data = promoted.data[--promoted.length];
+        switch (data->type) {
+            case NODOKA_REFERENCE: {
+                nodoka_reference *ref = (nodoka_reference *)data;
+                evacuateValues(&ref->base, 1);
+                break;
+            }
+            case NODOKA_PROPERTY: {
+                nodoka_prop_desc *desc = (nodoka_prop_desc *)data;
+                evacuateValues(&desc->value, 1);
+                evacuateValues(&desc->get, 1);
+                evacuateValues(&desc->set, 1);
+                break;
+            }
+            default: assert(0);
+        }
+    }
+    nodoka_nurseryTop = (uint8_t *)nursery;
+}
+
+static void markData(void *ptr) {
+    nodoka_data *data = ptr;
+    if (!data || data->marked) {
+        return;
+    }
+    data->marked = true;
+    /* Strings have nothing to trace, unless they are ropes or substrings */
+    nodoka_string *str = ptr;
+    if (data->type == NODOKA_STRING && !str->left && !str->parent) {
+        return;
+    }
+    pushWork(&grey, data);
+}
+
+/*
+ * Slow path of nodoka_writeBarrier. Marking is done against the heap as it
+ * was when it started, so whatever a store is about to overwrite while
+ * marking must be kept alive, as the program might still hold it.
+ */
+void nodoka_shade(void *data) {
+    markData(data);
+}
+
+static void markValue(nodoka_value value) {
+    if (nodoka_isPointer(value)) {
+        markData(nodoka_unbox(value));
+    }
+}
+
+static void markValues(nodoka_value *values, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        markValue(values[i]);
+    }
+}
+
+static void traceObject(nodoka_object *obj) {
+    if (obj->shape) {
+        markData(obj->shape);
+        for (uint32_t i = 0; i < obj->shape->count; i++) {
+            markValue(obj->slots[i].value);
+        }
+    } else {
+        for (pair_t *it = hashmap_iterator(obj->prop); (it = hashmap_next(it));) {
+            markData(it->first);
+            markValue(((nodoka_property *)it->second)->value);
+        }
+    }
+    if (obj->elementsType == NODOKA_ELEMENTS_VALUE) {
+        markValues(obj->elements.values, obj->elementsCapacity);
+    }
+    markData(obj->prototype);
+    markData(obj->_class);
+    markValue(obj->primitiveValue);
+    markData(obj->scope);
+    for (size_t i = 0; i < obj->formalParameters.length; i++) {
+        markData(obj->formalParameters.array[i]);
+    }
+    markData(obj->code);
+    markData(obj->targetFunction);
+    markValue(obj->boundThis);
+    markValues(obj->boundArguments.array, obj->boundArguments.length);
+    markData(obj->codeString);
+}
+
+static void traceCode(nodoka_code *code) {
+    for (size_t i = 0; i < code->strPoolLength; i++) {
+        markData(code->stringPool[i]);
+    }
+    for (size_t i = 0; i < code->codePoolLength; i++) {
+        markData(code->codePool[i]);
+    }
+    for (size_t i = 0; i < code->formalParameters.length; i++) {
+        markData(code->formalParameters.array[i]);
+    }
+    markData(code->name);
+}
+
+static void trace(nodoka_data *data) {
+    switch (data->type) {
+        case NODOKA_STRING: {
+            nodoka_string *str = (nodoka_string *)data;
+            markData(str->left);
+            /* Or the parent of a substring */
+            markData(str->right);
+            break;
+        }
+        case NODOKA_OBJECT:
+            traceObject((nodoka_object *)data);
+            break;
+        case NODOKA_REFERENCE: {
+            nodoka_reference *ref = (nodoka_reference *)data;
+            markValue(ref->base);
+            markData(ref->name);
+            break;
+        }
+        case NODOKA_PROPERTY: {
+            nodoka_prop_desc *desc = (nodoka_prop_desc *)data;
+            markValue(desc->value);
+            markValue(desc->get);
+            markValue(desc->set);
+            break;
+        }
+        case NODOKA_CODE:
+            traceCode((nodoka_code *)data);
+            break;
+        case NODOKA_ENV: {
+            nodoka_envRec *env = (nodoka_envRec *)data;
+            markData(env->outer);
+            markData(env->object);
+            markValues(env->slots, env->slotCount);
+            markValue(env->this);
+            break;
+        }
+        case NODOKA_SHAPE: {
+            nodoka_shape *shape = (nodoka_shape *)data;
+            markData(shape->parent);
+            markData(shape->name);
+            break;
+        }
+        default: assert(0);
+    }
+}
+
+/* Only the frame slots and the operand stack below the top hold live values */
+static void markContext(nodoka_context *context) {
+    markData(context->env);
+    markData(context->code);
+    markData(context->constructed);
+    markData(context->this);
+    markValues(context->locals, context->code->localCount);
+    markValues(context->stack, context->stackTop - context->stack);
+}
+
+static void markRoots(nodoka_global *global) {
+    nodoka_object **objects[] = {
+        &global->global, &global->object, &global->Object_prototype,
+        &global->function, &global->Function_prototype,
+        &global->Array, &global->Array_prototype,
+        &global->String, &global->String_prototype,
+        &global->Error, &global->Error_prototype,
+        &global->ReferenceError, &global->ReferenceError_prototype,
+        &global->TypeError, &global->TypeError_prototype,
+        &global->RangeError, &global->RangeError_prototype,
+    };
+    for (size_t i = 0; i < sizeof(objects) / sizeof(objects[0]); i++) {
+        markData(*objects[i]);
+    }
+    for (nodoka_context *context = global->stack->context; context; context = context->prev) {
+        markContext(context);
+    }
+    nodoka_string *constants[] = {
+        nodoka_nullStr, nodoka_undefStr, nodoka_trueStr, nodoka_falseStr,
+        nodoka_nanStr, nodoka_infStr, nodoka_negInfStr, nodoka_zeroStr,
+        nodoka_lengthStr,
+    };
+    for (size_t i = 0; i < sizeof(constants) / sizeof(constants[0]); i++) {
+        markData(constants[i]);
+    }
+    for (size_t i = 0; i < 256; i++) {
+        markData(nodoka_charStrings[i]);
+    }
+    markData(nodoka_emptyShape);
+    for (size_t i = 0; i < rootLength; i++) {
+        markValue(*roots[i]);
+    }
+    for (nodoka_region *region = regions; region; region = region->next) {
+        for (nodoka_data *data = region->data; data; data = data->next) {
+            pushWork(&grey, data);
+        }
+    }
+}
+
+static void freeData(nodoka_data *data) {
+    switch (data->type) {
+        case NODOKA_STRING:
+            nodoka_freeString((nodoka_string *)data);
+            break;
+        case NODOKA_OBJECT: {
+            nodoka_object *obj = (nodoka_object *)data;
+            if (obj->prop) {
+                for (pair_t *it = hashmap_iterator(obj->prop); (it = hashmap_next(it));) {
+                    slab_free(it->second, sizeof(nodoka_property));
+                }
+                hashmap_dispose(obj->prop);
+            }
+            if (obj->slots != obj->inlineSlots) {
+                free(obj->slots);
+            }
+            free(obj->elements.values);
+            free(obj->boundArguments.array);
+            slab_free(obj, sizeof(nodoka_object));
+            break;
+        }
+        case NODOKA_CODE:
+            nodoka_disposeCode((nodoka_code *)data);
+            break;
+        case NODOKA_SHAPE: {
+            nodoka_shape *shape = (nodoka_shape *)data;
+            if (shape->transitions) {
+                hashmap_dispose(shape->transitions);
+            }
+            if (shape->table) {
+                hashmap_dispose(shape->table);
+            }
+            slab_free(shape, sizeof(nodoka_shape));
+            break;
+        }
+        case NODOKA_ENV:
+            free(((nodoka_envRec *)data)->slots);
+            slab_free(data, sizeof(nodoka_envRec));
+            break;
+        default:
+            slab_free(data, dataSize(data->type));
+            break;
+    }
+}
+
+static void startMarking(nodoka_global *global) {
+    /* Caches which refer to heap objects without keeping them alive */
+    nodoka_flushNumberStrings();
+    markRoots(global);
+    phase = PHASE_MARKING;
+    nodoka_gcMarking = true;
+}
+
+static void startSweeping(void) {
+    phase = PHASE_SWEEPING;
+    nodoka_gcMarking = false;
+    nodoka_sweepTransitions();
+    nodoka_sweepAtoms();
+    /* Inline caches could otherwise hit objects about to be freed */
+    nodoka_propertyEpoch++;
+    sweepList = heap;
+    sweepPtr = &sweepList;
+    heap = NULL;
+    live = 0;
+}
+
+static void finishSweeping(void) {
+    *sweepPtr = heap;
+    heap = sweepList;
+    sweepList = NULL;
+    phase = PHASE_IDLE;
+    stats.cycles++;
+    stats.liveSize = live;
+    /* Let the heap grow to twice its live size before the next collection */
+    nodoka_gcAllocated = 0;
+    threshold = live > MIN_THRESHOLD ? live : MIN_THRESHOLD;
+}
+
+static void markSlice(void) {
+    for (size_t i = 0; i < MARK_SLICE && grey.length; i++) {
+        trace(grey.data[--grey.length]);
+    }
+}
+
+/* Objects allocated meanwhile are not on the list being swept, and stay unmarked */
+static void sweepSlice(void) {
+    for (size_t i = 0; i < SWEEP_SLICE && *sweepPtr; i++) {
+        nodoka_data *data = *sweepPtr;
+        if (data->marked) {
+            data->marked = false;
+            live += dataSize(data->type);
+            nodoka_string *str = (nodoka_string *)data;
+            if (data->type == NODOKA_STRING && !str->left && !str->parent) {
+                live += str->oneByte ? str->value.len : str->value.len * sizeof(uint16_t);
+            }
+            sweepPtr = &data->next;
+        } else {
+            *sweepPtr = data->next;
+            freeData(data);
+        }
+    }
+}
+
+static void recordPause(clock_t start) {
+    double pause = (double)(clock() - start) * 1000000 / CLOCKS_PER_SEC;
+    size_t bucket = 0;
+    while (bucket < NODOKA_GC_PAUSE_BUCKETS - 1 && pause >= (double)(1 << bucket)) {
+        bucket++;
+    }
+    stats.pauses++;
+    stats.pauseHistogram[bucket]++;
+    stats.totalPause += pause;
+    if (pause > stats.maxPause) {
+        stats.maxPause = pause;
+    }
+}
+
+/*
+ * Empty the nursery, and advance the major collection by one step when
+ * enough has been allocated since the last one. The caller must make sure
+ * that every live value is either reachable from global, in a live context
+ * on its VM stack, or registered as a root: values held only in C locals
+ * are not seen. The interpreter therefore only collects at its safe points,
+ * see nodoka_exec.
+ */
+void nodoka_collectGarbage(nodoka_global *global) {
+    clock_t start = clock();
+    minorCollection(global);
+    stats.minorCollections++;
+    nodoka_gcPending = false;
+
+    switch (phase) {
+        case PHASE_IDLE:
+            if (nodoka_gcAllocated >= threshold) {
+                startMarking(global);
+            }
+            break;
+        case PHASE_MARKING:
+            markSlice();
+            if (!grey.length) {
+                startSweeping();
+            }
+            break;
+        case PHASE_SWEEPING:
+            sweepSlice();
+            if (!*sweepPtr) {
+                finishSweeping();
+            }
+            break;
+    }
+    nextStep = phase == PHASE_IDLE ? threshold : nodoka_gcAllocated + STEP_SIZE;
+    recordPause(start);
+}
+
+nodoka_region *nodoka_newRegion(void) {
+    nodoka_region *region = malloc(sizeof(nodoka_region));
+    region->memory = region_new();
+    region->data = NULL;
+    region->prev = NULL;
+    region->next = regions;
+    if (regions) {
+        regions->prev = region;
+    }
+    regions = region;
+    return region;
+}
+
+/*
+ * Release everything allocated in the region at once. Nothing outside of
+ * the region refers to its data, other than values held by the host, which
+ * have to be copied out first, see nodoka_copyFromRegion.
+ */
+void nodoka_disposeRegion(nodoka_region *region) {
+    assert(region != nodoka_currentRegion);
+    /* The worklist may hold data of the region, so finish marking first */
+    if (phase == PHASE_MARKING) {
+        while (grey.length) {
+            trace(grey.data[--grey.length]);
+        }
+    }
+    if (region->prev) {
+        region->prev->next = region->next;
+    } else {
+        regions = region->next;
+    }
+    if (region->next) {
+        region->next->prev = region->prev;
+    }
+    region_dispose(region->memory);
+    free(region);
+    /* Inline caches could otherwise hit data of the region */
+    nodoka_propertyEpoch++;
+}
+
+/* Objects know the region they are allocated in, see nodoka_newNativeObject */
+bool nodoka_inRegion(nodoka_region *region, nodoka_object *obj) {
+    return obj->region == region->memory;
+}
+
+/* Memory of the current region for the data hanging off its objects, or NULL */
+region_t *nodoka_regionMemory(void) {
+    return nodoka_currentRegion ? nodoka_currentRegion->memory : NULL;
+}
+
+/*
+ * Intern tables only hold strings weakly, so hand them out with this. While
+ * sweeping, the atoms left in the string pool are live already, and marking
+ * them would leave marks over to the next collection.
+ */
+nodoka_string *nodoka_resurrect(nodoka_string *str) {
+    if (phase == PHASE_MARKING) {
+        markData(str);
+    }
+    return str;
+}
+
+void nodoka_getGCStats(nodoka_gc_stats *result) {
+    *result = stats;
+}
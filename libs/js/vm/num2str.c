@@ -111,11 +111,11 @@ nodoka_string *nodoka_newStringFromDouble(double value) {
     bool neg = value < 0;
     sepFloatNum(neg ? -value : value, &S, &N, &K);
 
-    uint16_t *str;
+    uint8_t *str;
     size_t len;
     if (K <= N && N <= 21) {
         len = N + neg;
-        str = malloc(len * sizeof(uint16_t));
+        str = malloc(len);
         for (int i = K - 1; i >= 0; i--) {
             str[neg + i] = '0' + div64(&S, 10);
         }
@@ -124,7 +124,7 @@ nodoka_string *nodoka_newStringFromDouble(double value) {
         }
     } else if (0 < N && N <= 21) {
         len = K + 1 + neg;
-        str = malloc(len * sizeof(uint16_t));
+        str = malloc(len);
         str[neg + N] = '.';
         for (int i = K - 1; i >= N; i--) {
             str[neg + i + 1] = '0' + div64(&S, 10);
@@ -134,7 +134,7 @@ nodoka_string *nodoka_newStringFromDouble(double value) {
         }
     } else if (-6 < N && N <= 0) {
         len = N + K + 2 + neg;
-        str = malloc(len * sizeof(uint16_t));
+        str = malloc(len);
         str[neg] = '0';
         str[neg + 1] = '.';
         for (int i = 0; i < N; i++) {
@@ -148,8 +148,8 @@ nodoka_string *nodoka_newStringFromDouble(double value) {
         N = nNeg ? -N + 1 : N - 1;
         int expLen = countLen(N);
         len = expLen + neg + 3;
-        str = malloc(len * sizeof(uint16_t));
-        str[neg] = '0' + (uint16_t)S;
+        str = malloc(len);
+        str[neg] = '0' + (uint8_t)S;
         str[neg + 1] = 'e';
         str[neg + 2] = nNeg ? '-' : '+';
         for (int i = expLen - 1; i >= 0; i--) {
@@ -161,12 +161,12 @@ nodoka_string *nodoka_newStringFromDouble(double value) {
         N = nNeg ? -N + 1 : N - 1;
         int expLen = countLen(N);
         len = expLen + neg + K + 3;
-        str = malloc(len * sizeof(uint16_t));
+        str = malloc(len);
         str[neg + 1] = '.';
         for (int i = K - 1; i >= 1; i--) {
             str[neg + i + 1] = '0' + div64(&S, 10);
         }
-        str[neg] = '0' + (uint16_t)S;
+        str[neg] = '0' + (uint8_t)S;
         str[neg + K + 1] = 'e';
         str[neg + K + 2] = nNeg ? '-' : '+';
         for (int i = expLen - 1; i >= 0; i--) {
@@ -176,7 +176,7 @@ nodoka_string *nodoka_newStringFromDouble(double value) {
     }
     if (neg)
         str[0] = '-';
-    return nodoka_new_string((utf16_string_t) {
+    return nodoka_newLatin1String((latin1_string_t) {
         .str = str, .len = len
     });
 }
@@ -0,0 +1,129 @@
+#include "c/stdlib.h"
+
+#include "js/js.h"
+#include "js/bytecode.h"
+#include "js/object.h"
+
+#include "data-struct/hashmap.h"
+
+/**
+ * Create a context running code with everything it allocates in the region,
+ * until the region is disposed of by nodoka_disposeRegion. Declarations of
+ * the code, and names it assigns without declaring them, go to a record of
+ * the region in front of env. Storing data of the region anywhere outside of
+ * it, as in a property of the global object, throws a TypeError.
+ */
+nodoka_context *nodoka_newRegionContext(nodoka_region *region, nodoka_global *global, nodoka_envRec *env, nodoka_code *code) {
+    nodoka_region *outer = nodoka_currentRegion;
+    nodoka_currentRegion = region;
+    nodoka_envRec *rec = nodoka_newDeclEnvRecord(env);
+    nodoka_currentRegion = outer;
+
+    nodoka_context *context = nodoka_newContext(global, rec, code, global->global);
+    context->region = region;
+    return context;
+}
+
+struct copier {
+    nodoka_region *region;
+    /* Copies made so far, keyed by the data they are copies of */
+    hashmap_t *copies;
+};
+
+static bool copyValue(struct copier *copier, nodoka_value value, nodoka_value *ret);
+
+static bool copyProperty(struct copier *copier, nodoka_object *copy, nodoka_string *name, nodoka_property *prop) {
+    nodoka_prop_desc *desc = nodoka_newDescFromProperty(prop);
+    bool success = copyValue(copier, desc->value, &desc->value);
+    success = success && copyValue(copier, desc->get, &desc->get);
+    success = success && copyValue(copier, desc->set, &desc->set);
+    return success && nodoka_defineOwnProperty(copy, name, desc, false);
+}
+
+static bool copyObject(struct copier *copier, nodoka_object *obj, nodoka_object **ret) {
+    if (!obj || !nodoka_inRegion(copier->region, obj)) {
+        *ret = obj;
+        return true;
+    }
+    nodoka_object *copy = hashmap_get(copier->copies, obj);
+    if (copy) {
+        *ret = copy;
+        return true;
+    }
+    /* Functions are bound to their scope, which is in the region */
+    if (obj->call || obj->construct) {
+        return false;
+    }
+    copy = nodoka_newNativeObject();
+    hashmap_put(copier->copies, obj, copy);
+    copy->_class = obj->_class;
+    copy->getOwnProperty = obj->getOwnProperty;
+    copy->primitiveValue = obj->primitiveValue;
+
+    bool success = copyObject(copier, obj->prototype, &copy->prototype);
+    if (obj->shape) {
+        /* Add the properties in the same order, for the copy to get the same shape */
+        nodoka_string **names = malloc(obj->shape->count * sizeof(nodoka_string *));
+        for (nodoka_shape *shape = obj->shape; shape->name; shape = shape->parent) {
+            names[shape->count - 1] = shape->name;
+        }
+        for (uint32_t i = 0; i < obj->shape->count && success; i++) {
+            success = copyProperty(copier, copy, names[i], &obj->slots[i]);
+        }
+        free(names);
+    } else {
+        for (pair_t *it = hashmap_iterator(obj->prop); (it = hashmap_next(it));) {
+            success = success && copyProperty(copier, copy, it->first, it->second);
+        }
+    }
+    if (obj->elementsKind != NODOKA_ELEMENTS_NONE) {
+        /* Dictionary elements were copied as properties */
+        if (obj->elementsKind == NODOKA_ELEMENTS_DICTIONARY) {
+            copy->elementsKind = NODOKA_ELEMENTS_DICTIONARY;
+        } else {
+            copy->elementsKind = NODOKA_ELEMENTS_PACKED;
+            copy->elementsType = NODOKA_ELEMENTS_INT32;
+        }
+        for (uint32_t i = 0; i < obj->elementsCapacity && success; i++) {
+            nodoka_value value = nodoka_getElement(obj, i);
+            if (value && (success = copyValue(copier, value, &value))) {
+                nodoka_putElement(copy, i, value);
+            }
+        }
+        nodoka_setArrayLength(copy, obj->length);
+    }
+    /* Properties are added before, as they could not be otherwise */
+    copy->extensible = obj->extensible;
+    *ret = copy;
+    return success;
+}
+
+static bool copyValue(struct copier *copier, nodoka_value value, nodoka_value *ret) {
+    /* Strings are never allocated in a region */
+    if (!nodoka_isObject(value)) {
+        *ret = value;
+        return true;
+    }
+    nodoka_object *copy;
+    if (!copyObject(copier, nodoka_unbox(value), &copy)) {
+        return false;
+    }
+    *ret = nodoka_box(copy);
+    return true;
+}
+
+/**
+ * Copy a value, and the objects of the region reachable from it, to the
+ * heap, so that it outlives the region. Fails if a function of the region
+ * is reachable, as its scope cannot be copied.
+ */
+bool nodoka_copyFromRegion(nodoka_region *region, nodoka_value value, nodoka_value *ret) {
+    assert(!nodoka_currentRegion);
+    struct copier copier = {
+        .region = region,
+        .copies = hashmap_new_pointer(31),
+    };
+    bool success = copyValue(&copier, value, ret);
+    hashmap_dispose(copier.copies);
+    return success;
+}
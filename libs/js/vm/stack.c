@@ -0,0 +1,94 @@
+#include "c/assert.h"
+#include "c/stdlib.h"
+
+#include "js/js.h"
+#include "js/bytecode.h"
+
+enum {
+    SEGMENT_SIZE = 64 * 1024,
+};
+
+struct nodoka_stack_segment {
+    struct nodoka_stack_segment *prev;
+    struct nodoka_stack_segment *next;
+    /* Top of the previous segment when this one was entered */
+    nodoka_value *savedTop;
+    size_t size;
+    nodoka_value data[];
+};
+
+static struct nodoka_stack_segment *newSegment(struct nodoka_stack_segment *prev, size_t size) {
+    struct nodoka_stack_segment *seg = malloc(sizeof(struct nodoka_stack_segment) + size * sizeof(nodoka_value));
+    seg->prev = prev;
+    seg->next = NULL;
+    seg->savedTop = NULL;
+    seg->size = size;
+    return seg;
+}
+
+static void enterSegment(nodoka_stack *stack, struct nodoka_stack_segment *seg) {
+    stack->segment = seg;
+    stack->top = seg->data;
+    stack->limit = seg->data + seg->size;
+}
+
+nodoka_stack *nodoka_newStack(void) {
+    nodoka_stack *stack = malloc(sizeof(nodoka_stack));
+    enterSegment(stack, newSegment(NULL, SEGMENT_SIZE));
+    stack->depth = 0;
+    stack->context = NULL;
+    return stack;
+}
+
+/* Move to the next segment, which is kept around once it has been used */
+static void growStack(nodoka_stack *stack, size_t size) {
+    struct nodoka_stack_segment *cur = stack->segment;
+    struct nodoka_stack_segment *seg = cur->next;
+    if (seg && seg->size < size) {
+        while (seg) {
+            struct nodoka_stack_segment *next = seg->next;
+            free(seg);
+            seg = next;
+        }
+    }
+    if (!seg) {
+        seg = newSegment(cur, size > SEGMENT_SIZE ? size : SEGMENT_SIZE);
+        cur->next = seg;
+    }
+    seg->savedTop = stack->top;
+    enterSegment(stack, seg);
+}
+
+/**
+ * Push a frame of size values, with the arguments as its first values. When
+ * the arguments are the last values pushed, as is the case for calls made
+ * by the interpreter, the frame starts at them and nothing is copied.
+ */
+nodoka_value *nodoka_pushFrame(nodoka_stack *stack, size_t size, int argc, nodoka_value *argv) {
+    /* A frame starting a segment is taken as the one which entered it, see nodoka_popFrame */
+    if (argv && argv + argc == stack->top && argv > stack->segment->data && argv + size <= stack->limit) {
+        stack->top = argv + size;
+        return argv;
+    }
+    if (stack->top + size > stack->limit) {
+        growStack(stack, size);
+    }
+    nodoka_value *frame = stack->top;
+    for (int i = 0; i < argc && i < size; i++) {
+        frame[i] = argv[i];
+    }
+    stack->top = frame + size;
+    return frame;
+}
+
+void nodoka_popFrame(nodoka_stack *stack, nodoka_value *frame) {
+    struct nodoka_stack_segment *seg = stack->segment;
+    assert(frame >= seg->data && frame <= stack->top);
+    if (frame == seg->data && seg->prev) {
+        stack->segment = seg->prev;
+        stack->top = seg->savedTop;
+        stack->limit = seg->prev->data + seg->prev->size;
+    } else {
+        stack->top = frame;
+    }
+}
@@ -21,13 +21,13 @@ enum {
     ZWJ = 0x200D
 };
 
-nodoka_number *nodoka_str2num(nodoka_string *str) {
+nodoka_value nodoka_str2num(nodoka_string *str) {
     if (str->numberCache) {
         return str->numberCache;
     }
     size_t ptr = 0;
     for (; ptr < str->value.len; ptr++) {
-        uint16_t cha = str->value.str[ptr];
+        uint16_t cha = nodoka_charAt(str, ptr);
         switch (cha) {
             case TAB:
             case VT:
@@ -49,14 +49,14 @@ nodoka_number *nodoka_str2num(nodoka_string *str) {
         return nodoka_nan;
     }
     bool sign = true;
-    switch (str->value.str[ptr]) {
+    switch (nodoka_charAt(str, ptr)) {
         case '0': {
             if (ptr + 1 < str->value.len) {
-                if (str->value.str[ptr + 1] == 'x' || str->value.str[ptr + 1] == 'X') {
+                if (nodoka_charAt(str, ptr + 1) == 'x' || nodoka_charAt(str, ptr + 1) == 'X') {
                     bool invalid = true;
                     double base = 0;
                     for (ptr += 2; ptr < str->value.len; ptr++) {
-                        uint16_t cha = str->value.str[ptr];
+                        uint16_t cha = nodoka_charAt(str, ptr);
                         if (cha >= '0' && cha <= '9') {
                             invalid = false;
                             base = base * 16 + (cha - '0');
@@ -71,7 +71,7 @@ nodoka_number *nodoka_str2num(nodoka_string *str) {
                         }
                     }
                     for (ptr += 8; ptr < str->value.len; ptr++) {
-                        uint16_t cha = str->value.str[ptr];
+                        uint16_t cha = nodoka_charAt(str, ptr);
                         switch (cha) {
                             case TAB:
                             case VT:
@@ -93,7 +93,7 @@ nodoka_number *nodoka_str2num(nodoka_string *str) {
                         str->numberCache = nodoka_nan;
                         return nodoka_nan;
                     }
-                    str->numberCache = nodoka_newNumber(base);
+                    str->numberCache = nodoka_fromNumber(base);
                     return str->numberCache;
                 } else {
                     break;
@@ -107,16 +107,16 @@ nodoka_number *nodoka_str2num(nodoka_string *str) {
         case '-': ptr++; sign = false; break;
     }
     if (ptr + 7 < str->value.len &&
-            str->value.str[ptr] == 'I' &&
-            str->value.str[ptr + 1] == 'n' &&
-            str->value.str[ptr + 2] == 'f' &&
-            str->value.str[ptr + 3] == 'i' &&
-            str->value.str[ptr + 4] == 'n' &&
-            str->value.str[ptr + 5] == 'i' &&
-            str->value.str[ptr + 6] == 't' &&
-            str->value.str[ptr + 7] == 'y') {
+            nodoka_charAt(str, ptr) == 'I' &&
+            nodoka_charAt(str, ptr + 1) == 'n' &&
+            nodoka_charAt(str, ptr + 2) == 'f' &&
+            nodoka_charAt(str, ptr + 3) == 'i' &&
+            nodoka_charAt(str, ptr + 4) == 'n' &&
+            nodoka_charAt(str, ptr + 5) == 'i' &&
+            nodoka_charAt(str, ptr + 6) == 't' &&
+            nodoka_charAt(str, ptr + 7) == 'y') {
         for (ptr += 8; ptr < str->value.len; ptr++) {
-            uint16_t cha = str->value.str[ptr];
+            uint16_t cha = nodoka_charAt(str, ptr);
             switch (cha) {
                 case TAB:
                 case VT:
@@ -134,7 +134,7 @@ nodoka_number *nodoka_str2num(nodoka_string *str) {
                 return nodoka_nan;
             }
         }
-        str->numberCache = nodoka_newNumber((sign ? 1 : -1) / 0.0);
+        str->numberCache = nodoka_fromNumber((sign ? 1 : -1) / 0.0);
         return str->numberCache;
     } else {
         double base = 0;
@@ -143,7 +143,7 @@ nodoka_number *nodoka_str2num(nodoka_string *str) {
         uint16_t litPower = 0;
         bool invalid = true;
         for (; ptr < str->value.len; ptr++) {
-            uint16_t cha = str->value.str[ptr];
+            uint16_t cha = nodoka_charAt(str, ptr);
             if (cha >= '0' && cha <= '9') {
                 invalid = false;
                 base = base * 10 + (cha - '0');
@@ -160,7 +160,7 @@ nodoka_number *nodoka_str2num(nodoka_string *str) {
         goto finish;
 decimalPoint:
         for (; ptr < str->value.len; ptr++) {
-            uint16_t cha = str->value.str[ptr];
+            uint16_t cha = nodoka_charAt(str, ptr);
             if (cha >= '0' && cha <= '9') {
                 invalid = false;
                 base = base * 10 + (cha - '0');
@@ -175,13 +175,13 @@ decimalPoint:
         goto finish;
 exponential:
         if (ptr < str->value.len) {
-            switch (str->value.str[ptr]) {
+            switch (nodoka_charAt(str, ptr)) {
                 case '+': ptr++; break;
                 case '-': litPowerSign = false; ptr++; break;
             }
         }
         for (; ptr < str->value.len; ptr++) {
-            uint16_t cha = str->value.str[ptr];
+            uint16_t cha = nodoka_charAt(str, ptr);
             if (cha >= '0' && cha <= '9') {
                 base = base * 10 + cha - '0';
                 power++;
@@ -195,7 +195,7 @@ finish:
             return nodoka_nan;
         }
         for (; ptr < str->value.len; ptr++) {
-            uint16_t cha = str->value.str[ptr];
+            uint16_t cha = nodoka_charAt(str, ptr);
             switch (cha) {
                 case TAB:
                 case VT:
@@ -213,7 +213,7 @@ finish:
                 return nodoka_nan;
             }
         }
-        str->numberCache = nodoka_newNumber((sign ? 1 : -1) * base * pow(10, -power + (litPowerSign ? litPower : -litPower)));
+        str->numberCache = nodoka_fromNumber((sign ? 1 : -1) * base * pow(10, -power + (litPowerSign ? litPower : -litPower)));
         return str->numberCache;
     }
 }
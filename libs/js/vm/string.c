@@ -7,6 +7,7 @@
 
 #include "unicode/hash.h"
 #include "data-struct/hashmap.h"
+#include "data-struct/slab.h"
 #include "util/double.h"
 
 hashmap_t *utf8Hashmap;
@@ -37,21 +38,209 @@ int nodoka_hashNumber(void *a) {
 
 void nodoka_initStringPool(void) {
     utf8Hashmap = hashmap_new_string(11);
-    strHashmap = hashmap_new(unicode_utf16Hash, unicode_utf16Cmp, 11);
+    strHashmap = hashmap_new(nodoka_hashString, nodoka_compareString, 11);
     num2strMap = hashmap_new(nodoka_hashNumber, nodoka_compareNumber, 11);
 }
 
+static bool fitsOneByte(uint16_t *str, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (str[i] > 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void narrow(uint8_t *dest, uint16_t *src, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        dest[i] = src[i];
+    }
+}
+
+static void widen(uint16_t *dest, uint8_t *src, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        dest[i] = src[i];
+    }
+}
+
+static nodoka_string *newString(bool oneByte, void *str, size_t len) {
+    nodoka_string *string = (nodoka_string *)nodoka_new_data(NODOKA_STRING);
+    string->value.str = str;
+    string->value.len = len;
+    string->oneByte = oneByte;
+    string->atom = false;
+    string->hash = 0;
+    string->numberCache = nodoka_empty;
+    string->left = NULL;
+    string->right = NULL;
+    nodoka_gcAllocated += oneByte ? len : len * sizeof(uint16_t);
+    return string;
+}
+
+/* Plain one-byte string taking over the contents of str */
+nodoka_string *nodoka_newLatin1String(latin1_string_t str) {
+    return newString(true, str.str, str.len);
+}
+
+/* Plain string taking over the contents of str, which are narrowed if they fit in one byte each */
 nodoka_string *nodoka_new_string(utf16_string_t str) {
-    nodoka_string *get = hashmap_get(strHashmap, &str);
+    if (!fitsOneByte(str.str, str.len)) {
+        return newString(false, str.str, str.len);
+    }
+    uint8_t *bytes = malloc(str.len);
+    narrow(bytes, str.str, str.len);
+    free(str.str);
+    return newString(true, bytes, str.len);
+}
+
+static int hashContents(nodoka_string *str) {
+    return str->oneByte ? unicode_latin1Hash(&str->latin1) : unicode_utf16Hash(&str->value);
+}
+
+/* Atom with the contents of key if there is one, where key is a plain string standing for it */
+static nodoka_string *findAtom(nodoka_string *key) {
+    key->hash = hashContents(key);
+    return hashmap_get(strHashmap, key);
+}
+
+static nodoka_string *addAtom(nodoka_string *string, int hash) {
+    string->atom = true;
+    string->hash = hash;
+    hashmap_put(strHashmap, string, string);
+    return string;
+}
+
+/* Atom with the contents of str, which it takes over */
+nodoka_string *nodoka_newAtom(utf16_string_t str) {
+    nodoka_string key = {
+        .value = str
+    };
+    nodoka_string *get = findAtom(&key);
     if (get) {
         free(str.str);
-        return get;
+        return nodoka_resurrect(get);
+    }
+    return addAtom(nodoka_new_string(str), key.hash);
+}
+
+/* Slow path of nodoka_toAtom. A plain string which has no atom yet becomes one */
+nodoka_string *nodoka_intern(nodoka_string *str) {
+    str = nodoka_flatten(str);
+    if (str->atom) {
+        return str;
+    }
+    str->hash = hashContents(str);
+    nodoka_string *get = hashmap_get(strHashmap, str);
+    if (get) {
+        return nodoka_resurrect(get);
+    }
+    /* Atoms have contents of their own, which the collector never has to trace */
+    if (str->parent) {
+        size_t size = str->oneByte ? str->value.len : str->value.len * sizeof(uint16_t);
+        void *contents = malloc(size);
+        memcpy(contents, str->value.str, size);
+        nodoka_writeBarrier(nodoka_box(str->parent));
+        str->value.str = contents;
+        str->parent = NULL;
+        nodoka_gcAllocated += size;
+    }
+    return addAtom(str, str->hash);
+}
+
+/* Equality of contents, which is identity for atoms */
+bool nodoka_equalString(nodoka_string *x, nodoka_string *y) {
+    if (x == y) {
+        return true;
+    }
+    /* Strings kept differently cannot have the same contents */
+    if ((x->atom && y->atom) || x->value.len != y->value.len || x->oneByte != y->oneByte) {
+        return false;
+    }
+    x = nodoka_flatten(x);
+    y = nodoka_flatten(y);
+    return !memcmp(x->value.str, y->value.str, x->oneByte ? x->value.len : x->value.len * sizeof(uint16_t));
+}
+
+/* Order of the contents of two flat strings, by code units */
+int nodoka_compareContents(nodoka_string *x, nodoka_string *y) {
+    size_t len = x->value.len < y->value.len ? x->value.len : y->value.len;
+    if (x->oneByte && y->oneByte) {
+        int diff = memcmp(x->latin1.str, y->latin1.str, len);
+        if (diff) {
+            return diff;
+        }
+    } else {
+        for (size_t i = 0; i < len; i++) {
+            int diff = nodoka_charAt(x, i) - nodoka_charAt(y, i);
+            if (diff) {
+                return diff;
+            }
+        }
+    }
+    return x->value.len < y->value.len ? -1 : x->value.len > y->value.len;
+}
+
+/* Copy of the contents of str as UTF-16, which the caller frees */
+utf16_string_t nodoka_toUtf16(nodoka_string *str) {
+    str = nodoka_flatten(str);
+    utf16_string_t ret = {
+        .len = str->value.len,
+        .str = malloc(str->value.len * sizeof(uint16_t))
+    };
+    if (str->oneByte) {
+        widen(ret.str, str->latin1.str, ret.len);
+    } else {
+        memcpy(ret.str, str->value.str, ret.len * sizeof(uint16_t));
+    }
+    return ret;
+}
+
+void nodoka_fputString(FILE *file, nodoka_string *str) {
+    str = nodoka_flatten(str);
+    if (str->oneByte) {
+        unicode_fputLatin1(file, str->latin1);
+    } else {
+        unicode_fputUtf16(file, str->value);
+    }
+}
+
+/*
+ * Drop the atoms which are not marked from the string pool, once marking is
+ * complete and before they are swept, so that the atoms it hands out while
+ * sweeping are all live.
+ */
+void nodoka_sweepAtoms(void) {
+    for (pair_t *it = hashmap_iterator(strHashmap); (it = hashmap_next(it));) {
+        if (!((nodoka_string *)it->first)->base.marked) {
+            hashmap_remove(strHashmap, it->first);
+        }
+    }
+    /* The cache of nodoka_newStringFromUtf8 holds atoms too */
+    for (pair_t *it = hashmap_iterator(utf8Hashmap); (it = hashmap_next(it));) {
+        if (!((nodoka_string *)it->second)->base.marked) {
+            char *key = it->first;
+            hashmap_remove(utf8Hashmap, key);
+            free(key);
+        }
     }
-    nodoka_string *string = (nodoka_string *)nodoka_new_data(NODOKA_STRING);
-    string->value = str;
-    string->numberCache = NULL;
-    hashmap_put(strHashmap, &string->value, string);
-    return string;
+}
+
+/* Called by the collector, after nodoka_sweepAtoms dropped the string from the string pool */
+void nodoka_freeString(nodoka_string *str) {
+    /* Ropes and substrings have no contents of their own */
+    if (!str->left && !str->parent) {
+        free(str->value.str);
+    }
+    slab_free(str, sizeof(nodoka_string));
+}
+
+/* Drop the cache of nodoka_num2str, whose strings might not survive a collection */
+void nodoka_flushNumberStrings(void) {
+    for (pair_t *it = hashmap_iterator(num2strMap); (it = hashmap_next(it));) {
+        slab_free(it->first, sizeof(double));
+    }
+    hashmap_dispose(num2strMap);
+    num2strMap = hashmap_new(nodoka_hashNumber, nodoka_compareNumber, 11);
 }
 
 nodoka_string *nodoka_num2str(double val) {
@@ -59,49 +248,233 @@ nodoka_string *nodoka_num2str(double val) {
     if (ret) {
         return ret;
     }
-    double *ptr = malloc(sizeof(double));
+    double *ptr = slab_alloc(sizeof(double));
     *ptr = val;
     ret = nodoka_newStringFromDouble(val);
     hashmap_put(num2strMap, ptr, ret);
     return ret;
 }
 
+/* Atom with the contents of str, which are only copied if there is no such atom yet */
 nodoka_string *nodoka_newStringDup(utf16_string_t str) {
-    utf16_string_t dup = {
-        .len = str.len,
-        .str = malloc(sizeof(uint16_t) * str.len)
+    nodoka_string key = {
+        .value = str
     };
-    memcpy(dup.str, str.str, sizeof(uint16_t) * str.len);
-    return nodoka_new_string(dup);
+    nodoka_string *get = findAtom(&key);
+    if (get) {
+        return nodoka_resurrect(get);
+    }
+    nodoka_string *string;
+    if (fitsOneByte(str.str, str.len)) {
+        uint8_t *bytes = malloc(str.len);
+        narrow(bytes, str.str, str.len);
+        string = newString(true, bytes, str.len);
+    } else {
+        uint16_t *dup = malloc(sizeof(uint16_t) * str.len);
+        memcpy(dup, str.str, sizeof(uint16_t) * str.len);
+        string = newString(false, dup, str.len);
+    }
+    return addAtom(string, key.hash);
 }
 
 nodoka_string *nodoka_newStringFromUtf8(char *str) {
     nodoka_string *get = hashmap_get(utf8Hashmap, str);
     if (get) {
-        return get;
+        return nodoka_resurrect(get);
+    }
+    nodoka_string key = {
+        .latin1 = {.str = (uint8_t *)str, .len = strlen(str)},
+        .oneByte = true
+    };
+    for (size_t i = 0; i < key.value.len; i++) {
+        if (key.latin1.str[i] >= 0x80) {
+            key.oneByte = false;
+        }
+    }
+    /* ASCII, which nearly all of these are, is its own one-byte string */
+    nodoka_string *string;
+    if (!key.oneByte) {
+        string = nodoka_newAtom(unicode_toUtf16(UTF8_STRING(str)));
+    } else if ((string = findAtom(&key))) {
+        string = nodoka_resurrect(string);
+    } else {
+        uint8_t *bytes = malloc(key.value.len);
+        memcpy(bytes, str, key.value.len);
+        string = addAtom(newString(true, bytes, key.value.len), key.hash);
     }
-    nodoka_string *string = nodoka_new_string(unicode_toUtf16(UTF8_STRING(str)));
-    hashmap_put(utf8Hashmap, str, get);
+    /* Callers may free str, so the cache keeps a copy of it */
+    char *copy = malloc(key.value.len + 1);
+    memcpy(copy, str, key.value.len + 1);
+    hashmap_put(utf8Hashmap, copy, string);
     return string;
 }
 
+/* Copy the contents of a flat string as two-byte code units */
+static void copyUnits(uint16_t *dest, nodoka_string *str) {
+    if (str->oneByte) {
+        widen(dest, str->latin1.str, str->value.len);
+    } else {
+        memcpy(dest, str->value.str, str->value.len * sizeof(uint16_t));
+    }
+}
+
 nodoka_string *nodoka_concatString(size_t num, ...) {
     va_list ap;
     va_start(ap, num);
     nodoka_string *strs[num];
     size_t len = 0;
+    bool oneByte = true;
     for (size_t i = 0; i < num; i++) {
-        strs[i] = va_arg(ap, nodoka_string *);
+        strs[i] = nodoka_flatten(va_arg(ap, nodoka_string *));
         len += strs[i]->value.len;
+        oneByte = oneByte && strs[i]->oneByte;
+    }
+    va_end(ap);
+    if (oneByte) {
+        uint8_t *str = malloc(len);
+        size_t ptr = 0;
+        for (size_t i = 0; i < num; i++) {
+            memcpy(str + ptr, strs[i]->latin1.str, strs[i]->value.len);
+            ptr += strs[i]->value.len;
+        }
+        return newString(true, str, len);
     }
     uint16_t *str = malloc(len * sizeof(uint16_t));
     size_t ptr = 0;
     for (size_t i = 0; i < num; i++) {
-        memcpy(str + ptr, strs[i]->value.str, strs[i]->value.len * sizeof(uint16_t));
+        copyUnits(str + ptr, strs[i]);
         ptr += strs[i]->value.len;
     }
-    va_end(ap);
-    return nodoka_new_string((utf16_string_t) {
-        .str = str, .len = len
-    });
+    return newString(false, str, len);
+}
+
+/* Concatenation of two strings, whose contents are only copied once they are needed */
+nodoka_string *nodoka_newRope(nodoka_string *left, nodoka_string *right) {
+    if (!left->value.len) {
+        return right;
+    }
+    if (!right->value.len) {
+        return left;
+    }
+    size_t len = left->value.len + right->value.len;
+    if (len < NODOKA_MIN_ROPE_LENGTH) {
+        return nodoka_concatString(2, left, right);
+    }
+    nodoka_string *rope = (nodoka_string *)nodoka_new_data(NODOKA_STRING);
+    rope->value.str = NULL;
+    rope->value.len = len;
+    rope->oneByte = left->oneByte && right->oneByte;
+    rope->atom = false;
+    rope->hash = 0;
+    rope->numberCache = nodoka_empty;
+    rope->left = left;
+    rope->right = right;
+    return rope;
+}
+
+/*
+ * Copy the leaves of a rope into place from the end, walking right halves
+ * first and keeping the left ones for later. Ropes built by appending lean
+ * to the left, so that little has to be kept for them.
+ */
+nodoka_string *nodoka_flattenRope(nodoka_string *rope) {
+    if (!rope->right) {
+        return rope->left;
+    }
+    size_t len = rope->value.len;
+    bool oneByte = rope->oneByte;
+    void *str = malloc(oneByte ? len : len * sizeof(uint16_t));
+    size_t depth = 0;
+    size_t capacity = 16;
+    nodoka_string **pending = malloc(capacity * sizeof(nodoka_string *));
+    nodoka_string *node = rope;
+    for (;;) {
+        if (node->left && node->right) {
+            if (depth == capacity) {
+                capacity *= 2;
+                pending = realloc(pending, capacity * sizeof(nodoka_string *));
+            }
+            pending[depth++] = node->left;
+            node = node->right;
+            continue;
+        }
+        /* A flat string, or a rope which was flattened already */
+        nodoka_string *leaf = node->left ? node->left : node;
+        len -= leaf->value.len;
+        if (oneByte) {
+            memcpy((uint8_t *)str + len, leaf->latin1.str, leaf->value.len);
+        } else {
+            copyUnits((uint16_t *)str + len, leaf);
+        }
+        if (!depth) {
+            break;
+        }
+        node = pending[--depth];
+    }
+    free(pending);
+    nodoka_string *flat = newString(oneByte, str, rope->value.len);
+    nodoka_writeBarrier(nodoka_box(rope->left));
+    nodoka_writeBarrier(nodoka_box(rope->right));
+    rope->left = flat;
+    rope->right = NULL;
+    return flat;
+}
+
+/* String of the code unit, which is one of nodoka_charStrings if it fits in a byte */
+nodoka_string *nodoka_newCharString(uint16_t unit) {
+    if (unit <= 0xFF) {
+        return nodoka_charStrings[unit];
+    }
+    uint16_t *str = malloc(sizeof(uint16_t));
+    str[0] = unit;
+    return newString(false, str, 1);
+}
+
+/*
+ * The len code units of str from start. Unless there are only a few of
+ * them, the substring shares the contents of str, or of the string it is
+ * itself a substring of, instead of copying them.
+ */
+nodoka_string *nodoka_newSubstring(nodoka_string *str, size_t start, size_t len) {
+    str = nodoka_flatten(str);
+    assert(start + len <= str->value.len);
+    if (len == str->value.len) {
+        return str;
+    }
+    if (len == 1) {
+        return nodoka_newCharString(nodoka_charAt(str, start));
+    }
+    if (str->oneByte) {
+        if (len < NODOKA_MIN_SUBSTRING_LENGTH) {
+            uint8_t *bytes = malloc(len);
+            memcpy(bytes, str->latin1.str + start, len);
+            return newString(true, bytes, len);
+        }
+    } else {
+        /* Which keeps the units of two-byte strings above 0xFF */
+        if (fitsOneByte(str->value.str + start, len)) {
+            uint8_t *bytes = malloc(len);
+            narrow(bytes, str->value.str + start, len);
+            return newString(true, bytes, len);
+        }
+        if (len < NODOKA_MIN_SUBSTRING_LENGTH) {
+            uint16_t *units = malloc(len * sizeof(uint16_t));
+            memcpy(units, str->value.str + start, len * sizeof(uint16_t));
+            return newString(false, units, len);
+        }
+    }
+    nodoka_string *substring = (nodoka_string *)nodoka_new_data(NODOKA_STRING);
+    if (str->oneByte) {
+        substring->latin1.str = str->latin1.str + start;
+    } else {
+        substring->value.str = str->value.str + start;
+    }
+    substring->value.len = len;
+    substring->oneByte = str->oneByte;
+    substring->atom = false;
+    substring->hash = 0;
+    substring->numberCache = nodoka_empty;
+    substring->left = NULL;
+    substring->parent = str->parent ? str->parent : str;
+    return substring;
 }
@@ -4,103 +4,91 @@
 
 #include "util/double.h"
 
-#include "unicode/hash.h"
-
 #include "js/js.h"
 #include "js/bytecode.h"
 #include "js/object.h"
 #include "js/builtin.h"
 
-nodoka_context *nodoka_newContext(nodoka_global *global, nodoka_envRec *env, nodoka_code *code, nodoka_object *this) {
-    nodoka_context *context = malloc(sizeof(nodoka_context));
+enum {
+    /* Number of values taken by the context itself */
+    CONTEXT_SIZE = (sizeof(nodoka_context) + sizeof(nodoka_value) - 1) / sizeof(nodoka_value),
+};
+
+/*
+ * Push a frame and set up an activation in it. The arguments become the
+ * first frame slots; filling the remaining ones is left to the caller.
+ */
+nodoka_context *nodoka_pushContext(nodoka_global *global, nodoka_envRec *env, nodoka_code *code, nodoka_object *this, int argc, nodoka_value *argv) {
+    nodoka_value *frame = nodoka_pushFrame(global->stack, code->localCount + CONTEXT_SIZE + code->stackSize, argc, argv);
+    nodoka_context *context = (nodoka_context *)(frame + code->localCount);
     context->global = global;
     context->env = env;
     context->code = code;
-    context->stack = malloc(sizeof(nodoka_data *) * 128);
+    context->caller = NULL;
+    context->constructed = NULL;
+    context->frame = frame;
+    context->locals = frame;
+    context->stack = frame + code->localCount + CONTEXT_SIZE;
     context->stackTop = context->stack;
-    context->stackLimit = context->stack + 128;
+    context->stackLimit = context->stack + code->stackSize;
     context->this = this;
     context->insPtr = 0;
-    context->catchPtr = (size_t)(-1);
+    context->region = NULL;
+    context->prev = global->stack->context;
+    global->stack->context = context;
+    global->stack->depth++;
     return context;
 }
 
-void nodoka_disposeContext(nodoka_context *context) {
-    free(context->stack);
-    free(context);
-}
-
-static nodoka_data *nodoka_pop(nodoka_context *context) {
-    assert(context->stackTop > context->stack);
-    nodoka_data *ret = *(--context->stackTop);
-    return ret;
-}
-
-static void nodoka_push(nodoka_context *context, nodoka_data *data) {
-    assert(context->stackTop < context->stackLimit);
-    *(context->stackTop++) = data;
-}
-
-static uint8_t fetchByte(nodoka_context *context) {
-    assert(context->insPtr < context->code->bytecodeLength);
-    return context->code->bytecode[context->insPtr++];
-}
-
-static uint16_t fetch16(nodoka_context *context) {
-    uint16_t ret = fetchByte(context) << 8;
-    ret |= fetchByte(context);
-    return ret;
-}
-
-static uint32_t fetch32(nodoka_context *context) {
-    uint32_t ret = fetch16(context) << 16;
-    ret |= fetch16(context);
-    return ret;
-}
-
-static uint64_t fetch64(nodoka_context *context) {
-    uint64_t ret = (uint64_t)fetch32(context) << 32;
-    ret |= fetch32(context);
-    return ret;
+nodoka_context *nodoka_newContext(nodoka_global *global, nodoka_envRec *env, nodoka_code *code, nodoka_object *this) {
+    nodoka_context *context = nodoka_pushContext(global, env, code, this, 0, NULL);
+    for (size_t i = 0; i < code->localCount; i++) {
+        context->locals[i] = nodoka_undefined;
+    }
+    return context;
 }
 
-
-static void throwError(nodoka_context *context, nodoka_data *data) {
-    nodoka_push(context, data);
+void nodoka_disposeContext(nodoka_context *context) {
+    nodoka_stack *stack = context->global->stack;
+    assert(stack->context == context);
+    stack->context = context->prev;
+    stack->depth--;
+    nodoka_popFrame(stack, context->frame);
 }
 
-static void throwTypeError(nodoka_context *context, char *msg) {
-    throwError(context, (nodoka_data *)nodoka_newTypeError(context->global, msg ? nodoka_newStringFromUtf8(msg) : NULL));
+static nodoka_value referenceError(nodoka_context *context, nodoka_string *msg) {
+    return nodoka_box(nodoka_newReferenceError(context->global, msg));
 }
 
-static void throwReferenceError(nodoka_context *context, nodoka_string *msg) {
-    throwError(context, (nodoka_data *)nodoka_newReferenceError(context->global, msg));
+/* Thrown when a store is rejected by nodoka_escapesRegion */
+static nodoka_value regionEscapeError(nodoka_context *context) {
+    return nodoka_box(nodoka_newTypeError(context->global, nodoka_newStringFromUtf8("Cannot store data of a region outside of it")));
 }
 
 __attribute__((deprecated))
-static void throwString(nodoka_context *context, char *str) {
+static nodoka_value errorString(char *str) {
     //TODO We need to throw error actually, this works only temporarily
-    throwError(context, (nodoka_data *)nodoka_newStringFromUtf8(str));
+    return nodoka_box(nodoka_newStringFromUtf8(str));
 }
 
-int8_t nodoka_absRelComp(nodoka_data *sp1, nodoka_data *sp0) {
+int8_t nodoka_absRelComp(nodoka_value sp1, nodoka_value sp0) {
     assertPrimitive(sp1);
     assertPrimitive(sp0);
-    if (sp1->type != NODOKA_STRING || sp0->type != NODOKA_STRING) {
-        nodoka_number *nx = (nodoka_number *)nodoka_toNumber(sp1);
-        nodoka_number *ny = (nodoka_number *)nodoka_toNumber(sp0);
-        if (isnan(nx->value) || isnan(ny->value)) {
+    if (!nodoka_isString(sp1) || !nodoka_isString(sp0)) {
+        double nx = nodoka_toNumber(sp1);
+        double ny = nodoka_toNumber(sp0);
+        if (isnan(nx) || isnan(ny)) {
             return -1;
         }
-        if (nx->value < ny->value) {
+        if (nx < ny) {
             return 1;
         } else {
             return 0;
         }
     } else {
-        nodoka_string *lstr = (nodoka_string *)sp1;
-        nodoka_string *rstr = (nodoka_string *)sp0;
-        int result = lstr == rstr ? 0 : unicode_utf16Cmp(&lstr->value, &rstr->value);
+        nodoka_string *lstr = nodoka_flatten(nodoka_unbox(sp1));
+        nodoka_string *rstr = nodoka_flatten(nodoka_unbox(sp0));
+        int result = lstr == rstr ? 0 : nodoka_compareContents(lstr, rstr);
         if (result < 0) {
             return 1;
         } else {
@@ -109,90 +97,79 @@ int8_t nodoka_absRelComp(nodoka_data *sp1, nodoka_data *sp0) {
     }
 }
 
-bool nodoka_sameValue(nodoka_data *x, nodoka_data *y) {
-    if (x->type != y->type) {
-        return false;
-    }
-    switch (x->type) {
-        case NODOKA_UNDEF:
-        case NODOKA_NULL:
+/* Other primitives are immediates, and strings the same atom or plain strings with the same contents */
+static bool sameString(nodoka_value x, nodoka_value y) {
+    return nodoka_isString(x) && nodoka_isString(y) && nodoka_equalString(nodoka_unbox(x), nodoka_unbox(y));
+}
+
+bool nodoka_sameValue(nodoka_value x, nodoka_value y) {
+    if (nodoka_isNumber(x) && nodoka_isNumber(y)) {
+        double v0 = nodoka_getNumber(x);
+        double v1 = nodoka_getNumber(y);
+        if (isnan(v0) && isnan(v1)) {
             return true;
-        case NODOKA_NUMBER: {
-            nodoka_number *v0 = (nodoka_number *)x;
-            nodoka_number *v1 = (nodoka_number *)y;
-            if (isnan(v0->value) && isnan(v1->value)) {
-                return true;
-            }
-            return double2int(v0->value) == double2int(v1->value);
         }
-        case NODOKA_STRING:
-            return x == y;
-        case NODOKA_BOOL:
-            return x == y;
-        default:
-            assert(0);
+        return double2int(v0) == double2int(v1);
     }
+    return x == y || sameString(x, y);
 }
 
-bool nodoka_strictEqComp(nodoka_data *x, nodoka_data *y) {
-    if (x->type != y->type) {
-        return false;
-    }
-    switch (x->type) {
-        case NODOKA_UNDEF:
-        case NODOKA_NULL:
-            return true;
-        case NODOKA_NUMBER:
-            return ((nodoka_number *)x)->value == ((nodoka_number *)y)->value;
-        case NODOKA_STRING:
-        case NODOKA_BOOL:
-        case NODOKA_OBJECT:
+bool nodoka_strictEqComp(nodoka_value x, nodoka_value y) {
+    if (nodoka_isNumber(x) && nodoka_isNumber(y)) {
+        if (nodoka_isInt32(x) && nodoka_isInt32(y)) {
             return x == y;
-        default:
-            assert(0);
+        }
+        return nodoka_getNumber(x) == nodoka_getNumber(y);
     }
+    return x == y || sameString(x, y);
 }
 
-bool nodoka_absEqComp(nodoka_data *x, nodoka_data *y) {
-    if (x->type == y->type) {
+bool nodoka_absEqComp(nodoka_value x, nodoka_value y) {
+    enum nodoka_data_type xType = nodoka_typeOf(x);
+    enum nodoka_data_type yType = nodoka_typeOf(y);
+    if (xType == yType) {
         return nodoka_strictEqComp(x, y);
-    } else if (x->type == NODOKA_NULL && y->type == NODOKA_UNDEF) {
+    } else if (xType == NODOKA_NULL && yType == NODOKA_UNDEF) {
         return true;
-    } else if (x->type == NODOKA_UNDEF && y->type == NODOKA_NULL) {
+    } else if (xType == NODOKA_UNDEF && yType == NODOKA_NULL) {
         return true;
-    } else if (x->type == NODOKA_NUMBER && y->type == NODOKA_STRING) {
-        return nodoka_absEqComp(x, (nodoka_data *)nodoka_toNumber(y));
-    } else if (x->type == NODOKA_STRING && y->type == NODOKA_NUMBER) {
-        return nodoka_absEqComp((nodoka_data *)nodoka_toNumber(x), y);
-    } else if (x->type == NODOKA_BOOL) {
-        return nodoka_absEqComp((nodoka_data *)nodoka_toNumber(x), y);
-    } else if (y->type == NODOKA_BOOL) {
-        return nodoka_absEqComp(x, (nodoka_data *)nodoka_toNumber(y));
-    } else if ((x->type == NODOKA_STRING || x->type == NODOKA_NUMBER) && y->type == NODOKA_OBJECT) {
+    } else if (xType == NODOKA_NUMBER && yType == NODOKA_STRING) {
+        return nodoka_absEqComp(x, nodoka_fromNumber(nodoka_toNumber(y)));
+    } else if (xType == NODOKA_STRING && yType == NODOKA_NUMBER) {
+        return nodoka_absEqComp(nodoka_fromNumber(nodoka_toNumber(x)), y);
+    } else if (xType == NODOKA_BOOL) {
+        return nodoka_absEqComp(nodoka_fromNumber(nodoka_toNumber(x)), y);
+    } else if (yType == NODOKA_BOOL) {
+        return nodoka_absEqComp(x, nodoka_fromNumber(nodoka_toNumber(y)));
+    } else if ((xType == NODOKA_STRING || xType == NODOKA_NUMBER) && yType == NODOKA_OBJECT) {
         return nodoka_absEqComp(x, nodoka_toPrimitive(y));
-    } else if ((y->type == NODOKA_STRING || y->type == NODOKA_NUMBER) && x->type == NODOKA_OBJECT) {
+    } else if ((yType == NODOKA_STRING || yType == NODOKA_NUMBER) && xType == NODOKA_OBJECT) {
         return nodoka_absEqComp(nodoka_toPrimitive(x), y);
     } else {
         return false;
     }
 }
 
-static nodoka_data *getValue(nodoka_context *context, nodoka_data *val) {
-    if (val->type == NODOKA_REFERENCE) {
-        nodoka_reference *ref = (nodoka_reference *)val;
-        nodoka_data *result;
-        /* Notice that ref->base = NULL indicates a environment record */
-        if (!ref->base) {
-            throwReferenceError(context, nodoka_concatString(2, ref->name, nodoka_newStringFromUtf8(" is not defined")));
-            return NULL;
-        } else if (ref->base->type != NODOKA_ENV) {
-            if (ref->base->type == NODOKA_OBJECT) {
-                result = nodoka_get((nodoka_object *)ref->base, ref->name);
+static inline bool isReference(nodoka_value val) {
+    return nodoka_isPointer(val) && ((nodoka_data *)nodoka_unbox(val))->type == NODOKA_REFERENCE;
+}
+
+/* Returns nodoka_empty and sets *error if the reference cannot be resolved */
+static nodoka_value getValue(nodoka_context *context, nodoka_value val, nodoka_value *error) {
+    if (isReference(val)) {
+        nodoka_reference *ref = nodoka_unbox(val);
+        nodoka_value result;
+        if (ref->base == nodoka_undefined) {
+            *error = referenceError(context, nodoka_concatString(2, ref->name, nodoka_newStringFromUtf8(" is not defined")));
+            return nodoka_empty;
+        } else if (nodoka_typeOf(ref->base) != NODOKA_ENV) {
+            if (nodoka_isObject(ref->base)) {
+                result = nodoka_get(nodoka_unbox(ref->base), ref->name);
             } else {
                 result = nodoka_get(nodoka_toObject(context, ref->base), ref->name);
             }
         } else {
-            nodoka_envRec *env = (nodoka_envRec *)ref->base;
+            nodoka_envRec *env = nodoka_unbox(ref->base);
             result = nodoka_getBindingValue(env, ref->name);
         }
         return result;
@@ -201,548 +178,1012 @@ static nodoka_data *getValue(nodoka_context *context, nodoka_data *val) {
     }
 }
 
-static void putValue(nodoka_context *context, nodoka_reference *ref, nodoka_data *val) {
-    if (!ref->base) {
-        if (true) {
-            nodoka_put(context->global->global, ref->name, val, false/*Strict*/);
-        } else {
-            assert(!"ReferenceError");
+/*
+ * Object that names assigned without being declared are put in. While a
+ * region is current, that is the outermost record of the region instead of
+ * the global object, so that they are disposed of with the region.
+ */
+static nodoka_object *implicitGlobals(nodoka_context *context) {
+    nodoka_object *obj = context->global->global;
+    if (nodoka_currentRegion) {
+        for (nodoka_envRec *env = context->env; env; env = env->outer) {
+            if (env->base.inRegion && env->object) {
+                obj = env->object;
+            }
         }
-    } else if (ref->base->type != NODOKA_ENV) {
-        if (ref->base->type == NODOKA_OBJECT) {
+    }
+    return obj;
+}
+
+/* Returns false and sets *error if the value cannot be stored */
+static bool putValue(nodoka_context *context, nodoka_reference *ref, nodoka_value val, nodoka_value *error) {
+    bool stored;
+    if (ref->base == nodoka_undefined) {
+        stored = nodoka_put(implicitGlobals(context), ref->name, val, false/*Strict*/);
+    } else if (nodoka_typeOf(ref->base) != NODOKA_ENV) {
+        if (nodoka_isObject(ref->base)) {
             //Strict?
-            nodoka_put((nodoka_object *)ref->base, ref->name, val, false/*Strict*/);
+            stored = nodoka_put(nodoka_unbox(ref->base), ref->name, val, false/*Strict*/);
         } else {
             assert(0);
         }
     } else {
-        nodoka_envRec *env = (nodoka_envRec *)ref->base;
-        nodoka_setMutableBinding(env, ref->name, val);
+        nodoka_envRec *env = nodoka_unbox(ref->base);
+        stored = nodoka_setMutableBinding(env, ref->name, val);
+    }
+    if (!stored) {
+        *error = regionEscapeError(context);
+    }
+    return stored;
+}
+
+/* Returns the innermost environment record which has the binding, or NULL */
+static nodoka_envRec *lookupName(nodoka_context *context, nodoka_string *name) {
+    for (nodoka_envRec *env = context->env; env; env = env->outer) {
+        if (nodoka_hasBinding(env, name)) {
+            return env;
+        }
+    }
+    return NULL;
+}
+
+/* Returns the property cached for obj, or NULL on a miss */
+static inline nodoka_property *icLookup(nodoka_ic *ic, nodoka_object *obj, nodoka_string *name) {
+    if (ic->epoch != nodoka_propertyEpoch) {
+        for (int i = 0; i < NODOKA_IC_WAYS; i++) {
+            ic->entries[i].receiver = NULL;
+            ic->entries[i].name = NULL;
+        }
+        ic->epoch = nodoka_propertyEpoch;
+        return NULL;
+    }
+    for (int i = 0; i < NODOKA_IC_WAYS; i++) {
+        if (ic->entries[i].name == name) {
+            if (ic->entries[i].receiver == obj->shape) {
+                return &obj->slots[ic->entries[i].slot];
+            }
+            if (ic->entries[i].receiver == obj) {
+                return &ic->entries[i].holder->slots[ic->entries[i].slot];
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Entries are replaced in turn once the cache is full */
+static void icFill(nodoka_ic *ic, nodoka_object *obj, nodoka_string *name, nodoka_object *holder, nodoka_property *prop) {
+    size_t i = ic->next;
+    ic->next = (i + 1) % NODOKA_IC_WAYS;
+    ic->entries[i].receiver = holder == obj ? (void *)obj->shape : obj;
+    ic->entries[i].name = name;
+    ic->entries[i].holder = holder;
+    ic->entries[i].slot = prop - holder->slots;
+}
+
+/* Returns nodoka_empty and sets *error if base is undefined or null */
+static nodoka_value getProperty(nodoka_context *context, nodoka_ic *ic, nodoka_value base, nodoka_string *name, nodoka_value *error) {
+    if (nodoka_isObject(base)) {
+        nodoka_object *obj = nodoka_unbox(base);
+        nodoka_property *prop = icLookup(ic, obj, name);
+        if (prop) {
+            return prop->value;
+        }
+        if (name == nodoka_lengthStr && obj->elementsKind != NODOKA_ELEMENTS_NONE) {
+            return nodoka_fromNumber(obj->length);
+        }
+        nodoka_object *holder;
+        prop = nodoka_getCacheableProperty(obj, name, &holder);
+        if (prop) {
+            icFill(ic, obj, name, holder, prop);
+            return prop->value;
+        }
+        return nodoka_get(obj, name);
     }
+    if (base == nodoka_null || base == nodoka_undefined) {
+        *error = errorString("TypeError: Cannot read property from undefined or null");
+        return nodoka_empty;
+    }
+    /*
+     * The wrapper of a string has only its length and code units as
+     * properties of its own, so that the others are those of
+     * String.prototype, and strings need no wrapper to be looked up.
+     */
+    if (nodoka_isString(base)) {
+        nodoka_string *str = nodoka_unbox(base);
+        uint32_t index;
+        if (name == nodoka_lengthStr) {
+            return nodoka_fromNumber(str->value.len);
+        } else if (!nodoka_isArrayIndex(name, &index)) {
+            return nodoka_get(context->global->String_prototype, name);
+        }
+    }
+    return nodoka_get(nodoka_toObject(context, base), name);
 }
 
-static enum nodoka_completion nodoka_stepExec(nodoka_context *context) {
-    assert(context->insPtr < context->code->bytecodeLength);
-    uint8_t bc = fetchByte(context);
-    switch (bc) {
-        case NODOKA_BC_UNDEF: {
-            nodoka_push(context, nodoka_undefined);
-            break;
-        }
-        case NODOKA_BC_NULL: {
-            nodoka_push(context, nodoka_null);
-            break;
-        }
-        case NODOKA_BC_TRUE: {
-            nodoka_push(context, nodoka_true);
-            break;
-        }
-        case NODOKA_BC_FALSE: {
-            nodoka_push(context, nodoka_false);
-            break;
-        }
-        case NODOKA_BC_LOAD_STR: {
-            uint16_t imm16 = fetch16(context);
-            nodoka_push(context, (nodoka_data *)context->code->stringPool[imm16]);
-            break;
-        }
-        case NODOKA_BC_LOAD_NUM: {
-            double val = int2double(fetch64(context));
-            nodoka_push(context, (nodoka_data *)nodoka_newNumber(val));
-            break;
-        }
-        case NODOKA_BC_FUNC: {
-            uint16_t imm16 = fetch16(context);
-            nodoka_code *code = context->code->codePool[imm16];
+/* Keys are strings, or array indices left as int32 by KEY */
+static nodoka_value getKeyedProperty(nodoka_context *context, nodoka_ic *ic, nodoka_value base, nodoka_value key, nodoka_value *error) {
+    if (nodoka_isInt32(key)) {
+        if (nodoka_isObject(base)) {
+            nodoka_value value = nodoka_getElement(nodoka_unbox(base), nodoka_getInt32(key));
+            if (value) {
+                return value;
+            }
+        } else if (nodoka_isString(base)) {
+            nodoka_string *str = nodoka_unbox(base);
+            uint32_t index = nodoka_getInt32(key);
+            if (index < str->value.len) {
+                return nodoka_box(nodoka_newCharString(nodoka_charAt(nodoka_flatten(str), index)));
+            }
+        }
+        key = nodoka_box(nodoka_toAtom(nodoka_num2str(nodoka_getInt32(key))));
+    }
+    assertString(key);
+    return getProperty(context, ic, base, nodoka_unbox(key), error);
+}
+
+static inline int32_t toInt32(nodoka_value val) {
+    assertNumber(val);
+    if (nodoka_isInt32(val)) {
+        return nodoka_getInt32(val);
+    }
+    return nodoka_toInt32(nodoka_getDouble(val));
+}
+
+/*
+ * The interpreter loop keeps the instruction pointer and the stack top in
+ * locals, and only writes them back to the context when it leaves. With GCC
+ * or Clang each handler jumps directly to the next one through a label table
+ * (threaded dispatch), otherwise a plain switch is used. Define
+ * NODOKA_SWITCH_DISPATCH to force the switch version.
+ */
+#if defined(__GNUC__) && !defined(NODOKA_SWITCH_DISPATCH)
+#define NODOKA_THREADED_DISPATCH
+#endif
+
+#ifdef NODOKA_THREADED_DISPATCH
+#define DISPATCH() goto *dispatchTable[(insPtr++)->op]
+#define SWITCH() DISPATCH();
+#define OPCODE(op) L_##op
+#define ILLEGAL L_ILLEGAL
+#else
+#define DISPATCH() goto dispatch
+#define SWITCH() dispatch: switch ((insPtr++)->op)
+#define OPCODE(op) case NODOKA_BC_##op
+#define ILLEGAL default
+#endif
+
+/* The depth of the operand stack is checked by nodoka_verifyCode before code is run */
+#ifdef NODOKA_CHECK_STACK
+#define PUSH(data) (assert(stackTop < context->stackLimit), *stackTop++ = (data))
+#define POP() (assert(stackTop > context->stack), *--stackTop)
+#else
+#define PUSH(data) (*stackTop++ = (data))
+#define POP() (*--stackTop)
+#endif
+#define FETCH() (insPtr++)
+#define THROW(data) do { exception = (data); goto throw; } while (0)
+
+#define SAVE_STATE() do {\
+        context->insPtr = insPtr - wordcode;\
+        context->stackTop = stackTop;\
+    } while (0)
+
+#define LOAD_STATE() do {\
+        wordcode = context->code->wordcode;\
+        insPtr = wordcode + context->insPtr;\
+        stackTop = context->stackTop;\
+        locals = context->locals;\
+    } while (0)
+
+/*
+ * Like SAVE_STATE, but keeping the values from the operand stack up to top
+ * traced, for natives which take them from the stack as arguments
+ */
+#define SAVE_STATE_TO(top) do {\
+        context->insPtr = insPtr - wordcode;\
+        context->stackTop = (top);\
+    } while (0)
+
+/*
+ * Safe point of the collector, taken on jumps and on entry of activations.
+ * Every live value is then in a context on the VM stack, also when this
+ * loop runs below a native function: the state is saved before anything
+ * which may run code, that is natives and conversions of objects.
+ */
+#define GC_POINT() do {\
+        if (nodoka_gcPending) {\
+            SAVE_STATE();\
+            nodoka_collectGarbage(context->global);\
+        }\
+    } while (0)
+
+enum nodoka_completion nodoka_exec(nodoka_context *context, nodoka_value *retPtr) {
+#ifdef NODOKA_THREADED_DISPATCH
+    static void *dispatchTable[256] = {
+        [0 ... 255] = &&L_ILLEGAL,
+        [NODOKA_BC_UNDEF] = &&L_UNDEF,
+        [NODOKA_BC_NULL] = &&L_NULL,
+        [NODOKA_BC_TRUE] = &&L_TRUE,
+        [NODOKA_BC_FALSE] = &&L_FALSE,
+        [NODOKA_BC_LOAD_STR] = &&L_LOAD_STR,
+        [NODOKA_BC_LOAD_NUM] = &&L_LOAD_NUM,
+        [NODOKA_BC_FUNC] = &&L_FUNC,
+        [NODOKA_BC_LOAD_OBJ] = &&L_LOAD_OBJ,
+        [NODOKA_BC_LOAD_ARR] = &&L_LOAD_ARR,
+        [NODOKA_BC_NOP] = &&L_NOP,
+        [NODOKA_BC_DUP] = &&L_DUP,
+        [NODOKA_BC_DUP2] = &&L_DUP2,
+        [NODOKA_BC_POP] = &&L_POP,
+        [NODOKA_BC_XCHG] = &&L_XCHG,
+        [NODOKA_BC_XCHG3] = &&L_XCHG3,
+        [NODOKA_BC_XCHG4] = &&L_XCHG4,
+        [NODOKA_BC_RET] = &&L_RET,
+        [NODOKA_BC_THIS] = &&L_THIS,
+        [NODOKA_BC_PRIM] = &&L_PRIM,
+        [NODOKA_BC_BOOL] = &&L_BOOL,
+        [NODOKA_BC_NUM] = &&L_NUM,
+        [NODOKA_BC_STR] = &&L_STR,
+        [NODOKA_BC_KEY] = &&L_KEY,
+        [NODOKA_BC_REF] = &&L_REF,
+        [NODOKA_BC_ID] = &&L_ID,
+        [NODOKA_BC_GET_LOCAL] = &&L_GET_LOCAL,
+        [NODOKA_BC_SET_LOCAL] = &&L_SET_LOCAL,
+        [NODOKA_BC_GET_UPVAL] = &&L_GET_UPVAL,
+        [NODOKA_BC_SET_UPVAL] = &&L_SET_UPVAL,
+        [NODOKA_BC_GET] = &&L_GET,
+        [NODOKA_BC_PUT] = &&L_PUT,
+        [NODOKA_BC_GET_PROP] = &&L_GET_PROP,
+        [NODOKA_BC_PUT_PROP] = &&L_PUT_PROP,
+        [NODOKA_BC_GET_NAME] = &&L_GET_NAME,
+        [NODOKA_BC_PUT_NAME] = &&L_PUT_NAME,
+        [NODOKA_BC_DEL] = &&L_DEL,
+        [NODOKA_BC_CALL] = &&L_CALL,
+        [NODOKA_BC_CALL_PROP] = &&L_CALL_PROP,
+        [NODOKA_BC_CALL_NAME] = &&L_CALL_NAME,
+        [NODOKA_BC_NEW] = &&L_NEW,
+        [NODOKA_BC_TYPEOF] = &&L_TYPEOF,
+        [NODOKA_BC_NEG] = &&L_NEG,
+        [NODOKA_BC_NOT] = &&L_NOT,
+        [NODOKA_BC_L_NOT] = &&L_L_NOT,
+        [NODOKA_BC_MUL] = &&L_MUL,
+        [NODOKA_BC_MOD] = &&L_MOD,
+        [NODOKA_BC_DIV] = &&L_DIV,
+        [NODOKA_BC_ADD] = &&L_ADD,
+        [NODOKA_BC_SUB] = &&L_SUB,
+        [NODOKA_BC_SHL] = &&L_SHL,
+        [NODOKA_BC_SHR] = &&L_SHR,
+        [NODOKA_BC_USHR] = &&L_USHR,
+        [NODOKA_BC_LT] = &&L_LT,
+        [NODOKA_BC_LTEQ] = &&L_LTEQ,
+        [NODOKA_BC_EQ] = &&L_EQ,
+        [NODOKA_BC_S_EQ] = &&L_S_EQ,
+        [NODOKA_BC_AND] = &&L_AND,
+        [NODOKA_BC_OR] = &&L_OR,
+        [NODOKA_BC_XOR] = &&L_XOR,
+        [NODOKA_BC_JMP] = &&L_JMP,
+        [NODOKA_BC_JT] = &&L_JT,
+        [NODOKA_BC_THROW] = &&L_THROW,
+        [NODOKA_BC_DECL] = &&L_DECL,
+    };
+#endif
+
+    nodoka_word *wordcode;
+    nodoka_word *insPtr;
+    nodoka_value *stackTop;
+    nodoka_value *locals;
+    nodoka_stack *vmStack = context->global->stack;
+    nodoka_value exception;
+    enum nodoka_completion comp;
+
+    /* Operands of the call being made and the activation being entered */
+    nodoka_value callFunc;
+    nodoka_value callThis;
+    nodoka_value *callArgs;
+    size_t callCount;
+    nodoka_context *callee;
+
+    nodoka_region *outerRegion = nodoka_currentRegion;
+    if (context->region) {
+        nodoka_currentRegion = context->region;
+    }
+    LOAD_STATE();
+
+    SWITCH() {
+        OPCODE(UNDEF): {
+            PUSH(nodoka_undefined);
+            DISPATCH();
+        }
+        OPCODE(NULL): {
+            PUSH(nodoka_null);
+            DISPATCH();
+        }
+        OPCODE(TRUE): {
+            PUSH(nodoka_true);
+            DISPATCH();
+        }
+        OPCODE(FALSE): {
+            PUSH(nodoka_false);
+            DISPATCH();
+        }
+        OPCODE(LOAD_STR): {
+            PUSH(nodoka_box(FETCH()->string));
+            DISPATCH();
+        }
+        OPCODE(LOAD_NUM): {
+            PUSH(FETCH()->value);
+            DISPATCH();
+        }
+        OPCODE(FUNC): {
+            nodoka_code *code = FETCH()->code;
             nodoka_object *obj = nodoka_newFunction(context, code);
-            nodoka_push(context, (nodoka_data *)obj);
-            break;
-        }
-        case NODOKA_BC_LOAD_OBJ: {
-            nodoka_push(context, (nodoka_data *)context->global->object);
-            break;
-        }
-        case NODOKA_BC_LOAD_ARR: {
-            nodoka_push(context, (nodoka_data *)context->global->Array);
-            break;
-        }
-        case NODOKA_BC_NOP: {
-            break;
-        }
-        case NODOKA_BC_DUP: {
-            nodoka_data *sp0 = nodoka_pop(context);
-            nodoka_push(context, sp0);
-            nodoka_push(context, sp0);
-            break;
-        }
-        case NODOKA_BC_POP: {
-            nodoka_pop(context);
-            break;
-        }
-        case NODOKA_BC_XCHG: {
-            nodoka_data *sp0 = nodoka_pop(context);
-            nodoka_data *sp1 = nodoka_pop(context);
-            nodoka_push(context, sp0);
-            nodoka_push(context, sp1);
-            break;
-        }
-        case NODOKA_BC_XCHG3: {
-            nodoka_data *sp0 = nodoka_pop(context);
-            nodoka_data *sp1 = nodoka_pop(context);
-            nodoka_data *sp2 = nodoka_pop(context);
-            nodoka_push(context, sp0);
-            nodoka_push(context, sp2);
-            nodoka_push(context, sp1);
-            break;
-        }
-        case NODOKA_BC_RET: {
-            return NODOKA_COMPLETION_RETURN;
-        }
-        case NODOKA_BC_PRIM: {
-            nodoka_push(context, nodoka_toPrimitive(nodoka_pop(context)));
-            break;
-        }
-        case NODOKA_BC_BOOL: {
-            nodoka_push(context, nodoka_toBoolean(nodoka_pop(context)));
-            break;
-        }
-        case NODOKA_BC_NUM: {
-            nodoka_push(context, (nodoka_data *)nodoka_toNumber(nodoka_pop(context)));
-            break;
-        }
-        case NODOKA_BC_STR: {
-            nodoka_push(context, (nodoka_data *)nodoka_toString(context, nodoka_pop(context)));
-            break;
-        }
-        case NODOKA_BC_REF: {
-            nodoka_string *sp0 = (nodoka_string *)nodoka_pop(context);
-            nodoka_data *sp1 = nodoka_pop(context);
-            if (sp1->type == NODOKA_NULL || sp1->type == NODOKA_UNDEF) {
-                throwString(context, "TypeError: Cannot read property from undefined or null");
-                return NODOKA_COMPLETION_THROW;
+            PUSH(nodoka_box(obj));
+            DISPATCH();
+        }
+        OPCODE(LOAD_OBJ): {
+            PUSH(nodoka_box(context->global->object));
+            DISPATCH();
+        }
+        OPCODE(LOAD_ARR): {
+            PUSH(nodoka_box(context->global->Array));
+            DISPATCH();
+        }
+        OPCODE(NOP): {
+            DISPATCH();
+        }
+        OPCODE(DUP): {
+            nodoka_value sp0 = stackTop[-1];
+            PUSH(sp0);
+            DISPATCH();
+        }
+        OPCODE(DUP2): {
+            nodoka_value sp0 = stackTop[-1];
+            nodoka_value sp1 = stackTop[-2];
+            PUSH(sp1);
+            PUSH(sp0);
+            DISPATCH();
+        }
+        OPCODE(POP): {
+            (void)POP();
+            DISPATCH();
+        }
+        OPCODE(XCHG): {
+            nodoka_value sp0 = stackTop[-1];
+            stackTop[-1] = stackTop[-2];
+            stackTop[-2] = sp0;
+            DISPATCH();
+        }
+        OPCODE(XCHG3): {
+            nodoka_value sp0 = stackTop[-1];
+            stackTop[-1] = stackTop[-2];
+            stackTop[-2] = stackTop[-3];
+            stackTop[-3] = sp0;
+            DISPATCH();
+        }
+        OPCODE(XCHG4): {
+            nodoka_value sp0 = stackTop[-1];
+            stackTop[-1] = stackTop[-2];
+            stackTop[-2] = stackTop[-3];
+            stackTop[-3] = stackTop[-4];
+            stackTop[-4] = sp0;
+            DISPATCH();
+        }
+        OPCODE(RET): {
+            nodoka_value ret = POP();
+            if (context->constructed && !nodoka_isObject(ret)) {
+                ret = nodoka_box(context->constructed);
+            }
+            /* Anything left below the value goes away with the frame */
+            if (context->caller) {
+                nodoka_context *caller = context->caller;
+                nodoka_disposeContext(context);
+                context = caller;
+                vmStack->top = context->stackLimit;
+                LOAD_STATE();
+                PUSH(ret);
+                DISPATCH();
+            }
+            stackTop = context->stack;
+            PUSH(ret);
+            comp = NODOKA_COMPLETION_RETURN;
+            goto leave;
+        }
+        OPCODE(PRIM): {
+            stackTop[-1] = nodoka_toPrimitive(stackTop[-1]);
+            DISPATCH();
+        }
+        OPCODE(BOOL): {
+            stackTop[-1] = nodoka_fromBool(nodoka_toBoolean(stackTop[-1]));
+            DISPATCH();
+        }
+        OPCODE(NUM): {
+            nodoka_value sp0 = stackTop[-1];
+            if (!nodoka_isNumber(sp0)) {
+                stackTop[-1] = nodoka_fromNumber(nodoka_toNumber(sp0));
+            }
+            DISPATCH();
+        }
+        OPCODE(STR): {
+            SAVE_STATE();
+            stackTop[-1] = nodoka_box(nodoka_toString(context, stackTop[-1]));
+            DISPATCH();
+        }
+        OPCODE(KEY): {
+            nodoka_value sp0 = stackTop[-1];
+            if (nodoka_isString(sp0)) {
+                stackTop[-1] = nodoka_box(nodoka_toAtom(nodoka_unbox(sp0)));
+            } else if (!(nodoka_isInt32(sp0) && nodoka_getInt32(sp0) >= 0)) {
+                SAVE_STATE();
+                stackTop[-1] = nodoka_box(nodoka_toAtom(nodoka_toString(context, sp0)));
+            }
+            DISPATCH();
+        }
+        OPCODE(REF): {
+            nodoka_value sp0 = POP();
+            nodoka_value sp1 = POP();
+            if (sp1 == nodoka_null || sp1 == nodoka_undefined) {
+                THROW(errorString("TypeError: Cannot read property from undefined or null"));
             }
             assertString(sp0);
-            nodoka_push(context, (nodoka_data *)nodoka_newReference(sp1, sp0));
-            break;
+            PUSH(nodoka_box(nodoka_newReference(sp1, nodoka_toAtom(nodoka_unbox(sp0)))));
+            DISPATCH();
         }
-        case NODOKA_BC_ID: {
-            nodoka_string *sp0 = (nodoka_string *)nodoka_pop(context);
+        OPCODE(ID): {
+            nodoka_value sp0 = POP();
             assertString(sp0);
-            nodoka_envRec *env;
-            for (env = context->env; env; env = env->outer) {
-                if (nodoka_hasBinding(env, sp0)) {
-                    break;
-                }
+            nodoka_string *name = nodoka_unbox(sp0);
+            nodoka_envRec *env = lookupName(context, name);
+            PUSH(nodoka_box(nodoka_newReference(env ? nodoka_box(env) : nodoka_undefined, name)));
+            DISPATCH();
+        }
+        OPCODE(GET_LOCAL): {
+            PUSH(locals[FETCH()->imm]);
+            DISPATCH();
+        }
+        OPCODE(SET_LOCAL): {
+            locals[FETCH()->imm] = POP();
+            DISPATCH();
+        }
+        OPCODE(GET_UPVAL): {
+            nodoka_word *operand = FETCH();
+            nodoka_envRec *env = context->env;
+            for (int i = 0; i < operand->upval.depth; i++) {
+                env = env->outer;
             }
-            nodoka_push(context, (nodoka_data *)nodoka_newReference((nodoka_data *)env, sp0));
-            break;
+            PUSH(env->slots[operand->upval.index]);
+            DISPATCH();
         }
-        case NODOKA_BC_GET: {
-            nodoka_data *sp0 = nodoka_pop(context);
-            nodoka_data *ret = getValue(context, sp0);
+        OPCODE(SET_UPVAL): {
+            nodoka_word *operand = FETCH();
+            nodoka_envRec *env = context->env;
+            for (int i = 0; i < operand->upval.depth; i++) {
+                env = env->outer;
+            }
+            if (nodoka_escapesRegion(env, stackTop[-1])) {
+                THROW(regionEscapeError(context));
+            }
+            nodoka_writeBarrier(env->slots[operand->upval.index]);
+            env->slots[operand->upval.index] = POP();
+            DISPATCH();
+        }
+        OPCODE(GET): {
+            nodoka_value ret = getValue(context, stackTop[-1], &exception);
             if (!ret) {
-                return NODOKA_COMPLETION_THROW;
+                goto throw;
             }
-            nodoka_push(context, ret);
-            break;
+            stackTop[-1] = ret;
+            DISPATCH();
         }
-        case NODOKA_BC_PUT: {
-            nodoka_data *sp0 = nodoka_pop(context);
-            nodoka_reference *sp1 = (nodoka_reference *)nodoka_pop(context);
-            if (sp1->class_base.type != NODOKA_REFERENCE) {
-                throwString(context, "ReferenceError: Invalid left-hand side in assignment");
-                return NODOKA_COMPLETION_THROW;
+        OPCODE(PUT): {
+            nodoka_value sp0 = POP();
+            nodoka_value sp1 = POP();
+            if (!isReference(sp1)) {
+                THROW(errorString("ReferenceError: Invalid left-hand side in assignment"));
+            }
+            if (!putValue(context, nodoka_unbox(sp1), sp0, &exception)) {
+                goto throw;
             }
-            putValue(context, sp1, sp0);
-            break;
+            DISPATCH();
         }
-        case NODOKA_BC_DEL: {
-            nodoka_data *sp0 = nodoka_pop(context);
-            if (sp0->type != NODOKA_REFERENCE) {
-                nodoka_push(context, nodoka_true);
-                break;
+        OPCODE(GET_PROP): {
+            nodoka_ic *ic = FETCH()->ic;
+            nodoka_value sp0 = POP();
+            nodoka_value ret = getKeyedProperty(context, ic, stackTop[-1], sp0, &exception);
+            if (!ret) {
+                goto throw;
+            }
+            stackTop[-1] = ret;
+            DISPATCH();
+        }
+        OPCODE(PUT_PROP): {
+            nodoka_ic *ic = FETCH()->ic;
+            nodoka_value sp0 = POP();
+            nodoka_value sp1 = POP();
+            nodoka_value sp2 = stackTop[-1];
+            if (nodoka_isInt32(sp1)) {
+                if (nodoka_isObject(sp2)) {
+                    nodoka_object *obj = nodoka_unbox(sp2);
+                    uint32_t index = nodoka_getInt32(sp1);
+                    /* Unlike nodoka_putElement, nodoka_replaceElement does not check the store */
+                    bool stored = !nodoka_escapesRegion(obj, sp0) && nodoka_replaceElement(obj, index, sp0);
+                    if (!stored && !nodoka_putElement(obj, index, sp0)) {
+                        THROW(regionEscapeError(context));
+                    }
+                    stackTop[-1] = sp0;
+                    DISPATCH();
+                }
+                sp1 = nodoka_box(nodoka_toAtom(nodoka_num2str(nodoka_getInt32(sp1))));
+            }
+            assertString(sp1);
+            nodoka_string *name = nodoka_unbox(sp1);
+            nodoka_object *obj;
+            if (nodoka_isObject(sp2)) {
+                obj = nodoka_unbox(sp2);
+                /*
+                 * Only own writable data properties are cached by stores, but
+                 * another object of the same shape may have it read-only
+                 */
+                nodoka_property *prop = icLookup(ic, obj, name);
+                if (prop && (prop->attributes & NODOKA_WRITABLE) && !nodoka_escapesRegion(obj, sp0)) {
+                    nodoka_writeBarrier(prop->value);
+                    prop->value = sp0;
+                    stackTop[-1] = sp0;
+                    DISPATCH();
+                }
+            } else if (sp2 == nodoka_null || sp2 == nodoka_undefined) {
+                THROW(errorString("TypeError: Cannot set property of undefined or null"));
+            } else {
+                obj = nodoka_toObject(context, sp2);
+            }
+            if (!nodoka_put(obj, name, sp0, false/*Strict*/)) {
+                THROW(regionEscapeError(context));
+            }
+            if (nodoka_isObject(sp2)) {
+                nodoka_object *holder;
+                nodoka_property *prop = nodoka_getCacheableProperty(obj, name, &holder);
+                if (prop && holder == obj && (prop->attributes & NODOKA_WRITABLE)) {
+                    icFill(ic, obj, name, holder, prop);
+                }
+            }
+            stackTop[-1] = sp0;
+            DISPATCH();
+        }
+        OPCODE(GET_NAME): {
+            nodoka_string *name = FETCH()->string;
+            nodoka_envRec *env = lookupName(context, name);
+            if (!env) {
+                THROW(referenceError(context, nodoka_concatString(2, name, nodoka_newStringFromUtf8(" is not defined"))));
+            }
+            PUSH(nodoka_getBindingValue(env, name));
+            DISPATCH();
+        }
+        OPCODE(PUT_NAME): {
+            nodoka_string *name = FETCH()->string;
+            nodoka_envRec *env = lookupName(context, name);
+            bool stored;
+            if (env) {
+                stored = nodoka_setMutableBinding(env, name, stackTop[-1]);
+            } else {
+                stored = nodoka_put(implicitGlobals(context), name, stackTop[-1], false/*Strict*/);
+            }
+            if (!stored) {
+                THROW(regionEscapeError(context));
+            }
+            DISPATCH();
+        }
+        OPCODE(DEL): {
+            nodoka_value sp0 = stackTop[-1];
+            if (!isReference(sp0)) {
+                stackTop[-1] = nodoka_true;
+                DISPATCH();
             }
             /* A lot of check currently ignored */
-            nodoka_reference *ref = (nodoka_reference *)sp0;
+            nodoka_reference *ref = nodoka_unbox(sp0);
             bool result;
-            if (ref->base->type != NODOKA_ENV) {
+            if (nodoka_typeOf(ref->base) != NODOKA_ENV) {
                 result = nodoka_delete(nodoka_toObject(context, ref->base), ref->name, false);
             } else {
                 assert(0);
             }
-            nodoka_push(context, result ? nodoka_true : nodoka_false);
-            break;
+            stackTop[-1] = nodoka_fromBool(result);
+            DISPATCH();
         }
-        case NODOKA_BC_CALL: {
-            uint8_t count = fetchByte(context);
-            nodoka_data **args = NULL;
-            if (count) {
-                args = malloc(sizeof(nodoka_data *)*count);
-                for (int i = count - 1; i >= 0; i--) {
-                    args[i] = nodoka_pop(context);
-                }
-            }
-            nodoka_data *sp0 = nodoka_pop(context);
-            nodoka_object *func = (nodoka_object *)getValue(context, sp0);
-            if (!func) {
-                return NODOKA_COMPLETION_THROW;
+        OPCODE(CALL): {
+            callCount = FETCH()->imm;
+            callArgs = stackTop - callCount;
+            nodoka_value sp0 = callArgs[-1];
+            callFunc = getValue(context, sp0, &exception);
+            if (!callFunc) {
+                goto throw;
             }
-            if (func->base.type != NODOKA_OBJECT || !func->call) {
-                throwString(context, "TypeError: Cannot call on non-function");
-                return NODOKA_COMPLETION_THROW;
-            }
-            nodoka_data *this;
-            if (sp0->type == NODOKA_REFERENCE) {
-                nodoka_reference *ref = (nodoka_reference *)sp0;
-                if (ref->base->type != NODOKA_ENV) {
-                    this = ref->base;
+            if (isReference(sp0)) {
+                nodoka_reference *ref = nodoka_unbox(sp0);
+                if (nodoka_typeOf(ref->base) != NODOKA_ENV) {
+                    callThis = ref->base;
                 } else {
-                    this = context->env->this;
+                    callThis = context->env->this;
                 }
             } else {
-                this = nodoka_undefined;
+                callThis = nodoka_undefined;
             }
-            nodoka_data *ret;
-            enum nodoka_completion comp = nodoka_call(context, func, this, &ret, count, args);
-            free(args);
-            switch (comp) {
-                case NODOKA_COMPLETION_THROW: {
-                    throwError(context, ret);
-                    return NODOKA_COMPLETION_THROW;
-                }
-                case NODOKA_COMPLETION_RETURN: {
-                    nodoka_push(context, ret);
-                    break;
-                }
-                default: assert(0);
+            stackTop = callArgs - 1;
+            goto call;
+        }
+        OPCODE(CALL_PROP): {
+            callCount = FETCH()->imm;
+            nodoka_ic *ic = FETCH()->ic;
+            /* The base and the key are below the arguments */
+            callArgs = stackTop - callCount;
+            callThis = callArgs[-2];
+            callFunc = getKeyedProperty(context, ic, callThis, callArgs[-1], &exception);
+            if (!callFunc) {
+                goto throw;
             }
-            break;
+            stackTop = callArgs - 2;
+            goto call;
         }
-        case NODOKA_BC_NEW: {
-            uint8_t count = fetchByte(context);
-            nodoka_data **args = NULL;
-            if (count) {
-                args = malloc(sizeof(nodoka_data *)*count);
-                for (int i = count - 1; i >= 0; i--) {
-                    args[i] = nodoka_pop(context);
-                }
+        OPCODE(CALL_NAME): {
+            nodoka_string *name = FETCH()->string;
+            callCount = FETCH()->imm;
+            callArgs = stackTop - callCount;
+            nodoka_envRec *env = lookupName(context, name);
+            if (!env) {
+                THROW(referenceError(context, nodoka_concatString(2, name, nodoka_newStringFromUtf8(" is not defined"))));
             }
-            nodoka_object *constructor = (nodoka_object *)nodoka_pop(context);
-            if (constructor->base.type != NODOKA_OBJECT || !constructor->construct) {
-                if (constructor->call) {
-                    throwString(context, "TypeError: Cannot call on non-constructor");
+            callFunc = nodoka_getBindingValue(env, name);
+            callThis = context->env->this;
+            stackTop = callArgs;
+            goto call;
+        }
+        OPCODE(NEW): {
+            size_t count = FETCH()->imm;
+            nodoka_value *args = stackTop - count;
+            nodoka_value sp0 = args[-1];
+            stackTop = args - 1;
+            nodoka_object *constructor = nodoka_isObject(sp0) ? nodoka_unbox(sp0) : NULL;
+            if (!constructor || !constructor->construct) {
+                if (constructor && constructor->call) {
+                    THROW(errorString("TypeError: Cannot call on non-constructor"));
                 } else {
-                    throwString(context, "TypeError: Cannot call on non-function");
+                    THROW(errorString("TypeError: Cannot call on non-function"));
                 }
-                return NODOKA_COMPLETION_THROW;
             }
-            nodoka_data *ret;
+            vmStack->top = args + count;
+            if (constructor->code) {
+                callee = nodoka_newConstructContext(context, constructor, &exception, count, args);
+                goto enter;
+            }
+            nodoka_value ret;
+            SAVE_STATE_TO(args + count);
             enum nodoka_completion comp = nodoka_construct(context, constructor, &ret, count, args);
-            free(args);
+            vmStack->top = context->stackLimit;
             switch (comp) {
-                case NODOKA_COMPLETION_THROW: {
-                    throwError(context, ret);
-                    return NODOKA_COMPLETION_THROW;
-                }
-                case NODOKA_COMPLETION_RETURN: {
-                    nodoka_push(context, ret);
+                case NODOKA_COMPLETION_THROW:
+                    THROW(ret);
+                case NODOKA_COMPLETION_RETURN:
+                    PUSH(ret);
                     break;
-                }
                 default: assert(0);
             }
-            break;
+            DISPATCH();
         }
-        case NODOKA_BC_TYPEOF: {
-            nodoka_data *sp0 = nodoka_pop(context);
-            if (sp0->type == NODOKA_REFERENCE) {
-                nodoka_reference *ref = (nodoka_reference *)sp0;
-                if (!ref->base) {
+        OPCODE(TYPEOF): {
+            nodoka_value sp0 = stackTop[-1];
+            if (isReference(sp0)) {
+                nodoka_reference *ref = nodoka_unbox(sp0);
+                if (ref->base == nodoka_undefined) {
                     sp0 = nodoka_undefined;
                 } else {
-                    sp0 = getValue(context, sp0);
+                    sp0 = getValue(context, sp0, &exception);
                 }
             }
-            switch (sp0->type) {
+            char *type;
+            switch (nodoka_typeOf(sp0)) {
                 case NODOKA_UNDEF:
-                    nodoka_push(context, (nodoka_data *)nodoka_newStringFromUtf8("undefined"));
+                    type = "undefined";
                     break;
                 case NODOKA_NULL:
-                    nodoka_push(context, (nodoka_data *)nodoka_newStringFromUtf8("object"));
+                    type = "object";
                     break;
                 case NODOKA_BOOL:
-                    nodoka_push(context, (nodoka_data *)nodoka_newStringFromUtf8("boolean"));
+                    type = "boolean";
                     break;
                 case NODOKA_NUMBER:
-                    nodoka_push(context, (nodoka_data *)nodoka_newStringFromUtf8("number"));
+                    type = "number";
                     break;
                 case NODOKA_STRING:
-                    nodoka_push(context, (nodoka_data *)nodoka_newStringFromUtf8("string"));
+                    type = "string";
                     break;
                 case NODOKA_OBJECT: {
-                    nodoka_object *obj = (nodoka_object *)sp0;
-                    if (obj->call) {
-                        nodoka_push(context, (nodoka_data *)nodoka_newStringFromUtf8("function"));
-                    } else {
-                        nodoka_push(context, (nodoka_data *)nodoka_newStringFromUtf8("object"));
-                    }
+                    nodoka_object *obj = nodoka_unbox(sp0);
+                    type = obj->call ? "function" : "object";
                     break;
                 }
                 default: assert(0);
             }
-            break;
+            stackTop[-1] = nodoka_box(nodoka_newStringFromUtf8(type));
+            DISPATCH();
         }
-        case NODOKA_BC_NEG: {
-            nodoka_data *sp0 = nodoka_pop(context);
+        OPCODE(NEG): {
+            nodoka_value sp0 = stackTop[-1];
             assertNumber(sp0);
-            nodoka_number *sp0num = (nodoka_number *)sp0;
-            nodoka_push(context, (nodoka_data *)nodoka_newNumber(-sp0num->value));
-            break;
+            if (nodoka_isInt32(sp0) && nodoka_getInt32(sp0) != 0 && nodoka_getInt32(sp0) != INT32_MIN) {
+                stackTop[-1] = nodoka_fromInt32(-nodoka_getInt32(sp0));
+            } else {
+                stackTop[-1] = nodoka_fromDouble(-nodoka_getNumber(sp0));
+            }
+            DISPATCH();
         }
-        case NODOKA_BC_NOT: {
-            nodoka_data *sp0 = nodoka_pop(context);
-            assertNumber(sp0);
-            nodoka_number *sp0num = (nodoka_number *)sp0;
-            nodoka_push(context, (nodoka_data *)nodoka_newNumber(~nodoka_toInt32(sp0num)));
-            break;
+        OPCODE(NOT): {
+            nodoka_value sp0 = stackTop[-1];
+            stackTop[-1] = nodoka_fromInt32(~toInt32(sp0));
+            DISPATCH();
         }
-        case NODOKA_BC_L_NOT: {
-            nodoka_data *sp0 = nodoka_pop(context);
+        OPCODE(L_NOT): {
+            nodoka_value sp0 = stackTop[-1];
             assertBoolean(sp0);
-            nodoka_push(context, sp0 == nodoka_true ? nodoka_false : nodoka_true);
-            break;
+            stackTop[-1] = sp0 == nodoka_true ? nodoka_false : nodoka_true;
+            DISPATCH();
         }
-        case NODOKA_BC_MUL: {
-            nodoka_number *sp0 = (nodoka_number *)nodoka_pop(context);
-            nodoka_number *sp1 = (nodoka_number *)nodoka_pop(context);
+        OPCODE(MUL): {
+            nodoka_value sp0 = POP();
+            nodoka_value sp1 = stackTop[-1];
             assertNumber(sp1);
             assertNumber(sp0);
-            nodoka_push(context, (nodoka_data *)nodoka_newNumber(sp1->value * sp0->value));
-            break;
+            if (nodoka_isInt32(sp1) && nodoka_isInt32(sp0)) {
+                int64_t result = (int64_t)nodoka_getInt32(sp1) * nodoka_getInt32(sp0);
+                /* A zero result could be -0, leave that to the double path */
+                if (result && result == (int32_t)result) {
+                    stackTop[-1] = nodoka_fromInt32((int32_t)result);
+                    DISPATCH();
+                }
+            }
+            stackTop[-1] = nodoka_fromNumber(nodoka_getNumber(sp1) * nodoka_getNumber(sp0));
+            DISPATCH();
         }
-        case NODOKA_BC_MOD: {
-            nodoka_number *sp0 = (nodoka_number *)nodoka_pop(context);
-            nodoka_number *sp1 = (nodoka_number *)nodoka_pop(context);
+        OPCODE(MOD): {
+            nodoka_value sp0 = POP();
+            nodoka_value sp1 = stackTop[-1];
             assertNumber(sp1);
             assertNumber(sp0);
-            nodoka_push(context, (nodoka_data *)nodoka_newNumber(fmod(sp1->value, sp0->value)));
-            break;
+            if (nodoka_isInt32(sp1) && nodoka_isInt32(sp0) && nodoka_getInt32(sp1) > 0 && nodoka_getInt32(sp0) > 0) {
+                stackTop[-1] = nodoka_fromInt32(nodoka_getInt32(sp1) % nodoka_getInt32(sp0));
+                DISPATCH();
+            }
+            stackTop[-1] = nodoka_fromNumber(fmod(nodoka_getNumber(sp1), nodoka_getNumber(sp0)));
+            DISPATCH();
         }
-        case NODOKA_BC_DIV: {
-            nodoka_number *sp0 = (nodoka_number *)nodoka_pop(context);
-            nodoka_number *sp1 = (nodoka_number *)nodoka_pop(context);
+        OPCODE(DIV): {
+            nodoka_value sp0 = POP();
+            nodoka_value sp1 = stackTop[-1];
             assertNumber(sp1);
             assertNumber(sp0);
-            nodoka_push(context, (nodoka_data *)nodoka_newNumber(sp1->value / sp0->value));
-            break;
+            stackTop[-1] = nodoka_fromNumber(nodoka_getNumber(sp1) / nodoka_getNumber(sp0));
+            DISPATCH();
         }
-        case NODOKA_BC_ADD: {
-            nodoka_data *sp0 = nodoka_pop(context);
-            nodoka_data *sp1 = nodoka_pop(context);
+        OPCODE(ADD): {
+            nodoka_value sp0 = POP();
+            nodoka_value sp1 = stackTop[-1];
+            if (nodoka_isInt32(sp1) && nodoka_isInt32(sp0)) {
+                int64_t result = (int64_t)nodoka_getInt32(sp1) + nodoka_getInt32(sp0);
+                if (result == (int32_t)result) {
+                    stackTop[-1] = nodoka_fromInt32((int32_t)result);
+                    DISPATCH();
+                }
+            }
             assertPrimitive(sp1);
             assertPrimitive(sp0);
-            if (sp1->type == NODOKA_STRING || sp0->type == NODOKA_STRING) {
-                nodoka_string *lstr = nodoka_toString(context, sp1);
-                nodoka_string *rstr = nodoka_toString(context, sp0);
-                nodoka_push(context, (nodoka_data *)nodoka_concatString(2, lstr, rstr));
+            if (nodoka_isString(sp1) || nodoka_isString(sp0)) {
+                /* Strings are not flattened, so that appending to one does not copy it */
+                nodoka_string *lstr = nodoka_isString(sp1) ? nodoka_unbox(sp1) : nodoka_toString(context, sp1);
+                nodoka_string *rstr = nodoka_isString(sp0) ? nodoka_unbox(sp0) : nodoka_toString(context, sp0);
+                stackTop[-1] = nodoka_box(nodoka_newRope(lstr, rstr));
             } else {
-                nodoka_number *lnum = nodoka_toNumber(sp1);
-                nodoka_number *rnum = nodoka_toNumber(sp0);
-                nodoka_push(context, (nodoka_data *)nodoka_newNumber(lnum->value + rnum->value));
+                double lnum = nodoka_toNumber(sp1);
+                double rnum = nodoka_toNumber(sp0);
+                stackTop[-1] = nodoka_fromNumber(lnum + rnum);
             }
-            break;
+            DISPATCH();
         }
-        case NODOKA_BC_SUB: {
-            nodoka_number *sp0 = (nodoka_number *)nodoka_pop(context);
-            nodoka_number *sp1 = (nodoka_number *)nodoka_pop(context);
+        OPCODE(SUB): {
+            nodoka_value sp0 = POP();
+            nodoka_value sp1 = stackTop[-1];
             assertNumber(sp1);
             assertNumber(sp0);
-            nodoka_push(context, (nodoka_data *)nodoka_newNumber(sp1->value - sp0->value));
-            break;
+            if (nodoka_isInt32(sp1) && nodoka_isInt32(sp0)) {
+                int64_t result = (int64_t)nodoka_getInt32(sp1) - nodoka_getInt32(sp0);
+                if (result == (int32_t)result) {
+                    stackTop[-1] = nodoka_fromInt32((int32_t)result);
+                    DISPATCH();
+                }
+            }
+            stackTop[-1] = nodoka_fromNumber(nodoka_getNumber(sp1) - nodoka_getNumber(sp0));
+            DISPATCH();
         }
-        case NODOKA_BC_SHL: {
-            nodoka_number *sp0 = (nodoka_number *)nodoka_pop(context);
-            nodoka_number *sp1 = (nodoka_number *)nodoka_pop(context);
-            assertNumber(sp1);
-            assertNumber(sp0);
-            int32_t lnum = nodoka_toInt32(sp1);
-            uint32_t rnum = nodoka_toUint32(sp0) & 0x1F;
-            nodoka_push(context, (nodoka_data *)nodoka_newNumber(lnum << rnum));
-            break;
-        }
-        case NODOKA_BC_SHR: {
-            nodoka_number *sp0 = (nodoka_number *)nodoka_pop(context);
-            nodoka_number *sp1 = (nodoka_number *)nodoka_pop(context);
-            assertNumber(sp1);
-            assertNumber(sp0);
-            int32_t lnum = nodoka_toInt32(sp1);
-            uint32_t rnum = nodoka_toUint32(sp0) & 0x1F;
-            nodoka_push(context, (nodoka_data *)nodoka_newNumber(lnum >> rnum));
-            break;
-        }
-        case NODOKA_BC_USHR: {
-            nodoka_number *sp0 = (nodoka_number *)nodoka_pop(context);
-            nodoka_number *sp1 = (nodoka_number *)nodoka_pop(context);
-            assertNumber(sp1);
-            assertNumber(sp0);
-            uint32_t lnum = nodoka_toUint32(sp1);
-            uint32_t rnum = nodoka_toUint32(sp0) & 0x1F;
-            nodoka_push(context, (nodoka_data *)nodoka_newNumber(lnum >> rnum));
-            break;
-        }
-        case NODOKA_BC_LT: {
-            nodoka_data *sp0 = nodoka_pop(context);
-            nodoka_data *sp1 = nodoka_pop(context);
+        OPCODE(SHL): {
+            nodoka_value sp0 = POP();
+            nodoka_value sp1 = stackTop[-1];
+            int32_t lnum = toInt32(sp1);
+            uint32_t rnum = (uint32_t)toInt32(sp0) & 0x1F;
+            stackTop[-1] = nodoka_fromInt32((int32_t)((uint32_t)lnum << rnum));
+            DISPATCH();
+        }
+        OPCODE(SHR): {
+            nodoka_value sp0 = POP();
+            nodoka_value sp1 = stackTop[-1];
+            int32_t lnum = toInt32(sp1);
+            uint32_t rnum = (uint32_t)toInt32(sp0) & 0x1F;
+            stackTop[-1] = nodoka_fromInt32(lnum >> rnum);
+            DISPATCH();
+        }
+        OPCODE(USHR): {
+            nodoka_value sp0 = POP();
+            nodoka_value sp1 = stackTop[-1];
+            uint32_t lnum = (uint32_t)toInt32(sp1);
+            uint32_t rnum = (uint32_t)toInt32(sp0) & 0x1F;
+            stackTop[-1] = nodoka_fromNumber(lnum >> rnum);
+            DISPATCH();
+        }
+        OPCODE(LT): {
+            nodoka_value sp0 = POP();
+            nodoka_value sp1 = stackTop[-1];
+            if (nodoka_isInt32(sp1) && nodoka_isInt32(sp0)) {
+                stackTop[-1] = nodoka_fromBool(nodoka_getInt32(sp1) < nodoka_getInt32(sp0));
+                DISPATCH();
+            }
             int8_t ret = nodoka_absRelComp(sp1, sp0);
-            nodoka_push(context, (ret == 1) ? nodoka_true : nodoka_false);
-            break;
+            stackTop[-1] = nodoka_fromBool(ret == 1);
+            DISPATCH();
         }
-        case NODOKA_BC_LTEQ: {
-            nodoka_data *sp0 = nodoka_pop(context);
-            nodoka_data *sp1 = nodoka_pop(context);
+        OPCODE(LTEQ): {
+            nodoka_value sp0 = POP();
+            nodoka_value sp1 = stackTop[-1];
+            if (nodoka_isInt32(sp1) && nodoka_isInt32(sp0)) {
+                stackTop[-1] = nodoka_fromBool(nodoka_getInt32(sp1) <= nodoka_getInt32(sp0));
+                DISPATCH();
+            }
             int8_t ret = nodoka_absRelComp(sp0, sp1);
-            nodoka_push(context, (ret == 0) ? nodoka_true : nodoka_false);
-            break;
-        }
-        case NODOKA_BC_EQ: {
-            nodoka_data *sp0 = nodoka_pop(context);
-            nodoka_data *sp1 = nodoka_pop(context);
-            bool ret = nodoka_absEqComp(sp1, sp0);
-            nodoka_push(context, ret ? nodoka_true : nodoka_false);
-            break;
-        }
-        case NODOKA_BC_S_EQ: {
-            nodoka_data *sp0 = nodoka_pop(context);
-            nodoka_data *sp1 = nodoka_pop(context);
+            stackTop[-1] = nodoka_fromBool(ret == 0);
+            DISPATCH();
+        }
+        OPCODE(EQ): {
+            nodoka_value sp0 = POP();
+            nodoka_value sp1 = stackTop[-1];
+            /* Identical bits are equal unless they are NaN */
+            bool ret = (sp1 == sp0 && sp0 != nodoka_nan) || nodoka_absEqComp(sp1, sp0);
+            stackTop[-1] = nodoka_fromBool(ret);
+            DISPATCH();
+        }
+        OPCODE(S_EQ): {
+            nodoka_value sp0 = POP();
+            nodoka_value sp1 = stackTop[-1];
             bool ret = nodoka_strictEqComp(sp1, sp0);
-            nodoka_push(context, ret ? nodoka_true : nodoka_false);
-            break;
+            stackTop[-1] = nodoka_fromBool(ret);
+            DISPATCH();
         }
-        case NODOKA_BC_AND: {
-            nodoka_number *sp0 = (nodoka_number *)nodoka_pop(context);
-            nodoka_number *sp1 = (nodoka_number *)nodoka_pop(context);
-            assertNumber(sp1);
-            assertNumber(sp0);
-            int32_t lnum = nodoka_toInt32(sp1);
-            int32_t rnum = nodoka_toInt32(sp0);
-            nodoka_push(context, (nodoka_data *)nodoka_newNumber(lnum & rnum));
-            break;
-        }
-        case NODOKA_BC_OR: {
-            nodoka_number *sp0 = (nodoka_number *)nodoka_pop(context);
-            nodoka_number *sp1 = (nodoka_number *)nodoka_pop(context);
-            assertNumber(sp1);
-            assertNumber(sp0);
-            int32_t lnum = nodoka_toInt32(sp1);
-            int32_t rnum = nodoka_toInt32(sp0);
-            nodoka_push(context, (nodoka_data *)nodoka_newNumber(lnum | rnum));
-            break;
-        }
-        case NODOKA_BC_XOR: {
-            nodoka_number *sp0 = (nodoka_number *)nodoka_pop(context);
-            nodoka_number *sp1 = (nodoka_number *)nodoka_pop(context);
-            assertNumber(sp1);
-            assertNumber(sp0);
-            int32_t lnum = nodoka_toInt32(sp1);
-            int32_t rnum = nodoka_toInt32(sp0);
-            nodoka_push(context, (nodoka_data *)nodoka_newNumber(lnum ^ rnum));
-            break;
+        OPCODE(AND): {
+            nodoka_value sp0 = POP();
+            nodoka_value sp1 = stackTop[-1];
+            stackTop[-1] = nodoka_fromInt32(toInt32(sp1) & toInt32(sp0));
+            DISPATCH();
+        }
+        OPCODE(OR): {
+            nodoka_value sp0 = POP();
+            nodoka_value sp1 = stackTop[-1];
+            stackTop[-1] = nodoka_fromInt32(toInt32(sp1) | toInt32(sp0));
+            DISPATCH();
+        }
+        OPCODE(XOR): {
+            nodoka_value sp0 = POP();
+            nodoka_value sp1 = stackTop[-1];
+            stackTop[-1] = nodoka_fromInt32(toInt32(sp1) ^ toInt32(sp0));
+            DISPATCH();
         }
 
-        case NODOKA_BC_JMP: {
-            uint16_t offset = fetch16(context);
-            context->insPtr = offset;
-            break;
+        OPCODE(JMP): {
+            insPtr = insPtr->target;
+            GC_POINT();
+            DISPATCH();
         }
-        case NODOKA_BC_JT: {
-            nodoka_data *sp0 = nodoka_pop(context);
+        OPCODE(JT): {
+            nodoka_value sp0 = POP();
             assertBoolean(sp0);
             if (sp0 == nodoka_true) {
-                uint16_t offset = fetch16(context);
-                context->insPtr = offset;
+                insPtr = insPtr->target;
             } else {
-                context->insPtr += 2;
-            }
-            break;
-        }
-        case NODOKA_BC_TRY: {
-            nodoka_code *code = context->code->codePool[fetch16(context)];
-            nodoka_envRec *env = nodoka_newDeclEnvRecord(context->env);
-            nodoka_context *cnt = nodoka_newContext(context->global, env, code, context->this);
-            nodoka_data *ret;
-            nodoka_push(cnt, nodoka_pop(context));
-            enum nodoka_completion comp = nodoka_exec(cnt, &ret);
-            nodoka_disposeContext(cnt);
-            switch (comp) {
-                case NODOKA_COMPLETION_THROW:
-                    throwError(context, ret);
-                    return NODOKA_COMPLETION_THROW;
-                case NODOKA_COMPLETION_RETURN:
-                    nodoka_push(context, ret);
-                    break;
-                default: assert(0);
+                insPtr++;
             }
-            break;
-        }
-        case NODOKA_BC_CATCH: {
-            context->catchPtr = fetch16(context);
-            break;
-        }
-        case NODOKA_BC_THIS: {
-            nodoka_push(context, (nodoka_data *)context->this);
-            break;
-
+            GC_POINT();
+            DISPATCH();
         }
-        case NODOKA_BC_THROW: {
-            throwError(context, nodoka_pop(context));
-            return NODOKA_COMPLETION_THROW;
+        OPCODE(THIS): {
+            PUSH(nodoka_box(context->this));
+            DISPATCH();
         }
-        case NODOKA_BC_NOCATCH: {
-            context->catchPtr = (size_t)(-1);
-            break;
+        OPCODE(THROW): {
+            THROW(POP());
         }
-        case NODOKA_BC_DECL: {
-            uint16_t imm16 = fetch16(context);
-            nodoka_string *var = context->code->stringPool[imm16];
+        OPCODE(DECL): {
+            nodoka_string *var = FETCH()->string;
             if (!nodoka_hasBinding(context->env, var)) {
                 nodoka_setMutableBinding(context->env, var, nodoka_undefined);
             }
-            break;
+            DISPATCH();
+        }
+        ILLEGAL: {
+            assert(0);
         }
-        default: assert(0);
     }
-    return NODOKA_COMPLETION_NORMAL;
-}
 
-enum nodoka_completion nodoka_exec(nodoka_context *context, nodoka_data **retPtr) {
-    enum nodoka_completion comp;
-    while (true) {
-        while (true) {
-            comp = nodoka_stepExec(context);
-            if (comp != NODOKA_COMPLETION_NORMAL) {
-                break;
-            }
+call:
+    if (!nodoka_isObject(callFunc) || !((nodoka_object *)nodoka_unbox(callFunc))->call) {
+        THROW(errorString("TypeError: Cannot call on non-function"));
+    }
+    {
+        nodoka_object *func = nodoka_unbox(callFunc);
+        /* Arguments are left on the operand stack, and the callee takes them in place */
+        vmStack->top = callArgs + callCount;
+        if (func->code) {
+            callee = nodoka_newFunctionContext(context, func, callThis, &exception, callCount, callArgs);
+            goto enter;
         }
+        nodoka_value ret;
+        SAVE_STATE_TO(callArgs + callCount);
+        enum nodoka_completion comp = nodoka_call(context, func, callThis, &ret, callCount, callArgs);
+        vmStack->top = context->stackLimit;
         if (comp == NODOKA_COMPLETION_THROW) {
-            if (context->catchPtr != (size_t)(-1)) {
-                nodoka_data *ret = nodoka_pop(context);
-                nodoka_data *com = nodoka_pop(context);
-                context->stack = context->stackTop;
-                nodoka_push(context, com);
-                nodoka_push(context, ret);
-
-                context->insPtr = context->catchPtr;
-                continue;
-            } else {
-                nodoka_data *ret = nodoka_pop(context);
-                context->stack = context->stackTop;
-                nodoka_push(context, ret);
+            THROW(ret);
+        }
+        PUSH(ret);
+        DISPATCH();
+    }
+
+    /* Activations of code are run by this loop instead of recursing */
+enter:
+    if (!callee) {
+        vmStack->top = context->stackLimit;
+        goto throw;
+    }
+    SAVE_STATE();
+    callee->caller = context;
+    context = callee;
+    LOAD_STATE();
+    GC_POINT();
+    DISPATCH();
+
+    /* The exception table is only consulted once something is thrown */
+throw: {
+        nodoka_code *code = context->code;
+        /* insPtr has moved past the opcode, so this is within the throwing instruction */
+        size_t pc = insPtr - 1 - wordcode;
+        for (size_t i = 0; i < code->handlerLength; i++) {
+            nodoka_handler *h = &code->wordHandlers[i];
+            if (pc >= h->start && pc < h->end) {
+                stackTop = context->stack + h->depth;
+                PUSH(exception);
+                insPtr = wordcode + h->handler;
+                DISPATCH();
             }
         }
-        break;
     }
-    nodoka_data *ret = nodoka_pop(context);
-    assert(context->stack == context->stackTop);
-    if (retPtr)
-        *retPtr = ret;
-    return comp;
+    if (context->caller) {
+        nodoka_context *caller = context->caller;
+        nodoka_disposeContext(context);
+        context = caller;
+        vmStack->top = context->stackLimit;
+        LOAD_STATE();
+        goto throw;
+    }
+    stackTop = context->stack;
+    PUSH(exception);
+    comp = NODOKA_COMPLETION_THROW;
+
+leave: {
+        nodoka_value ret = POP();
+        assert(context->stack == stackTop);
+        SAVE_STATE();
+        nodoka_currentRegion = outerRegion;
+        if (retPtr)
+            *retPtr = ret;
+        return comp;
+    }
 }
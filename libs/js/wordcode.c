@@ -0,0 +1,170 @@
+#include "c/assert.h"
+#include "c/stdlib.h"
+
+#include "util/double.h"
+
+#include "js/js.h"
+#include "js/bytecode.h"
+
+static uint16_t read16(uint8_t *bytecode, size_t ptr) {
+    return (uint16_t)(bytecode[ptr] << 8 | bytecode[ptr + 1]);
+}
+
+static uint64_t read64(uint8_t *bytecode, size_t ptr) {
+    uint64_t ret = 0;
+    for (int i = 0; i < 8; i++) {
+        ret = ret << 8 | bytecode[ptr + i];
+    }
+    return ret;
+}
+
+/* Size of the immediate operands following the opcode, in bytes */
+size_t nodoka_operandLength(uint8_t bc) {
+    switch (bc) {
+        case NODOKA_BC_LOAD_STR:
+        case NODOKA_BC_DECL:
+        case NODOKA_BC_GET_NAME:
+        case NODOKA_BC_PUT_NAME:
+        case NODOKA_BC_FUNC:
+        case NODOKA_BC_JMP:
+        case NODOKA_BC_JT:
+        case NODOKA_BC_GET_LOCAL:
+        case NODOKA_BC_SET_LOCAL:
+            return 2;
+        case NODOKA_BC_GET_UPVAL:
+        case NODOKA_BC_SET_UPVAL:
+            return 3;
+        case NODOKA_BC_LOAD_NUM:
+            return 8;
+        case NODOKA_BC_CALL_NAME:
+            return 3;
+        case NODOKA_BC_CALL:
+        case NODOKA_BC_CALL_PROP:
+        case NODOKA_BC_NEW:
+            return 1;
+        default:
+            assert(bc < NODOKA_BC_PROTECTOR);
+            return 0;
+    }
+}
+
+/* Number of words the operands take in word code */
+static size_t operandWords(uint8_t bc) {
+    switch (bc) {
+        case NODOKA_BC_GET_PROP:
+        case NODOKA_BC_PUT_PROP:
+            return 1;
+        case NODOKA_BC_CALL_NAME:
+        case NODOKA_BC_CALL_PROP:
+            return 2;
+        default:
+            return nodoka_operandLength(bc) ? 1 : 0;
+    }
+}
+
+/*
+ * Translate the big-endian bytecode into word code: one aligned word for the
+ * opcode and one for each operand. Pool indexes are resolved to the
+ * string or code they refer to, and jump targets to word pointers, so that
+ * the interpreter never has to decode anything. Number constants are boxed
+ * once here. The exception table is translated to word indexes as well, and
+ * each property access site is given an inline cache.
+ */
+void nodoka_decodeCode(nodoka_code *code) {
+    uint8_t *bytecode = code->bytecode;
+    size_t length = code->bytecodeLength;
+
+    /* Map every byte offset which starts an instruction to its word index */
+    size_t *wordIndex = malloc((length + 1) * sizeof(size_t));
+    size_t words = 0;
+    size_t caches = 0;
+    for (size_t i = 0; i < length; ) {
+        wordIndex[i] = words;
+        switch (bytecode[i]) {
+            case NODOKA_BC_GET_PROP:
+            case NODOKA_BC_PUT_PROP:
+            case NODOKA_BC_CALL_PROP:
+                caches++;
+                break;
+        }
+        words += 1 + operandWords(bytecode[i]);
+        i += 1 + nodoka_operandLength(bytecode[i]);
+    }
+    wordIndex[length] = words;
+    nodoka_ic *ic = calloc(caches, sizeof(nodoka_ic));
+    code->caches = ic;
+    code->cacheLength = caches;
+
+    nodoka_word *wordcode = malloc(words * sizeof(nodoka_word));
+    nodoka_word *ptr = wordcode;
+    for (size_t i = 0; i < length; ) {
+        uint8_t bc = bytecode[i];
+        size_t operand = nodoka_operandLength(bc);
+        (ptr++)->op = bc;
+        switch (bc) {
+            case NODOKA_BC_LOAD_STR:
+            case NODOKA_BC_DECL:
+            case NODOKA_BC_GET_NAME:
+            case NODOKA_BC_PUT_NAME:
+                ptr->string = code->stringPool[read16(bytecode, i + 1)];
+                break;
+            case NODOKA_BC_FUNC:
+                ptr->code = code->codePool[read16(bytecode, i + 1)];
+                break;
+            case NODOKA_BC_JMP:
+            case NODOKA_BC_JT: {
+                uint16_t target = read16(bytecode, i + 1);
+                assert(target <= length);
+                ptr->target = wordcode + wordIndex[target];
+                break;
+            }
+            case NODOKA_BC_LOAD_NUM:
+                ptr->value = nodoka_fromNumber(int2double(read64(bytecode, i + 1)));
+                break;
+            case NODOKA_BC_CALL:
+            case NODOKA_BC_NEW:
+                ptr->imm = bytecode[i + 1];
+                break;
+            case NODOKA_BC_GET_PROP:
+            case NODOKA_BC_PUT_PROP:
+                ptr->ic = ic++;
+                break;
+            case NODOKA_BC_CALL_PROP:
+                ptr[0].imm = bytecode[i + 1];
+                ptr[1].ic = ic++;
+                break;
+            case NODOKA_BC_CALL_NAME:
+                ptr[0].string = code->stringPool[read16(bytecode, i + 1)];
+                ptr[1].imm = bytecode[i + 3];
+                break;
+            case NODOKA_BC_GET_LOCAL:
+            case NODOKA_BC_SET_LOCAL:
+                ptr->imm = read16(bytecode, i + 1);
+                break;
+            case NODOKA_BC_GET_UPVAL:
+            case NODOKA_BC_SET_UPVAL:
+                ptr->upval.depth = bytecode[i + 1];
+                ptr->upval.index = read16(bytecode, i + 2);
+                break;
+        }
+        ptr += operandWords(bc);
+        i += 1 + operand;
+    }
+
+    nodoka_handler *handlers = malloc(code->handlerLength * sizeof(nodoka_handler));
+    for (size_t i = 0; i < code->handlerLength; i++) {
+        nodoka_handler *h = &code->handlers[i];
+        assert(h->start <= h->end && h->end <= length && h->handler < length);
+        handlers[i] = (nodoka_handler) {
+            .start = wordIndex[h->start],
+             .end = wordIndex[h->end],
+              .handler = wordIndex[h->handler],
+               .depth = h->depth
+        };
+    }
+    free(wordIndex);
+
+    code->wordcode = wordcode;
+    code->wordcodeLength = words;
+    code->wordHandlers = handlers;
+}
@@ -110,6 +110,31 @@ utf8_string_t unicode_toUtf8(utf16_string_t utf16) {
     };
 }
 
+utf8_string_t unicode_latin1ToUtf8(latin1_string_t latin1) {
+    size_t expectedLen = latin1.len;
+    for (int i = 0; i < latin1.len; i++) {
+        if (latin1.str[i] >= 0x7F) {
+            expectedLen++;
+        }
+    }
+    uint8_t *result = malloc(expectedLen);
+    size_t len = 0;
+    for (int i = 0; i < latin1.len; i++, len++) {
+        uint8_t c = latin1.str[i];
+        if (c < 0x7F) {
+            result[len] = c;
+        } else {
+            result[len] = (c >> 6) | 0xC0;
+            result[++len] = (c & 0x3F) | 0x80;
+        }
+    }
+    assert(len == expectedLen);
+    return (utf8_string_t) {
+        .str = result,
+         .len = len
+    };
+}
+
 void unicode_putUtf8(utf8_string_t utf8) {
     printf("%.*s", utf8.len, utf8.str);
 }
@@ -129,3 +154,9 @@ void unicode_fputUtf16(FILE *file, utf16_string_t utf16) {
     unicode_fputUtf8(file, u8);
     free(u8.str);
 }
+
+void unicode_fputLatin1(FILE *file, latin1_string_t latin1) {
+    utf8_string_t u8 = unicode_latin1ToUtf8(latin1);
+    unicode_fputUtf8(file, u8);
+    free(u8.str);
+}
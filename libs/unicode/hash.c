@@ -27,6 +27,16 @@ int unicode_utf16Hash(void *key) {
     return h;
 }
 
+/* The same as unicode_utf16Hash of the same code units */
+int unicode_latin1Hash(void *key) {
+    latin1_string_t *c = key;
+    int32_t h = 0;
+    for (int i = 0; i < c->len; i++) {
+        h = 31 * h + c->str[i];
+    }
+    return h;
+}
+
 hashmap_t *hashmap_new_utf16(int size) {
     return hashmap_new(unicode_utf16Hash, unicode_utf16Cmp, size);
 }
\ No newline at end of file
@@ -7,6 +7,8 @@
 #include "unicode/type.h"
 #include "unicode/convert.h"
 
+#include "data-struct/slab.h"
+
 #include "js/js.h"
 #include "js/bytecode.h"
 #include "js/lex.h"
@@ -18,12 +20,37 @@ struct nodoka_config nodoka_config = {
     .peehole = true,
     .conv = true,
     .fold = true,
+    .stackDepth = 10000,
 };
 
+static void printGCStats(void) {
+    nodoka_gc_stats stats;
+    nodoka_getGCStats(&stats);
+    fprintf(stderr, "GC: %zu minor, %zu major, live %zu bytes\n", stats.minorCollections, stats.cycles, stats.liveSize);
+    fprintf(stderr, "GC pauses: %zu, mean %.1fus, max %.1fus\n", stats.pauses,
+            stats.pauses ? stats.totalPause / stats.pauses : 0, stats.maxPause);
+    for (int i = 0; i < NODOKA_GC_PAUSE_BUCKETS; i++) {
+        if (stats.pauseHistogram[i]) {
+            fprintf(stderr, "  < %dus: %zu\n", 1 << i, stats.pauseHistogram[i]);
+        }
+    }
+    slab_stats_t slabs[SLAB_CLASSES];
+    slab_stats(slabs);
+    fprintf(stderr, "Slab classes:\n");
+    for (int i = 0; i < SLAB_CLASSES; i++) {
+        if (slabs[i].allocations) {
+            fprintf(stderr, "  %3zu bytes: %zu allocated, %zu freed, %zu pages\n",
+                    slabs[i].size, slabs[i].allocations, slabs[i].frees, slabs[i].pages);
+        }
+    }
+}
+
 int main(int argc, char **argv) {
 
     bool dispBytecode = false;
     bool printResult = false;
+    bool gcStats = false;
+    bool useRegion = false;
 
 
     char *path = NULL;
@@ -51,6 +78,12 @@ int main(int argc, char **argv) {
                     dispBytecode = s;
                 } else if (strcmp(name, "print-result") == 0) {
                     printResult = s;
+                } else if (strcmp(name, "gc-stats") == 0) {
+                    gcStats = s;
+                } else if (strcmp(name, "region") == 0) {
+                    useRegion = s;
+                } else if (strncmp(name, "stack-depth=", 12) == 0) {
+                    nodoka_config.stackDepth = strtoul(name + 12, NULL, 10);
                 } else {
                     printf("NodokaJS: Unknown Option %s\n", arg);
                 }
@@ -105,12 +138,12 @@ int main(int argc, char **argv) {
         nodoka_envRec *env = nodoka_newObjEnvRecord(global.global, NULL);
         nodoka_context *context = nodoka_newContext(&global, env, code, global.global);
 
-        nodoka_data *retVal;
+        nodoka_value retVal;
         if (nodoka_exec(context, &retVal) == NODOKA_COMPLETION_THROW) {
             nodoka_string *retStr = nodoka_toString(context, retVal);
             /* Result */
             printf("\033[1;31mUncaught ");
-            unicode_putUtf16(retStr->value);
+            nodoka_fputString(stdout, retStr);
             printf("\033[0m\n");
         }
     }
@@ -124,6 +157,10 @@ int main(int argc, char **argv) {
     } else {
         free(buffer);
         code = nodoka_loadBytecode(path);
+        if (!code) {
+            printf("NodokaJS: Invalid bytecode file '%s'\n", path);
+            return 1;
+        }
     }
 
     if (output)
@@ -134,15 +171,30 @@ int main(int argc, char **argv) {
     }
 
     nodoka_envRec *env = nodoka_newObjEnvRecord(global.global, NULL);
-    nodoka_context *context = nodoka_newContext(&global, env, code, global.global);
+    nodoka_region *region = useRegion ? nodoka_newRegion() : NULL;
+    nodoka_context *context = region ?
+                              nodoka_newRegionContext(region, &global, env, code) :
+                              nodoka_newContext(&global, env, code, global.global);
 
-    nodoka_data *retVal;
+    nodoka_value retVal;
     enum nodoka_completion comp = nodoka_exec(context, &retVal);
+    if (region) {
+        /* Only keep the result, and drop everything else the script allocated */
+        nodoka_disposeContext(context);
+        if (!nodoka_copyFromRegion(region, retVal, &retVal)) {
+            retVal = nodoka_box(nodoka_newStringFromUtf8("[result not copyable out of the region]"));
+        }
+        nodoka_disposeRegion(region);
+        context = nodoka_newContext(&global, env, code, global.global);
+    }
+    if (gcStats) {
+        printGCStats();
+    }
     switch (comp) {
         case NODOKA_COMPLETION_RETURN: {
             if (printResult) {
-                nodoka_data *ret;
-                nodoka_colorDir(context, NULL, NULL, &ret, 1, (nodoka_data *[1]) {
+                nodoka_value ret;
+                nodoka_colorDir(context, NULL, nodoka_undefined, &ret, 1, (nodoka_value[1]) {
                     retVal
                 });
             }
@@ -152,7 +204,7 @@ int main(int argc, char **argv) {
             nodoka_string *retStr = nodoka_toString(context, retVal);
             /* Result */
             fprintf(stderr, "\033[1;31mUncaught ");
-            unicode_fputUtf16(stderr, retStr->value);
+            nodoka_fputString(stderr, retStr);
             fprintf(stderr, "\033[0m\n");
             return -1;
         }
@@ -9,3 +9,277 @@ console.log(undefined);
 console.log(null);
 console.log(new Object());
 console.log(function(){});
+
+var keys = {};
+keys[{}] = "object";
+keys[[1, 2]] = "array";
+console.log(keys["[object Object]"]);
+console.log(keys[[1, 2]]);
+console.log(delete keys[{}]);
+console.log("abc"[{}]);
+
+var sum = 0;
+for (var i = 0; i < 100; i++) {
+	if (i % 3 != 0 && i <= 50) {
+		sum += i * 2 - 1;
+	}
+}
+console.log(sum);
+console.log(typeof sum, typeof "", typeof null, typeof undefined, typeof console.log);
+console.log(!0, ~5, -7 >> 1, -7 >>> 28, 1 << 31, 7 & 3 | 8 ^ 1);
+
+console.log(65535, 65536, 4294967295, -2147483648, 3.25, 1e21);
+var n = 0;
+while (n < 1000) {
+	n += 7;
+	if (n > 500) {
+		n += 300;
+	}
+}
+console.log(n);
+
+console.log(0.5 + 0.25, 1 / 0, -1 / 0, 0 / 0, 1 / -0);
+console.log(2147483647 + 1, -2147483648 - 1, 46341 * 46341);
+console.log(NaN == NaN, isNaN(0 / 0), 0 === -0, 5 % -3, -5 % 3);
+
+function counter(start) {
+	var n = start;
+	return function (step) {
+		n += step;
+		return n;
+	};
+}
+var c1 = counter(10), c2 = counter(100);
+c1(1);
+console.log(c1(5), c2(1));
+function shadow(a) {
+	var a;
+	return a;
+}
+console.log(shadow(3));
+function evalLocal(x) {
+	var y = 2;
+	return eval("x * y");
+}
+console.log(evalLocal(21));
+
+var nested = {inner: {value: 1}};
+nested.inner.value += 2;
+nested["inner"].value++;
+nested.inner["val" + "ue"] *= 10;
+console.log(nested.inner.value);
+globalCounter = 5;
+globalCounter -= 1;
+console.log(globalCounter, delete nested.inner, nested.inner);
+
+function third(a, b, c) {
+	return c;
+}
+console.log(third(1, 2), third(1, 2, 3, 4));
+function fib(n) {
+	return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+console.log(fib(20));
+
+function depth(n) {
+	return n == 0 ? 0 : 1 + depth(n - 1);
+}
+console.log(depth(5000));
+function forever() {
+	return forever();
+}
+try {
+	forever();
+} catch (e) {
+	console.log(e.name);
+}
+function Box(v) {
+	this.v = v;
+}
+console.log(new Box(4).v);
+
+function returnThrough() {
+	try {
+		return "try";
+	} finally {
+		console.log("finally");
+	}
+}
+console.log(returnThrough());
+function finallyReturns() {
+	try {
+		throw 1;
+	} finally {
+		return "finally";
+	}
+}
+console.log(finallyReturns());
+function catchReturns() {
+	try {
+		throw "thrown";
+	} catch (e) {
+		return e;
+	} finally {
+		console.log("after catch");
+	}
+}
+console.log(catchReturns());
+try {
+	try {
+		throw new Error("inner");
+	} finally {
+		console.log("cleanup");
+	}
+} catch (e) {
+	console.log(e.message);
+}
+
+function pick(a, b, c) {
+	return c;
+}
+console.log(((1 + 2) * (3 + 4) - (5 + 6) * (7 + (8 - (9 - (10 + 11))))) / 2);
+console.log(pick(pick(1, 2, 3), pick(4, 5, 6), pick(7, 8, pick(9, 10, 11))));
+console.log([1, [2, [3, [4, [5]]]], 6].length);
+
+function getX(o) {
+	return o.x;
+}
+function Point() {}
+Point.prototype = {x: "proto"};
+var p = new Point();
+console.log(getX(p), getX({x: 1}), getX({y: 2, x: 3}));
+Point.prototype.x = "changed";
+console.log(getX(p));
+p.x = "own";
+console.log(getX(p));
+delete p.x;
+console.log(getX(p));
+
+var list = null;
+for (var i = 0; i < 100000; i++) {
+	var node = {value: i, next: list};
+	if (i % 1000 == 0) {
+		list = node;
+	}
+}
+var length = 0;
+for (var n = list; n; n = n.next) {
+	length++;
+}
+console.log(length, list.value);
+var converted = {};
+var key = {toString: function () {
+	for (var i = 0; i < 50000; i++) {
+		var garbage = {i: i};
+	}
+	return "key";
+}};
+converted[key] = list;
+console.log(converted.key.value, eval("var s = 0; for (var i = 0; i < 50000; i++) { s += [i][0]; } s"));
+
+var counts = {hits: 0};
+for (var i = 0; i < 100003; i++) {
+	counts.hits += 1;
+	counts["miss" + (i % 3)] = i;
+}
+console.log(counts.hits, counts.miss0, counts.miss1, counts.miss2);
+
+var holder = {slot: {count: 0}};
+for (var i = 0; i < 100002; i++) {
+	var old = holder.slot;
+	holder.slot = {count: old.count + 1, previous: i % 2 ? old : null};
+}
+console.log(holder.slot.count, holder.slot.previous.count);
+
+var sizes = [];
+for (var i = 0; i < 2000; i++) {
+	sizes[i % 20] = {a: i, b: [i, i + 1, i + 2], c: "s" + i, d: function () {}};
+}
+console.log(sizes[19].a, sizes[0].b[2], sizes[7].c, typeof sizes[3].d);
+
+// Prints 'TypeError' under --region, as the object would outlive the region
+try {
+	Object.prototype.shared = {};
+	console.log("stored");
+} catch (e) {
+	console.log(e.name);
+}
+delete Object.prototype.shared;
+
+var shaped = {a: 1, b: 2, c: 3};
+delete shaped.b;
+shaped.b = 4;
+console.log(shaped.a, shaped.b, shaped.c);
+var wide = {};
+for (var i = 0; i < 100; i++) {
+	wide["p" + i] = i;
+}
+delete wide.p50;
+wide.p50 = "again";
+console.log(wide.p0, wide.p50, wide.p99, wide.p100);
+
+var dense = [];
+for (var i = 0; i < 100; i++) {
+	dense[i] = i * i;
+}
+dense[200] = "far";
+console.log(dense.length, dense[99], dense[150], dense[200], dense["10"]);
+var sparse = [];
+sparse[100000] = 1;
+console.log(sparse.length, sparse[0], delete dense[1], dense[1]);
+
+var ints = [1, 2, 3];
+ints[3] = 4;
+var doubles = [1.5, 2.5];
+doubles[2] = 3;
+var mixed = [1, 2];
+mixed[1] = 0.5;
+mixed[2] = "three";
+console.log(ints[3] + ints[0], doubles[0] + doubles[2], mixed[1], mixed[2], mixed.length);
+ints[1] = 2147483648;
+console.log(ints[1], ints[2]);
+
+var fixed = {value: 1};
+Object.preventExtensions(fixed);
+fixed.value = 2;
+fixed.added = 3;
+console.log(fixed.value, fixed.added, Object.isExtensible(fixed));
+var arrayPrototype = Array.prototype;
+Array.prototype = null;
+console.log(Array.prototype === arrayPrototype, delete Array.prototype, delete fixed.value, fixed.value);
+
+var table = {};
+for (var i = 0; i < 5000; i++) {
+	table["k" + i] = i;
+}
+for (var i = 0; i < 5000; i += 2) {
+	delete table["k" + i];
+}
+console.log(table.k0, table.k1, table.k4998, table.k4999);
+
+var rope = "";
+for (var i = 0; i < 1000; i++) {
+	rope += "ab";
+}
+console.log(rope.length, rope.charAt(1999), rope == "ab" + rope.substring(2, 2000));
+console.log(("x" + "y") + ("z" + 1), "con" + "cat" == "concat");
+
+var built = "ke" + "y";
+var keyed = {key: "found"};
+console.log(keyed[built], built === "key", keyed["k" + "e" + "y"]);
+
+var same = "hash" + "ed";
+var hashes = {};
+hashes[same] = 1;
+hashes["hashed"] += 1;
+console.log(hashes.hashed, same == "hashed", same != "hashes", "" == "", "a" < "b");
+
+var latin = "caf" + String.fromCharCode(233);
+var wideChars = "x" + String.fromCharCode(0x3042);
+console.log(latin.length, latin.charCodeAt(3), wideChars.charCodeAt(1), latin + wideChars == "caféxあ");
+console.log(String.fromCharCode(233) == "é", latin.substring(3) == String.fromCharCode(233));
+
+var base = "substring views";
+var view = base.substring(3, 9);
+console.log(view, view.length, view.charCodeAt(0), view == "string", base.charAt(0) === "s");
+console.log(view.substring(1, 3), base.substring(10) + view.charAt(5), "abc".charAt(5) == "");